@@ -0,0 +1,1069 @@
+/* for memfd_create() */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "manifold.h"
+
+/* how many times to look at an empty (or full) ring before going to sleep */
+#define AGENT_SPIN 128
+
+/* rounds up to a whole number of cache lines */
+#define AGENT_LINES(bytes) \
+	((((bytes) + AGENT_CACHE_LINE - 1) / AGENT_CACHE_LINE) * AGENT_CACHE_LINE)
+
+static void agents_assign(Cortex *core, CortexAgents *ag);
+static int agents_reader(Cortex *core, int *sec_step, IntQueue *iq,
+	int *slot);
+static void agents_send_frame(Cortex *core, int t);
+static void agents_collect(Cortex *core, int t);
+static void agents_command(Cortex *core, int kind);
+static void agents_recv_states(Cortex *core);
+static void agents_map_rings(Cortex *core, CortexAgents *ag);
+
+static void agent_setup(Cortex *core, int self, int *up);
+static void agent_keep_local(Cortex *core, int *sec_step, PlanEmitter *pe);
+static void agent_main(Cortex *core);
+static void agent_frame(Cortex *core, int request);
+static void agent_wait(Cortex *core, int k);
+static void agent_send_states(Cortex *core);
+
+static AgentRing* agent_ring_init(char **mem, int room);
+static void agent_ring_push(CortexAgents *ag, AgentRing *r, float *vec,
+	int dim);
+static int agent_ring_peek(CortexAgents *ag, AgentRing *r, Symbol *view);
+static void agent_ring_pop(AgentRing *r);
+static void agent_ring_sleep(CortexAgents *ag, volatile unsigned int *addr,
+	unsigned int val);
+
+static void agent_send_section(int fd, Section *sec);
+static void agent_recv_section(int fd, Section *sec);
+static void agent_write(int fd, void *buf, size_t len);
+static void agent_read(int fd, void *buf, size_t len);
+
+void agents_start(Cortex *core, int num_agents)
+{
+	CortexAgents *ag;
+	int a, i, j, k, n, slot, location;
+	int num_links, total_slots;
+	int *sec_step, *up;
+	PlanEmitter *pe;
+	pid_t pid;
+
+	if (core->plan.num_step == 0) {
+		return;
+	}
+
+	/* there is no point in an agent with nothing to do */
+	n = num_agents;
+	if (n > core->plan.num_step) {
+		n = core->plan.num_step;
+	}
+
+	ag = (CortexAgents*)xmalloc(sizeof(CortexAgents) * 1);
+	ag->num_agents = n;
+	ag->agent = (Agent*)xmalloc(sizeof(Agent) * n);
+	ag->owner = (int*)xmalloc(sizeof(int) * core->plan.num_step);
+	ag->room = 0;
+	ag->frames = NULL;
+	ag->request = NULL;
+	ag->tables = NULL;
+	ag->shm = NULL;
+	ag->shm_size = 0;
+	ag->self = -1;
+	ag->up = -1;
+	ag->coordinator = getpid();
+	ag->frame = 0;
+	ag->wire = wire_frame_init();
+	ag->out = NULL;
+
+	agents_assign(core, ag);
+
+	/* which step runs each section, if any */
+	sec_step = (int*)xmalloc(sizeof(int) * (core->num_sec + 1));
+	for (i = 0; i < core->num_sec; i++)
+	{
+		sec_step[i] = CORTEX_NOT_FOUND;
+	}
+	for (k = 0; k < core->plan.num_step; k++)
+	{
+		sec_step[core->plan.step[k].sec - core->sec] = k;
+	}
+
+	/* where each section's slots are counted */
+	ag->slot_base = (int*)xmalloc(sizeof(int) * (core->num_sec + 1));
+	total_slots = 0;
+	for (i = 0; i < core->num_sec; i++)
+	{
+		ag->slot_base[i] = total_slots;
+		total_slots += core->sec[i].receptor.num_slot;
+	}
+	ag->slot_ring =
+		(AgentRing**)xmalloc(sizeof(AgentRing*) * (total_slots + 1));
+	ag->arrived =
+		(unsigned long*)xmalloc(sizeof(unsigned long) * (total_slots + 1));
+	for (i = 0; i < total_slots; i++)
+	{
+		ag->slot_ring[i] = NULL;
+		ag->arrived[i] = 0;
+	}
+
+	/* which connections cross from one agent to another */
+	ag->link_start = (int*)xmalloc(sizeof(int) * (core->plan.num_step + 1));
+	num_links = 0;
+	for (k = 0; k < core->plan.num_step; k++)
+	{
+		num_links += core->plan.step[k].sec->emitter.num_con;
+	}
+	ag->link = (AgentLink*)xmalloc(sizeof(AgentLink) * (num_links + 1));
+	num_links = 0;
+	for (k = 0; k < core->plan.num_step; k++)
+	{
+		ag->link_start[k] = num_links;
+		pe = &core->plan.step[k].out;
+		for (j = 0; j < pe->num_dest; j++)
+		{
+			location = agents_reader(core, sec_step, pe->dest[j], &slot);
+			if (location == CORTEX_NOT_FOUND ||
+				ag->owner[sec_step[location]] == ag->owner[k])
+			{
+				continue;
+			}
+
+			ag->link[num_links].sec = location;
+			ag->link[num_links].slot = slot;
+			ag->link[num_links].agent = ag->owner[sec_step[location]];
+			ag->link[num_links].ring = NULL;
+			num_links++;
+		}
+	}
+	ag->link_start[core->plan.num_step] = num_links;
+
+	/* which inputs each agent needs to be sent */
+	for (a = 0; a < n; a++)
+	{
+		ag->agent[a].pid = -1;
+		ag->agent[a].fd = -1;
+		ag->agent[a].wants = (int*)xmalloc(sizeof(int) *
+			(core->num_input + 1));
+		ag->agent[a].input = (AgentRing**)xmalloc(sizeof(AgentRing*) *
+			(core->num_input + 1));
+		for (i = 0; i < core->num_input; i++)
+		{
+			ag->agent[a].wants[i] = FALSE;
+			ag->agent[a].input[i] = NULL;
+		}
+	}
+	for (i = 0; i < core->num_input; i++)
+	{
+		pe = &core->plan.input[i];
+		for (j = 0; j < pe->num_dest; j++)
+		{
+			location = agents_reader(core, sec_step, pe->dest[j], &slot);
+			if (location != CORTEX_NOT_FOUND) {
+				ag->agent[ag->owner[sec_step[location]]].wants[i] = TRUE;
+			}
+		}
+	}
+
+	agents_map_rings(core, ag);
+
+	/* make all of the sockets before anyone is forked so everyone gets
+		their end. up[a * 2] is the coordinator's end of agent a's socket */
+	up = (int*)xmalloc(sizeof(int) * n * 2);
+	for (a = 0; a < n; a++)
+	{
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, &up[a * 2]) < 0)
+		{
+			printf("agents_start(): Couldn't make a socket for agent %d: "
+				"%d(%s)\n", a, errno, strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	core->agents = ag;
+
+	/* otherwise whatever is buffered gets printed once per agent */
+	fflush(stdout);
+	fflush(stderr);
+
+	for (a = 0; a < n; a++)
+	{
+		pid = fork();
+		if (pid < 0)
+		{
+			printf("agents_start(): Couldn't fork agent %d: %d(%s)\n", a,
+				errno, strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+
+		if (pid == 0)
+		{
+			agent_setup(core, a, up);
+
+			/* the plan of an agent only writes into its own slots */
+			for (i = 0; i < core->num_input; i++)
+			{
+				agent_keep_local(core, sec_step, &core->plan.input[i]);
+			}
+			for (k = 0; k < core->plan.num_step; k++)
+			{
+				agent_keep_local(core, sec_step, &core->plan.step[k].out);
+			}
+
+			agent_main(core);
+			/* agent_main() never returns */
+		}
+
+		ag->agent[a].pid = pid;
+		ag->agent[a].fd = up[a * 2];
+	}
+
+	/* the agents' ends of things are theirs */
+	for (a = 0; a < n; a++)
+	{
+		close(up[a * 2 + 1]);
+	}
+
+	free(up);
+	free(sec_step);
+}
+
+/* Make one piece of shared memory with a ring in it for every connection
+	between agents and every input an agent wants. It is mapped before the
+	fork()s, so it is at the same address in everybody. */
+static void agents_map_rings(Cortex *core, CortexAgents *ag)
+{
+	int a, i, k, l, fd;
+	char *mem;
+
+	ag->shm_size = 0;
+	for (k = 0; k < core->plan.num_step; k++)
+	{
+		for (l = ag->link_start[k]; l < ag->link_start[k + 1]; l++)
+		{
+			ag->shm_size += AGENT_LINES(sizeof(AgentRing)) + AGENT_LINES(
+				sizeof(float) * AGENT_RING_SLOTS * core->plan.step[k].emit->dim);
+		}
+	}
+	for (a = 0; a < ag->num_agents; a++)
+	{
+		for (i = 0; i < core->num_input; i++)
+		{
+			if (ag->agent[a].wants[i] == TRUE) {
+				ag->shm_size += AGENT_LINES(sizeof(AgentRing)) + AGENT_LINES(
+					sizeof(float) * AGENT_RING_SLOTS * core->input[i].dim);
+			}
+		}
+	}
+
+	if (ag->shm_size == 0) {
+		return;
+	}
+
+	fd = memfd_create("manifold-agents", MFD_CLOEXEC);
+	if (fd < 0)
+	{
+		printf("agents_map_rings(): Couldn't make the shared memory: "
+			"%d(%s)\n", errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	if (ftruncate(fd, ag->shm_size) < 0)
+	{
+		printf("agents_map_rings(): Couldn't make the shared memory %lu "
+			"bytes: %d(%s)\n", (unsigned long)ag->shm_size, errno,
+			strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	ag->shm = mmap(NULL, ag->shm_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		fd, 0);
+	if (ag->shm == MAP_FAILED)
+	{
+		printf("agents_map_rings(): Couldn't map the shared memory: "
+			"%d(%s)\n", errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	/* the mapping keeps it around */
+	close(fd);
+
+	mem = (char*)ag->shm;
+	for (k = 0; k < core->plan.num_step; k++)
+	{
+		for (l = ag->link_start[k]; l < ag->link_start[k + 1]; l++)
+		{
+			ag->link[l].ring =
+				agent_ring_init(&mem, core->plan.step[k].emit->dim);
+			ag->slot_ring[ag->slot_base[ag->link[l].sec] + ag->link[l].slot] =
+				ag->link[l].ring;
+		}
+	}
+	for (a = 0; a < ag->num_agents; a++)
+	{
+		for (i = 0; i < core->num_input; i++)
+		{
+			if (ag->agent[a].wants[i] == TRUE) {
+				ag->agent[a].input[i] =
+					agent_ring_init(&mem, core->input[i].dim);
+			}
+		}
+	}
+}
+
+/* Deal the steps out so every agent has about as much work to do. The
+	work of a section is mostly its bmu search, so it goes by the size of
+	the SOM. The biggest ones get placed first, each with whoever has the
+	least work so far. */
+static void agents_assign(Cortex *core, CortexAgents *ag)
+{
+	int a, k, best, least;
+	double *load, *cost;
+	SOM *s;
+
+	load = (double*)xmalloc(sizeof(double) * ag->num_agents);
+	cost = (double*)xmalloc(sizeof(double) * core->plan.num_step);
+
+	for (a = 0; a < ag->num_agents; a++)
+	{
+		load[a] = 0;
+	}
+	for (k = 0; k < core->plan.num_step; k++)
+	{
+		s = core->plan.step[k].sec->som;
+		cost[k] = (double)som_get_rows(s) * som_get_cols(s) * s->sd.dim;
+		ag->owner[k] = CORTEX_NOT_FOUND;
+	}
+
+	while(1)
+	{
+		best = CORTEX_NOT_FOUND;
+		for (k = 0; k < core->plan.num_step; k++)
+		{
+			if (ag->owner[k] == CORTEX_NOT_FOUND &&
+				(best == CORTEX_NOT_FOUND || cost[k] > cost[best]))
+			{
+				best = k;
+			}
+		}
+		if (best == CORTEX_NOT_FOUND) {
+			break;
+		}
+
+		least = 0;
+		for (a = 1; a < ag->num_agents; a++)
+		{
+			if (load[a] < load[least]) {
+				least = a;
+			}
+		}
+
+		ag->owner[best] = least;
+		load[least] += cost[best];
+	}
+
+	free(load);
+	free(cost);
+}
+
+/* which section reads the queue, and through which slot */
+static int agents_reader(Cortex *core, int *sec_step, IntQueue *iq,
+	int *slot)
+{
+	int i, j;
+
+	for (i = 0; i < core->num_sec; i++)
+	{
+		if (sec_step[i] == CORTEX_NOT_FOUND) {
+			continue;
+		}
+		for (j = 0; j < core->sec[i].receptor.num_slot; j++)
+		{
+			if (core->sec[i].receptor.slot[j].iq == iq) {
+				*slot = j;
+				return i;
+			}
+		}
+	}
+
+	return CORTEX_NOT_FOUND;
+}
+
+void agents_room(Cortex *core, int n)
+{
+	CortexAgents *ag = core->agents;
+
+	if (n <= ag->room) {
+		return;
+	}
+
+	free(ag->frames);
+	free(ag->request);
+	free(ag->tables);
+	ag->frames = (Symbol***)xmalloc(sizeof(Symbol**) * n);
+	ag->request = (int*)xmalloc(sizeof(int) * n);
+	ag->tables = (CortexOutputTable**)xmalloc(sizeof(CortexOutputTable*) * n);
+	ag->room = n;
+}
+
+void agents_run(Cortex *core, int n)
+{
+	int sent = 0, done = 0;
+
+	while(done < n)
+	{
+		/* keep the agents busy, but not too far ahead */
+		while(sent < n && sent - done < AGENT_WINDOW)
+		{
+			agents_send_frame(core, sent);
+			sent++;
+		}
+
+		agents_collect(core, done);
+		done++;
+	}
+}
+
+/* give every agent the inputs it wants for frame t */
+static void agents_send_frame(Cortex *core, int t)
+{
+	CortexAgents *ag = core->agents;
+	AgentCommand cmd;
+	int a, i;
+
+	cmd.kind = AGENT_FRAME;
+	cmd.request = ag->request[t];
+
+	/* the inputs are in the rings before the command says to go */
+	for (a = 0; a < ag->num_agents; a++)
+	{
+		for (i = 0; i < core->num_input; i++)
+		{
+			if (ag->agent[a].wants[i] == TRUE) {
+				agent_ring_push(ag, ag->agent[a].input[i],
+					ag->frames[t][i]->vec, ag->frames[t][i]->dim);
+			}
+		}
+		agent_write(ag->agent[a].fd, &cmd, sizeof(AgentCommand));
+	}
+
+	/* the input memory is mine, and the agents have their copies */
+	for (i = 0; i < core->num_input; i++)
+	{
+		symbol_free(ag->frames[t][i]);
+	}
+}
+
+/* read what every agent's sections had to say about frame t */
+static void agents_collect(Cortex *core, int t)
+{
+	CortexAgents *ag = core->agents;
+	CortexOutputTable *ctxout = ag->tables[t];
+	unsigned int step;
+	int a, c, output;
+	Symbol *sym, *store;
+
+	for (a = 0; a < ag->num_agents; a++)
+	{
+		if (wire_frame_read(ag->agent[a].fd, ag->wire) == FALSE)
+		{
+			printf("agents_collect(): Agent %d went away!\n", a);
+			exit(EXIT_FAILURE);
+		}
+
+		for (c = 0; c < wire_frame_num(ag->wire); c++)
+		{
+			sym = wire_frame_symbol(ag->wire, c, &step, NULL, &output);
+			if (step != (unsigned int)ag->frame || output >= ctxout->num_output ||
+				sym->dim != CORTEX_OUTPUT_DIM)
+			{
+				printf("agents_collect(): Agent %d sent output %d of frame %u "
+					"while I wanted frame %lu!\n", a, output, step, ag->frame);
+				exit(EXIT_FAILURE);
+			}
+
+			store = ctxout->output[output].store;
+			symbol_move(store, sym);
+			ctxout->output[output].active = TRUE;
+			ctxout->output[output].osym = store;
+		}
+	}
+
+	ag->frame++;
+
+	/* XXX wrong, just like in cortex_process() */
+	ctxout->mode = CORTEX_LEARNING;
+}
+
+static void agents_command(Cortex *core, int kind)
+{
+	CortexAgents *ag = core->agents;
+	AgentCommand cmd;
+	int a;
+
+	cmd.kind = kind;
+	cmd.request = 0;
+	for (a = 0; a < ag->num_agents; a++)
+	{
+		agent_write(ag->agent[a].fd, &cmd, sizeof(AgentCommand));
+	}
+}
+
+/* each agent sends its sections in plan order */
+static void agents_recv_states(Cortex *core)
+{
+	CortexAgents *ag = core->agents;
+	int a, k;
+
+	for (a = 0; a < ag->num_agents; a++)
+	{
+		for (k = 0; k < core->plan.num_step; k++)
+		{
+			if (ag->owner[k] == a) {
+				agent_recv_section(ag->agent[a].fd, core->plan.step[k].sec);
+			}
+		}
+	}
+}
+
+void agents_sync(Cortex *core)
+{
+	agents_command(core, AGENT_SYNC);
+	agents_recv_states(core);
+}
+
+void agents_stop(Cortex *core)
+{
+	CortexAgents *ag = core->agents;
+	int a, status;
+
+	agents_command(core, AGENT_STOP);
+	agents_recv_states(core);
+
+	for (a = 0; a < ag->num_agents; a++)
+	{
+		close(ag->agent[a].fd);
+		while(waitpid(ag->agent[a].pid, &status, 0) < 0 && errno == EINTR)
+		{
+			;
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+		{
+			printf("agents_stop(): Agent %d didn't exit cleanly!\n", a);
+			exit(EXIT_FAILURE);
+		}
+		free(ag->agent[a].wants);
+		free(ag->agent[a].input);
+	}
+
+	if (ag->shm != NULL) {
+		munmap(ag->shm, ag->shm_size);
+	}
+
+	free(ag->agent);
+	free(ag->owner);
+	free(ag->frames);
+	free(ag->request);
+	free(ag->tables);
+	free(ag->link_start);
+	free(ag->link);
+	free(ag->slot_base);
+	free(ag->slot_ring);
+	free(ag->arrived);
+	wire_frame_free(ag->wire);
+	free(ag);
+
+	core->agents = NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* the agent side of things */
+
+/* close everything that isn't mine and set up to do my sections */
+static void agent_setup(Cortex *core, int self, int *up)
+{
+	CortexAgents *ag = core->agents;
+	int a, i;
+
+	ag->self = self;
+	ag->up = up[self * 2 + 1];
+
+	for (a = 0; a < ag->num_agents; a++)
+	{
+		close(up[a * 2]);
+		if (a != self) {
+			close(up[a * 2 + 1]);
+		}
+	}
+
+	/* The pool's threads didn't come along through the fork(), so I get a
+		new one. The other agents are the parallelism now. */
+	core->pool = pool_init(1);
+	for (i = 0; i < core->num_sec; i++)
+	{
+		som_set_pool(core->sec[i].som, core->pool);
+	}
+
+	ag->out = cortex_output_table_init_reusable(core);
+}
+
+/* forget about the slots of the emitter which aren't on this agent */
+static void agent_keep_local(Cortex *core, int *sec_step, PlanEmitter *pe)
+{
+	CortexAgents *ag = core->agents;
+	int j, num, location, slot;
+
+	num = 0;
+	for (j = 0; j < pe->num_dest; j++)
+	{
+		location = agents_reader(core, sec_step, pe->dest[j], &slot);
+		if (location != CORTEX_NOT_FOUND &&
+			ag->owner[sec_step[location]] == ag->self)
+		{
+			pe->dest[num++] = pe->dest[j];
+		}
+	}
+	pe->num_dest = num;
+}
+
+static void agent_main(Cortex *core)
+{
+	CortexAgents *ag = core->agents;
+	AgentCommand cmd;
+
+	while(1)
+	{
+		/* if the coordinator went away, so do I */
+		if (readn(ag->up, &cmd, sizeof(AgentCommand)) !=
+			sizeof(AgentCommand))
+		{
+			_exit(EXIT_FAILURE);
+		}
+
+		switch(cmd.kind)
+		{
+			case AGENT_FRAME:
+				agent_frame(core, cmd.request);
+				break;
+
+			case AGENT_SYNC:
+				agent_send_states(core);
+				break;
+
+			case AGENT_STOP:
+				agent_send_states(core);
+				fflush(stdout);
+				_exit(EXIT_SUCCESS);
+				break;
+
+			default:
+				printf("agent_main(): Agent %d got unknown command %d!\n",
+					ag->self, cmd.kind);
+				_exit(EXIT_FAILURE);
+				break;
+		}
+	}
+}
+
+/* one frame of my sections, in plan order */
+static void agent_frame(Cortex *core, int request)
+{
+	CortexAgents *ag = core->agents;
+	CortexOutputTable *ctxout = ag->out;
+	PlanStep *step;
+	PlanEmitter *pe;
+	AgentRing *r;
+	Symbol view;
+	int i, j, k, l, o;
+
+	/* the inputs go right from the rings into the intqueues */
+	for (i = 0; i < core->num_input; i++)
+	{
+		if (ag->agent[ag->self].wants[i] == FALSE) {
+			continue;
+		}
+
+		r = ag->agent[ag->self].input[i];
+		agent_ring_peek(ag, r, &view);
+		pe = &core->plan.input[i];
+		for (j = 0; j < pe->num_dest; j++)
+		{
+			intqueue_enqueue(pe->dest[j], &view);
+		}
+		agent_ring_pop(r);
+	}
+
+	for (i = 0; i < ctxout->num_output; i++)
+	{
+		ctxout->output[i].active = FALSE;
+		ctxout->output[i].osym = NULL;
+	}
+
+	for (k = 0; k < core->plan.num_step; k++)
+	{
+		if (ag->owner[k] != ag->self) {
+			continue;
+		}
+		step = &core->plan.step[k];
+
+		agent_wait(core, k);
+		cortex_run_step(core, k, request, ctxout);
+
+		/* tell the other agents what I emitted, or that I didn't */
+		for (l = ag->link_start[k]; l < ag->link_start[k + 1]; l++)
+		{
+			agent_ring_push(ag, ag->link[l].ring, step->emit->vec,
+				step->emitted == TRUE ? step->emit->dim : 0);
+		}
+	}
+
+	/* and tell the coordinator what my sections output, the slot of each
+		one is which output it is */
+	wire_frame_clear(ag->wire);
+	for (k = 0; k < core->plan.num_step; k++)
+	{
+		o = core->plan.step[k].output;
+		if (ag->owner[k] == ag->self && o != CORTEX_NOT_FOUND &&
+			ctxout->output[o].active == TRUE)
+		{
+			wire_frame_add(ag->wire, ctxout->output[o].osym, ag->frame,
+				core->plan.step[k].sec - core->sec, o, WIRE_FP32);
+		}
+	}
+	wire_frame_write(ag->up, ag->wire);
+
+	ag->frame++;
+}
+
+/* Wait until every slot of step k has what it would have had if the steps
+	ran one after another: this frame's symbol from the earlier steps, and
+	last frame's from the later ones. */
+static void agent_wait(Cortex *core, int k)
+{
+	CortexAgents *ag = core->agents;
+	PlanStep *step = &core->plan.step[k];
+	int base = ag->slot_base[step->sec - core->sec];
+	unsigned long need;
+	AgentRing *r;
+	Symbol view;
+	int i, w;
+
+	for (i = 0; i < step->sec->receptor.num_slot; i++)
+	{
+		w = step->src[i];
+		if (w == CORTEX_NOT_FOUND || w < core->num_input) {
+			continue;
+		}
+		w -= core->num_input;
+		if (ag->owner[w] == ag->self) {
+			continue;
+		}
+
+		need = w < k ? ag->frame + 1 : ag->frame;
+		r = ag->slot_ring[base + i];
+		while(ag->arrived[base + i] < need)
+		{
+			if (agent_ring_peek(ag, r, &view) == TRUE) {
+				intqueue_enqueue(step->sec->receptor.slot[i].iq, &view);
+			}
+			agent_ring_pop(r);
+			ag->arrived[base + i]++;
+		}
+	}
+}
+
+static void agent_send_states(Cortex *core)
+{
+	CortexAgents *ag = core->agents;
+	int k;
+
+	for (k = 0; k < core->plan.num_step; k++)
+	{
+		if (ag->owner[k] == ag->self) {
+			agent_send_section(ag->up, core->plan.step[k].sec);
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* carve a ring for symbols of up to room floats out of the shared memory */
+static AgentRing* agent_ring_init(char **mem, int room)
+{
+	AgentRing *r = (AgentRing*)*mem;
+	int i;
+
+	r->head = 0;
+	r->tail = 0;
+	r->reader_sleeping = FALSE;
+	r->writer_sleeping = FALSE;
+	r->room = room;
+	for (i = 0; i < AGENT_RING_SLOTS; i++)
+	{
+		r->dim[i] = 0;
+	}
+	r->vec = (float*)(*mem + AGENT_LINES(sizeof(AgentRing)));
+
+	*mem += AGENT_LINES(sizeof(AgentRing)) +
+		AGENT_LINES(sizeof(float) * AGENT_RING_SLOTS * room);
+
+	return r;
+}
+
+/* Sleep until *addr isn't val anymore, or for a second, whichever is
+	first. An agent gives up if the coordinator went away while it slept,
+	since nobody is ever going to wake it up then. */
+static void agent_ring_sleep(CortexAgents *ag, volatile unsigned int *addr,
+	unsigned int val)
+{
+	struct timespec ts;
+
+	ts.tv_sec = 1;
+	ts.tv_nsec = 0;
+	syscall(SYS_futex, addr, FUTEX_WAIT, val, &ts, NULL, 0);
+
+	if (ag->self >= 0 && getppid() != ag->coordinator) {
+		_exit(EXIT_FAILURE);
+	}
+}
+
+/* Copy dim floats into the next slot of the ring, a dim of 0 says there
+	wasn't anything this time. */
+static void agent_ring_push(CortexAgents *ag, AgentRing *r, float *vec,
+	int dim)
+{
+	unsigned int head = r->head;
+	unsigned int tail;
+	int spin, slot;
+
+	if (dim > r->room)
+	{
+		printf("agent_ring_push(): A %d dimensional symbol doesn't fit in a "
+			"ring of %d dimensional ones!\n", dim, r->room);
+		exit(EXIT_FAILURE);
+	}
+
+	for (spin = 0; head - r->tail == AGENT_RING_SLOTS; spin++)
+	{
+		if (spin < AGENT_SPIN) {
+			continue;
+		}
+		tail = r->tail;
+		r->writer_sleeping = TRUE;
+		__sync_synchronize();
+		if (head - r->tail == AGENT_RING_SLOTS) {
+			agent_ring_sleep(ag, &r->tail, tail);
+		}
+		r->writer_sleeping = FALSE;
+	}
+
+	slot = head & (AGENT_RING_SLOTS - 1);
+	r->dim[slot] = dim;
+	if (dim > 0) {
+		memcpy(r->vec + slot * r->room, vec, sizeof(float) * dim);
+	}
+
+	/* the symbol has to be there before head says it is, and head has to
+		say so before I look to see if the reader is asleep */
+	__sync_synchronize();
+	r->head = head + 1;
+	__sync_synchronize();
+
+	if (r->tail == head && r->reader_sleeping == TRUE) {
+		syscall(SYS_futex, &r->head, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+	}
+}
+
+/* Wait for the oldest symbol in the ring and point view at it right where
+	it is. Returns FALSE if the writer had nothing that time. */
+static int agent_ring_peek(CortexAgents *ag, AgentRing *r, Symbol *view)
+{
+	unsigned int head;
+	int spin, slot;
+
+	for (spin = 0; r->head == r->tail; spin++)
+	{
+		if (spin < AGENT_SPIN) {
+			continue;
+		}
+		head = r->head;
+		r->reader_sleeping = TRUE;
+		__sync_synchronize();
+		if (r->head == r->tail) {
+			agent_ring_sleep(ag, &r->head, head);
+		}
+		r->reader_sleeping = FALSE;
+	}
+	__sync_synchronize();
+
+	slot = r->tail & (AGENT_RING_SLOTS - 1);
+	view->dim = r->dim[slot];
+	view->pool_class = SYMBOL_VIEW;
+	view->vec = r->vec + slot * r->room;
+
+	return view->dim > 0 ? TRUE : FALSE;
+}
+
+/* let the writer have the oldest slot back */
+static void agent_ring_pop(AgentRing *r)
+{
+	unsigned int tail = r->tail;
+
+	__sync_synchronize();
+	r->tail = tail + 1;
+	__sync_synchronize();
+
+	if (r->head - tail == AGENT_RING_SLOTS && r->writer_sleeping == TRUE) {
+		syscall(SYS_futex, &r->tail, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* Everything about a section that changes as it runs: its SOM, its batch,
+	and its slots. */
+static void agent_send_section(int fd, Section *sec)
+{
+	SOM *s = sec->som;
+	IntQueue *iq;
+	int hdr[9];
+	int i;
+
+	hdr[0] = s->current_iter;
+	hdr[1] = s->mode;
+	hdr[2] = s->bmu_row;
+	hdr[3] = s->bmu_col;
+	hdr[4] = sec->state;
+	hdr[5] = sec->secdisp.learn_row;
+	hdr[6] = sec->secdisp.learn_col;
+	hdr[7] = sec->batch_num;
+	hdr[8] = (int)s->rand_seed;
+	agent_write(fd, hdr, sizeof(hdr));
+
+	agent_write(fd, s->slab,
+		sizeof(float) * s->sd.rows * s->sd.cols * s->stride);
+
+	/* the coordinator keeps track of what changed for the checkpoints */
+	agent_write(fd, s->dirty, s->tile_rows * s->tile_cols);
+	som_clean(s);
+
+	for (i = 0; i < sec->batch_num; i++)
+	{
+		agent_write(fd, &sec->batch[i]->dim, sizeof(unsigned short));
+		agent_write(fd, sec->batch[i]->vec,
+			sizeof(float) * sec->batch[i]->dim);
+	}
+
+	for (i = 0; i < sec->receptor.num_slot; i++)
+	{
+		iq = sec->receptor.slot[i].iq;
+		hdr[0] = iq->dim;
+		hdr[1] = iq->curr_slice;
+		hdr[2] = iq->ready;
+		hdr[3] = iq->ready_slice;
+		agent_write(fd, hdr, sizeof(int) * 4);
+		agent_write(fd, iq->head, sizeof(int) * iq->num_slices);
+		agent_write(fd, iq->count, sizeof(int) * iq->num_slices);
+		if (iq->dim > 0) {
+			agent_write(fd, iq->ring, sizeof(float) *
+				iq->num_slices * 2 * iq->num_syms * iq->dim);
+		}
+	}
+}
+
+static void agent_recv_section(int fd, Section *sec)
+{
+	SOM *s = sec->som;
+	IntQueue *iq;
+	int hdr[9];
+	unsigned short dim;
+	unsigned char *dirty;
+	int i;
+
+	agent_read(fd, hdr, sizeof(hdr));
+	s->current_iter = hdr[0];
+	s->mode = hdr[1];
+	s->bmu_row = hdr[2];
+	s->bmu_col = hdr[3];
+	sec->state = hdr[4];
+	sec->secdisp.learn_row = hdr[5];
+	sec->secdisp.learn_col = hdr[6];
+	sec->batch_num = hdr[7];
+	s->rand_seed = (unsigned int)hdr[8];
+
+	agent_read(fd, s->slab,
+		sizeof(float) * s->sd.rows * s->sd.cols * s->stride);
+
+	/* what the agent changed on top of what changed here before it */
+	dirty = (unsigned char*)xmalloc(s->tile_rows * s->tile_cols);
+	agent_read(fd, dirty, s->tile_rows * s->tile_cols);
+	for (i = 0; i < s->tile_rows * s->tile_cols; i++)
+	{
+		s->dirty[i] |= dirty[i];
+	}
+	free(dirty);
+
+	for (i = 0; i < sec->batch_num; i++)
+	{
+		agent_read(fd, &dim, sizeof(unsigned short));
+		if (sec->batch[i] == NULL || sec->batch[i]->dim != dim)
+		{
+			symbol_free(sec->batch[i]);
+			sec->batch[i] = symbol_init(dim);
+		}
+		agent_read(fd, sec->batch[i]->vec, sizeof(float) * dim);
+	}
+
+	for (i = 0; i < sec->receptor.num_slot; i++)
+	{
+		iq = sec->receptor.slot[i].iq;
+		agent_read(fd, hdr, sizeof(int) * 4);
+		if (hdr[0] != iq->dim)
+		{
+			free(iq->ring);
+			iq->ring = NULL;
+			iq->dim = hdr[0];
+			if (iq->dim > 0) {
+				iq->ring = (float*)xmalloc(sizeof(float) *
+					iq->num_slices * 2 * iq->num_syms * iq->dim);
+			}
+		}
+		iq->curr_slice = hdr[1];
+		iq->ready = hdr[2];
+		iq->ready_slice = hdr[3];
+		agent_read(fd, iq->head, sizeof(int) * iq->num_slices);
+		agent_read(fd, iq->count, sizeof(int) * iq->num_slices);
+		if (iq->dim > 0) {
+			agent_read(fd, iq->ring, sizeof(float) *
+				iq->num_slices * 2 * iq->num_syms * iq->dim);
+		}
+	}
+}
+
+static void agent_write(int fd, void *buf, size_t len)
+{
+	if (writen(fd, buf, len) != (ssize_t)len)
+	{
+		printf("agent_write(): Couldn't write %lu bytes: %d(%s)\n",
+			(unsigned long)len, errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void agent_read(int fd, void *buf, size_t len)
+{
+	if (readn(fd, buf, len) != (ssize_t)len)
+	{
+		printf("agent_read(): Couldn't read %lu bytes, the other end must "
+			"have gone away\n", (unsigned long)len);
+		exit(EXIT_FAILURE);
+	}
+}
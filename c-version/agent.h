@@ -0,0 +1,183 @@
+#ifndef AGENT_H
+#define AGENT_H
+
+#include <sys/types.h>
+
+/* Agent mode. Instead of running every section in this process, the
+	sections are dealt out to some worker processes, the agents, each of
+	which runs its sections just like cortex_process() would. The process
+	which called cortex_init() becomes the coordinator: it keeps the .lctx
+	topology, hands each agent the inputs its sections want, and puts the
+	agents' outputs together into the output tables.
+
+	Every emitter to receptor Connection between sections on different
+	agents becomes a ring in memory shared by all of the agents, and so does
+	every input an agent wants from the coordinator. Each section puts one
+	symbol per frame into each of its rings, even if it had nothing to emit,
+	so the section on the other end always knows when it has everything it
+	is going to get for a frame. Every slot has only one emitter, and a ring
+	keeps things in order, so every slot sees exactly the symbols in exactly
+	the order it would have if it were all in one process. The commands and
+	the outputs still go over a unix domain socket to the coordinator, they
+	are small and only once a frame per agent, the outputs are a frame of
+	the wire format (see wire.h).
+
+	The agents work on their own frames at their own pace, so a later
+	frame can be going through the bottom sections while an earlier one
+	is still in the top ones, and sections that don't depend on each
+	other run at the same time on different processors. For now all of the
+	agents are forked on this machine, which the rings have to be. */
+
+/* what the coordinator can tell an agent to do */
+enum
+{
+	/* take the inputs of the next frame and run my sections on them */
+	AGENT_FRAME,
+	/* send back the state of my sections */
+	AGENT_SYNC,
+	/* send back the state of my sections, then go away */
+	AGENT_STOP
+};
+
+/* How many frames the coordinator lets the agents get ahead of the answers
+	it has read back. This keeps how much can pile up in any socket small, so
+	nobody ever blocks writing to someone who is blocked writing to them. */
+#define AGENT_WINDOW 4
+
+/* what comes before everything the coordinator tells an agent */
+typedef struct AgentCommand_s
+{
+	int kind;
+	int request;
+} AgentCommand;
+
+/* How many symbols fit in a ring. The window means nobody is ever more than
+	AGENT_WINDOW frames ahead of anyone else, so this is never full, but
+	the writer waits if it is anyway. It must be a power of two. */
+#define AGENT_RING_SLOTS 8
+
+/* keeps the reader's and writer's ends of a ring from sharing a cache line */
+#define AGENT_CACHE_LINE 64
+
+/* A single writer, single reader ring of symbols in the shared memory. The
+	writer only moves head, the reader only moves tail, so neither needs a
+	lock. A reader which finds it empty sleeps on a futex on head and a
+	writer which finds it full sleeps on tail. Whoever moves the other end
+	only makes the system call to wake them up if the ring just stopped
+	being empty (or full) and somebody said they were sleeping. */
+typedef struct AgentRing_s
+{
+	volatile unsigned int head;
+	char pad_head[AGENT_CACHE_LINE - sizeof(unsigned int)];
+
+	volatile unsigned int tail;
+	char pad_tail[AGENT_CACHE_LINE - sizeof(unsigned int)];
+
+	volatile int reader_sleeping;
+	volatile int writer_sleeping;
+
+	/* How many floats each slot has room for, and how many are in each
+		one. A dim of 0 means the section had nothing to say that frame. */
+	int room;
+	int dim[AGENT_RING_SLOTS];
+
+	/* AGENT_RING_SLOTS * room floats, also in the shared memory, which is
+		at the same address in everyone */
+	float *vec;
+
+} AgentRing;
+
+/* a connection from a section on one agent to a slot on another */
+typedef struct AgentLink_s
+{
+	int sec;
+	int slot;
+	int agent;
+	AgentRing *ring;
+} AgentLink;
+
+/* the coordinator's view of one agent */
+typedef struct Agent_s
+{
+	pid_t pid;
+
+	/* the coordinator's end of the socket to this agent */
+	int fd;
+
+	/* TRUE for each input this agent's sections want */
+	int *wants;
+
+	/* the ring each wanted input goes to this agent through, or NULL */
+	AgentRing **input;
+} Agent;
+
+typedef struct CortexAgents_s
+{
+	int num_agents;
+	Agent *agent;
+
+	/* which agent runs each plan step */
+	int *owner;
+
+	/* The coordinator gets the frames for agents_run() out of here, it is
+		room frames big */
+	int room;
+	Symbol ***frames;
+	int *request;
+	CortexOutputTable **tables;
+
+	/* The memory all of the rings live in, it is mapped before anyone is
+		forked */
+	void *shm;
+	size_t shm_size;
+
+	/* For every plan step, the connections that go to other agents, which
+		are link[link_start[k]] up to link[link_start[k + 1]] */
+	int *link_start;
+	AgentLink *link;
+
+	/* Section i's slots start at slot_base[i] in these. The ring that
+		feeds each slot from another agent, or NULL, and how many symbols
+		have come out of it. */
+	int *slot_base;
+	AgentRing **slot_ring;
+	unsigned long *arrived;
+
+	/* How many frames the coordinator has collected, or an agent has
+		done. The agents' outputs come back as a wire frame of the
+		symbols in the output tables for that step. */
+	unsigned long frame;
+	WireFrame *wire;
+
+	/* Everything past here is only used in an agent. */
+
+	/* which agent I am, my socket to the coordinator, and the coordinator,
+		so I can tell if it goes away while I'm waiting on a ring */
+	int self;
+	int up;
+	pid_t coordinator;
+
+	/* my output table, the active outputs of my sections go back to the
+		coordinator */
+	CortexOutputTable *out;
+
+} CortexAgents;
+
+/* fork num_agents agents and deal the cortex's sections out to them */
+void agents_start(Cortex *core, int num_agents);
+
+/* bring the state of every section back from the agents and stop them */
+void agents_stop(Cortex *core);
+
+/* bring the state of every section back from the agents, they keep going */
+void agents_sync(Cortex *core);
+
+/* make sure the frames, request, and tables arrays have room for n frames */
+void agents_room(Cortex *core, int n);
+
+/* Run the n frames in the agents' frames array through the agents, the
+	inputs are the cortex's just like for cortex_process(). The outputs are
+	written into the tables, which the caller has already cleaned off. */
+void agents_run(Cortex *core, int n);
+
+#endif
@@ -0,0 +1,741 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "common.h"
+
+/* This is a headless version of test_cortex_vision() in main.c. It shoves
+	glyphs through a cortex as fast as it can without drawing anything and
+	tells me how many glyphs per second the cortex can learn, and how many
+	times cortex_process_into() went to the heap once it got going, which
+	ought to be zero. The random number generators are seeded with a constant so
+	runs are comparable.
+
+	"bench bmu rows cols dim threads" instead times single bmu searches on
+	one big SOM using a pool of 1 up to threads threads.
+
+	"bench suite [out.json]" runs everything I care about the speed of, the
+	symbol math, bmu searches, learning, saving and loading SOMs,
+	convolutions, the wire format, loading .lctx and .lctxb files, and the
+	cortex processing (one at a time, in batches, spread over agent
+	processes, and while checkpointing) and reverse lookups of the shipped
+	.ctx files, and writes
+	the results as JSON so runs of different versions can be compared. The
+	seed is reset before every benchmark so they don't depend on each
+	other. */
+
+#define BENCH_SEED 42
+#define BENCH_DEFAULT_GLYPHS 2000
+
+/* how many frames the suite gives cortex_process_batch() at a time */
+#define BENCH_BATCH 32
+
+/* how many steps apart the suite's background checkpoints are */
+#define BENCH_CHECKPOINT_EVERY 100
+
+/* the cortices the suite runs */
+static char *bench_suite_ctx[] = {
+	"vision.ctx", "vision3.ctx", "linear.ctx", "diamond.ctx", "mesh.ctx", NULL
+};
+
+static double bench_now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+/* push num_glyphs glyphs into the cortex and return how long it took. The
+	heap calls cortex_process_into() made during the second half of the glyphs,
+	after everything has warmed up, go into steady_heap. */
+static double bench_cortex_vision(char *filename, int num_glyphs,
+	unsigned long *steady_heap)
+{
+	Cortex *core = NULL;
+	CortexOutputTable *ctxout = NULL;
+	VInput *vinp;
+	Symbol **channels;
+	int num_channels = 16;
+	int gindex;
+	int i;
+	double start, end;
+	unsigned long before;
+
+	vinp = vinput_init(16, 16, 16, 16);
+	core = cortex_init(filename);
+	ctxout = cortex_output_table_init_reusable(core);
+
+	*steady_heap = 0;
+
+	gindex = 0;
+	start = bench_now();
+	for (i = 0; i < num_glyphs; i++)
+	{
+		channels = vinput_glyph(vinp, gindex);
+		gindex++;
+		/* keep it in bounds of useable stuff in the glyph file */
+		gindex %= 9 * 16;
+
+		before = xheap_calls();
+		cortex_process_into(core, channels, num_channels, 
+			CORTEX_REQUEST_LEARN, ctxout);
+		if (i >= num_glyphs / 2) {
+			*steady_heap += xheap_calls() - before;
+		}
+
+		/* I must free the container, but the cortex owns the symbols */
+		free(channels);
+	}
+	end = bench_now();
+
+	cortex_output_table_free(ctxout);
+	cortex_free(core);
+	vinput_destroy(vinp);
+
+	return end - start;
+}
+
+/* how long does one bmu search take on a big SOM with this many threads? */
+static double bench_bmu_latency(int rows, int cols, int dim, int threads,
+	int num_searches)
+{
+	SOM *s;
+	Pool *pool = NULL;
+	Symbol *p;
+	int i, r, c;
+	double start, end;
+
+	srand(BENCH_SEED);
+	srand48(BENCH_SEED);
+
+	s = som_init(dim, 100000, rows, cols, NULL);
+	if (threads > 1) {
+		pool = pool_init(threads);
+		som_set_pool(s, pool);
+	}
+	p = symbol_init(dim);
+
+	start = bench_now();
+	for (i = 0; i < num_searches; i++)
+	{
+		symbol_randomize(p);
+		som_bmu(s, p, &r, &c, SOM_BMU_METHOD_FIXED);
+	}
+	end = bench_now();
+
+	symbol_free(p);
+	som_free(s);
+	if (pool != NULL) {
+		pool_free(pool);
+	}
+
+	return (end - start) / num_searches;
+}
+
+static void bench_bmu(int argc, char **argv)
+{
+	int rows = 128, cols = 128, dim = 256, threads = 4;
+	int t;
+	double secs, serial = 0;
+
+	if (argc >= 6) {
+		rows = atoi(argv[2]);
+		cols = atoi(argv[3]);
+		dim = atoi(argv[4]);
+		threads = atoi(argv[5]);
+	}
+	if (rows <= 0 || cols <= 0 || dim <= 0 || dim > 65535 || threads <= 0)
+	{
+		printf("Usage: %s bmu rows cols dim threads\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	for (t = 1; t <= threads; t++)
+	{
+		secs = bench_bmu_latency(rows, cols, dim, t, 200);
+		if (t == 1) {
+			serial = secs;
+		}
+		printf("bmu %dx%d dim %d (%s): %d thread(s) %f usec per search, "
+			"%.2fx\n", rows, cols, dim, kernel_name(), t, secs * 1000000.0,
+			serial / secs);
+	}
+}
+
+/* write out one result of the suite, params is already JSON */
+static void bench_result(FILE *out, int *first, char *name, char *params,
+	long ops, double secs)
+{
+	fprintf(out, "%s    {\"bench\": \"%s\", %s, \"ops\": %ld, "
+		"\"seconds\": %f, \"ns_per_op\": %f}", *first ? "" : ",\n", name,
+		params, ops, secs, (secs * 1000000000.0) / ops);
+	*first = FALSE;
+}
+
+static void bench_reseed(void)
+{
+	srand(BENCH_SEED);
+	srand48(BENCH_SEED);
+}
+
+/* symbol_fdist() and symbol_interpolate() from 1 to 1024 dimensions */
+static void bench_suite_symbol(FILE *out, int *first)
+{
+	Symbol *a, *b;
+	char params[256];
+	long i, ops;
+	int dim;
+	double start, secs;
+	volatile float sink = 0;
+
+	for (dim = 1; dim <= 1024; dim *= 2)
+	{
+		bench_reseed();
+		a = symbol_init(dim);
+		b = symbol_init(dim);
+		symbol_randomize(a);
+		symbol_randomize(b);
+		ops = 4000000 / dim + 1000;
+		sprintf(params, "\"dim\": %d", dim);
+
+		start = bench_now();
+		for (i = 0; i < ops; i++)
+		{
+			sink += symbol_fdist(a, b);
+		}
+		secs = bench_now() - start;
+		bench_result(out, first, "symbol_fdist", params, ops, secs);
+
+		start = bench_now();
+		for (i = 0; i < ops; i++)
+		{
+			symbol_interpolate(a, b, .001);
+		}
+		secs = bench_now() - start;
+		bench_result(out, first, "symbol_interpolate", params, ops, secs);
+
+		symbol_free(a);
+		symbol_free(b);
+	}
+}
+
+/* som_bmu() with both methods and som_learn() across map sizes */
+static void bench_suite_som(FILE *out, int *first)
+{
+	SOM *s;
+	Symbol *p;
+	char params[256];
+	long i, ops;
+	int size, dim = 16;
+	int r, c;
+	double start, secs;
+
+	for (size = 16; size <= 256; size *= 2)
+	{
+		bench_reseed();
+		s = som_init(dim, 100000000, size, size, NULL);
+		p = symbol_init(dim);
+		ops = 50000000 / (size * size) + 20;
+		sprintf(params, "\"rows\": %d, \"cols\": %d, \"dim\": %d",
+			size, size, dim);
+
+		start = bench_now();
+		for (i = 0; i < ops; i++)
+		{
+			symbol_randomize(p);
+			som_bmu(s, p, &r, &c, SOM_BMU_METHOD_FIXED);
+		}
+		secs = bench_now() - start;
+		bench_result(out, first, "som_bmu_fixed", params, ops, secs);
+
+		start = bench_now();
+		for (i = 0; i < ops; i++)
+		{
+			symbol_randomize(p);
+			som_bmu(s, p, &r, &c, SOM_BMU_METHOD_CENTROID);
+		}
+		secs = bench_now() - start;
+		bench_result(out, first, "som_bmu_centroid", params, ops, secs);
+
+		/* early in the training the neighborhood is as big as it gets */
+		start = bench_now();
+		for (i = 0; i < ops; i++)
+		{
+			symbol_randomize(p);
+			som_learn(s, p, &r, &c, SOM_REQUEST_LEARN, FALSE);
+		}
+		secs = bench_now() - start;
+		bench_result(out, first, "som_learn", params, ops, secs);
+
+		/* a warm start, and the save it comes from */
+		start = bench_now();
+		som_save(s, "bench.som");
+		secs = bench_now() - start;
+		bench_result(out, first, "som_save", params, 1, secs);
+
+		start = bench_now();
+		for (i = 0; i < 20; i++)
+		{
+			som_free(som_load("bench.som"));
+		}
+		secs = bench_now() - start;
+		bench_result(out, first, "som_load", params, 20, secs);
+		unlink("bench.som");
+
+		symbol_free(p);
+		som_free(s);
+	}
+}
+
+/* Encoding and decoding frames of the wire format, per symbol, so it can be
+	held up against a bmu search with the same dim. The frames are as big as
+	the ones a batch makes. */
+static void bench_suite_wire(FILE *out, int *first)
+{
+	static char *names[] = { "fp32", "fp16", "u8" };
+	WireFrame *wf;
+	Symbol *p;
+	char params[256];
+	long i, ops;
+	int dim, enc, j;
+	double start, secs;
+	volatile float sink = 0;
+
+	wf = wire_frame_init();
+
+	for (dim = 2; dim <= 256; dim *= 8)
+	{
+		for (enc = WIRE_FP32; enc <= WIRE_U8; enc++)
+		{
+			bench_reseed();
+			p = symbol_init(dim);
+			symbol_randomize(p);
+			ops = 8000000 / dim + 1000;
+			sprintf(params, "\"dim\": %d, \"encoding\": \"%s\"", dim,
+				names[enc]);
+
+			start = bench_now();
+			for (i = 0; i < ops; i += BENCH_BATCH)
+			{
+				wire_frame_clear(wf);
+				for (j = 0; j < BENCH_BATCH; j++)
+				{
+					wire_frame_add(wf, p, i, 0, j, enc);
+				}
+			}
+			secs = bench_now() - start;
+			bench_result(out, first, "wire_encode", params,
+				((ops + BENCH_BATCH - 1) / BENCH_BATCH) * BENCH_BATCH, secs);
+
+			start = bench_now();
+			for (i = 0; i < ops; i += BENCH_BATCH)
+			{
+				for (j = 0; j < BENCH_BATCH; j++)
+				{
+					sink += wire_frame_symbol(wf, j, NULL, NULL, NULL)->vec[0];
+				}
+			}
+			secs = bench_now() - start;
+			bench_result(out, first, "wire_decode", params,
+				((ops + BENCH_BATCH - 1) / BENCH_BATCH) * BENCH_BATCH, secs);
+
+			symbol_free(p);
+		}
+	}
+
+	wire_frame_free(wf);
+}
+
+/* the convolutions cortex_process() has commented out */
+static void bench_suite_conv(FILE *out, int *first)
+{
+	SOM *s;
+	char params[256];
+	long i, ops = 5;
+	int size = 64, dim = 16;
+	double start, secs;
+
+	bench_reseed();
+	s = som_init(dim, 1000, size, size, NULL);
+	sprintf(params, "\"rows\": %d, \"cols\": %d, \"dim\": %d, "
+		"\"style\": \"blur_smear\"", size, size, dim);
+	start = bench_now();
+	for (i = 0; i < ops; i++)
+	{
+		conv_apply_easy(s, CONV_BLUR_SMEAR, .5, .1);
+	}
+	secs = bench_now() - start;
+	bench_result(out, first, "conv_apply", params, ops, secs);
+
+	sprintf(params, "\"rows\": %d, \"cols\": %d, \"dim\": %d, "
+		"\"style\": \"laplacian\"", size, size, dim);
+	start = bench_now();
+	for (i = 0; i < ops; i++)
+	{
+		conv_apply_easy(s, CONV_LAPLACIAN, 1, 1.0);
+	}
+	secs = bench_now() - start;
+	bench_result(out, first, "conv_apply", params, ops, secs);
+
+	som_free(s);
+}
+
+/* the inputs for frame i, glyphs or noise */
+static Symbol** bench_frame(Cortex *core, VInput *vinp, int glyphs, int i)
+{
+	Symbol **channels;
+	int j;
+
+	if (glyphs) {
+		return vinput_glyph(vinp, i % (9 * 16));
+	}
+
+	channels = (Symbol**)xmalloc(sizeof(Symbol*) * core->num_input);
+	for (j = 0; j < core->num_input; j++)
+	{
+		channels[j] = symbol_init(core->input[j].dim);
+		symbol_randomize(channels[j]);
+	}
+
+	return channels;
+}
+
+/* learn a while with each cortex, classify with it one frame at a time and
+	a batch at a time, then click around on it */
+static void bench_suite_cortex(FILE *out, int *first)
+{
+	Cortex *core;
+	CortexOutputTable *ctxout;
+	InputResTable *irt;
+	VInput *vinp;
+	Symbol **channels;
+	Symbol **frames[BENCH_BATCH];
+	Section *sec;
+	char buf[2048];
+	char params[256];
+	char *lctx = "bench.lctx";
+	char *lctxb = "bench.lctxb";
+	char *cache = "bench.lctxb-cache";
+	char *ckpt = "bench.ckpt";
+	char *ckpt_old = "bench.ckpt.old";
+	char *ckpt_tmp = "bench.ckpt.tmp";
+	CheckpointStats *stats;
+	Lctx *lc;
+	int i, j, k, glyphs, agents;
+	long ops = 500, clicks = 200, loads = 200;
+	double start, secs;
+
+	vinp = vinput_init(16, 16, 16, 16);
+
+	/* so the cold loads really are cold, and nothing is left behind */
+	setenv("MANIFOLD_LCTX_CACHE", cache, 1);
+
+	for (k = 0; bench_suite_ctx[k] != NULL; k++)
+	{
+		sprintf(buf, "./mojify %s %s > /dev/null", bench_suite_ctx[k], lctx);
+		if (system(buf) != 0)
+		{
+			printf("Problem running mojify on %s\n", bench_suite_ctx[k]);
+			exit(EXIT_FAILURE);
+		}
+		sprintf(params, "\"ctx\": \"%s\"", bench_suite_ctx[k]);
+
+		/* reading the description out of the .lctx and out of the .lctxb
+			of it, and then getting a .ctx the first time, which runs
+			mojify, and every time after that, out of the cache */
+		lc = lctx_read(lctx);
+		lctx_write(lc, lctxb);
+		lctx_free(lc);
+
+		start = bench_now();
+		for (i = 0; i < loads; i++)
+		{
+			lctx_free(lctx_read(lctx));
+		}
+		secs = bench_now() - start;
+		bench_result(out, first, "lctx_read_text", params, loads, secs);
+
+		start = bench_now();
+		for (i = 0; i < loads; i++)
+		{
+			lctx_free(lctx_read(lctxb));
+		}
+		secs = bench_now() - start;
+		bench_result(out, first, "lctx_read_binary", params, loads, secs);
+		unlink(lctxb);
+
+		start = bench_now();
+		lctx_free(lctx_compile(bench_suite_ctx[k]));
+		secs = bench_now() - start;
+		bench_result(out, first, "lctx_compile_cold", params, 1, secs);
+
+		start = bench_now();
+		for (i = 0; i < loads; i++)
+		{
+			lctx_free(lctx_compile(bench_suite_ctx[k]));
+		}
+		secs = bench_now() - start;
+		bench_result(out, first, "lctx_compile_cached", params, loads, secs);
+
+		remove_dir(cache);
+
+		bench_reseed();
+		core = cortex_init(lctx);
+		unlink(lctx);
+
+		/* the vision cortices get the glyphs, everyone else gets noise */
+		glyphs = core->num_input == 16;
+		for (i = 0; i < core->num_input; i++)
+		{
+			if (core->input[i].dim != 16) {
+				glyphs = FALSE;
+			}
+		}
+
+		start = bench_now();
+		for (i = 0; i < ops; i++)
+		{
+			channels = bench_frame(core, vinp, glyphs, i);
+			ctxout = cortex_process(core, channels, core->num_input,
+				CORTEX_REQUEST_LEARN);
+			free(channels);
+			cortex_output_table_free(ctxout);
+		}
+		secs = bench_now() - start;
+		bench_result(out, first, "cortex_process", params, ops, secs);
+
+		start = bench_now();
+		for (i = 0; i < ops; i++)
+		{
+			channels = bench_frame(core, vinp, glyphs, i);
+			ctxout = cortex_process(core, channels, core->num_input,
+				CORTEX_REQUEST_CLASSIFY);
+			free(channels);
+			cortex_output_table_free(ctxout);
+		}
+		secs = bench_now() - start;
+		bench_result(out, first, "cortex_classify", params, ops, secs);
+
+		sprintf(params, "\"ctx\": \"%s\", \"batch\": %d", 
+			bench_suite_ctx[k], BENCH_BATCH);
+		start = bench_now();
+		for (i = 0; i < ops; i += BENCH_BATCH)
+		{
+			for (j = 0; j < BENCH_BATCH; j++)
+			{
+				frames[j] = bench_frame(core, vinp, glyphs, i + j);
+			}
+			cortex_process_batch(core, frames, BENCH_BATCH, core->num_input,
+				CORTEX_REQUEST_CLASSIFY);
+			for (j = 0; j < BENCH_BATCH; j++)
+			{
+				free(frames[j]);
+			}
+		}
+		secs = bench_now() - start;
+		bench_result(out, first, "cortex_classify_batch", params, 
+			((ops + BENCH_BATCH - 1) / BENCH_BATCH) * BENCH_BATCH, secs);
+
+		/* learning again, but with the sections dealt out to one agent
+			process per processor */
+		agents = sysconf(_SC_NPROCESSORS_ONLN);
+		if (agents <= 0) {
+			agents = 1;
+		}
+		cortex_set_agents(core, agents);
+		sprintf(params, "\"ctx\": \"%s\", \"batch\": %d, \"agents\": %d",
+			bench_suite_ctx[k], BENCH_BATCH, agents);
+		start = bench_now();
+		for (i = 0; i < ops; i += BENCH_BATCH)
+		{
+			for (j = 0; j < BENCH_BATCH; j++)
+			{
+				frames[j] = bench_frame(core, vinp, glyphs, i + j);
+			}
+			cortex_process_batch(core, frames, BENCH_BATCH, core->num_input,
+				CORTEX_REQUEST_LEARN);
+			for (j = 0; j < BENCH_BATCH; j++)
+			{
+				free(frames[j]);
+			}
+		}
+		cortex_set_agents(core, 0);
+		secs = bench_now() - start;
+		bench_result(out, first, "cortex_process_agents", params,
+			((ops + BENCH_BATCH - 1) / BENCH_BATCH) * BENCH_BATCH, secs);
+		sprintf(params, "\"ctx\": \"%s\"", bench_suite_ctx[k]);
+
+		/* a checkpoint with the cortex waiting on it, and then learning
+			with one going in the background every so often, where what
+			matters is how long the cortex was held up to start them */
+		start = bench_now();
+		cortex_checkpoint(core, ckpt);
+		secs = bench_now() - start;
+		bench_result(out, first, "cortex_checkpoint", params, 1, secs);
+
+		cortex_set_checkpoint(core, ckpt, BENCH_CHECKPOINT_EVERY, 0);
+		start = bench_now();
+		for (i = 0; i < ops; i++)
+		{
+			channels = bench_frame(core, vinp, glyphs, i);
+			ctxout = cortex_process(core, channels, core->num_input,
+				CORTEX_REQUEST_LEARN);
+			free(channels);
+			cortex_output_table_free(ctxout);
+		}
+		secs = bench_now() - start;
+		cortex_set_checkpoint(core, NULL, 0, 0);
+		bench_result(out, first, "cortex_process_checkpointing", params, ops,
+			secs);
+		stats = cortex_checkpoint_stats(core);
+		if (stats->started > 0) {
+			bench_result(out, first, "cortex_checkpoint_stall", params,
+				stats->started, stats->total_stall);
+		}
+		if (stats->written > 0) {
+			bench_result(out, first, "cortex_checkpoint_write", params,
+				stats->written, stats->total_write);
+		}
+		/* and the same checkpoint again after a little more learning, but
+			only the tiles that changed, as floats and as half float deltas */
+		for (j = 0; j < 2; j++)
+		{
+			cortex_set_checkpoint_incremental(core, j == 0 ? 
+				CHECKPOINT_TILES_FP32 : CHECKPOINT_TILES_FP16_DELTA, 0);
+			cortex_checkpoint(core, ckpt);
+			for (i = 0; i < BENCH_CHECKPOINT_EVERY; i++)
+			{
+				channels = bench_frame(core, vinp, glyphs, i);
+				ctxout = cortex_process(core, channels, core->num_input,
+					CORTEX_REQUEST_LEARN);
+				free(channels);
+				cortex_output_table_free(ctxout);
+			}
+			start = bench_now();
+			cortex_checkpoint(core, ckpt);
+			secs = bench_now() - start;
+			sprintf(params, "\"ctx\": \"%s\", \"bytes\": %lu", 
+				bench_suite_ctx[k], stats->last_bytes);
+			bench_result(out, first, j == 0 ? "cortex_checkpoint_tiles" :
+				"cortex_checkpoint_tiles_fp16", params, 1, secs);
+		}
+		cortex_set_checkpoint_incremental(core, CHECKPOINT_FULL, 0);
+		sprintf(params, "\"ctx\": \"%s\"", bench_suite_ctx[k]);
+
+		remove_dir(ckpt);
+		remove_dir(ckpt_old);
+		remove_dir(ckpt_tmp);
+
+		/* click on random neurons in random sections */
+		start = bench_now();
+		for (i = 0; i < clicks; i++)
+		{
+			sec = &core->sec[lrand48() % core->num_sec];
+			irt = cortex_resolve(core,
+				sec->y + (lrand48() % som_get_rows(sec->som)),
+				sec->x + (lrand48() % som_get_cols(sec->som)));
+			if (irt != NULL) {
+				inputrestable_destroy(irt);
+			}
+		}
+		secs = bench_now() - start;
+		bench_result(out, first, "cortex_resolve", params, clicks, secs);
+
+		cortex_free(core);
+	}
+
+	unsetenv("MANIFOLD_LCTX_CACHE");
+	vinput_destroy(vinp);
+}
+
+static void bench_suite(int argc, char **argv)
+{
+	FILE *out = stdout;
+	int first = TRUE;
+
+	if (argc >= 3)
+	{
+		out = fopen(argv[2], "w");
+		if (out == NULL)
+		{
+			printf("Could not open %s: %d(%s)\n", argv[2], errno,
+				strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	fprintf(out, "{\n");
+	fprintf(out, "  \"seed\": %d,\n", BENCH_SEED);
+	fprintf(out, "  \"kernel\": \"%s\",\n", kernel_name());
+	fprintf(out, "  \"results\": [\n");
+	bench_suite_symbol(out, &first);
+	bench_suite_som(out, &first);
+	bench_suite_conv(out, &first);
+	bench_suite_wire(out, &first);
+	bench_suite_cortex(out, &first);
+	fprintf(out, "\n  ]\n");
+	fprintf(out, "}\n");
+
+	if (out != stdout) {
+		fclose(out);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	char buf[2048];
+	char *ctx = "vision.ctx";
+	char *lctx = "bench.lctx";
+	int num_glyphs = BENCH_DEFAULT_GLYPHS;
+	double secs;
+	unsigned long steady_heap;
+
+	if (argc >= 2 && strcmp(argv[1], "bmu") == 0) {
+		bench_bmu(argc, argv);
+		return 0;
+	}
+
+	if (argc >= 2 && strcmp(argv[1], "suite") == 0) {
+		bench_suite(argc, argv);
+		return 0;
+	}
+
+	if (argc >= 2) {
+		ctx = argv[1];
+	}
+	if (argc >= 3) {
+		num_glyphs = atoi(argv[2]);
+		if (num_glyphs <= 0)
+		{
+			printf("Number of glyphs must be positive: %s\n", argv[2]);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	/* translate the cortex file into something cortex_init() can read */
+	sprintf(buf, "./mojify %s %s", ctx, lctx);
+	if (system(buf) != 0)
+	{
+		printf("Problem running mojify...%d(%s)\n", errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	srand(BENCH_SEED);
+	srand48(BENCH_SEED);
+
+	secs = bench_cortex_vision(lctx, num_glyphs, &steady_heap);
+
+	printf("%s: %d glyphs in %f seconds, %f glyphs per second\n",
+		ctx, num_glyphs, secs, (double)num_glyphs / secs);
+	printf("%s: %lu heap calls by cortex_process_into() over the last %d glyphs\n",
+		ctx, steady_heap, num_glyphs - num_glyphs / 2);
+
+	unlink(lctx);
+
+	return 0;
+}
@@ -0,0 +1,1146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <math.h>
+#include "manifold.h"
+
+static void checkpoint_name(char *buf, char *dir, char *name);
+static void checkpoint_write_dir(Cortex *core, char *path);
+static void checkpoint_write_delta(Cortex *core, char *path);
+static void checkpoint_sections(Cortex *core, CortexCheckpointer *ck);
+static int checkpoint_prepare(Cortex *core, char *path);
+static void checkpoint_record(CortexCheckpointer *ck, int i, SOM *s);
+static void checkpoint_replay(SOM *s, char *dir, int i, unsigned long len);
+static void checkpoint_write(int fd, void *buf, size_t len, char *file);
+static void checkpoint_read(int fd, void *buf, size_t len, char *file);
+static void checkpoint_write_state(Cortex *core, char *file);
+static void checkpoint_read_state(Cortex *core, char *dir, char *file);
+static double checkpoint_now(void);
+static CortexCheckpointer* checkpoint_get(Cortex *core);
+static void checkpoint_start(Cortex *core, char *path);
+static void checkpoint_reap(Cortex *core, int hang);
+
+/* buf has room for PATH_MAX */
+static void checkpoint_name(char *buf, char *dir, char *name)
+{
+	if (snprintf(buf, PATH_MAX, "%s/%s", dir, name) >= PATH_MAX)
+	{
+		printf("checkpoint_name(): %s/%s is too long!\n", dir, name);
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void checkpoint_write(int fd, void *buf, size_t len, char *file)
+{
+	if (writen(fd, buf, len) != (ssize_t)len)
+	{
+		printf("checkpoint_write(): Couldn't write %s: %d(%s)\n", file,
+			errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void checkpoint_read(int fd, void *buf, size_t len, char *file)
+{
+	if (readn(fd, buf, len) != (ssize_t)len)
+	{
+		printf("checkpoint_read(): %s is cut off!\n", file);
+		exit(EXIT_FAILURE);
+	}
+}
+
+void cortex_checkpoint(Cortex *core, char *path)
+{
+	if (core->pipe.num_waiting != 0 ||
+		core->pipe.next_done < core->pipe.num_done)
+	{
+		printf("cortex_checkpoint(): The pipeline has to be flushed "
+			"first!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* the real sections are out in the agents */
+	if (core->agents != NULL) {
+		agents_sync(core);
+	}
+
+	if (checkpoint_prepare(core, path) == TRUE) {
+		checkpoint_write_dir(core, path);
+	} else {
+		checkpoint_write_delta(core, path);
+	}
+}
+
+/* write out the checkpoint, the sections have to already be here */
+static void checkpoint_write_dir(Cortex *core, char *path)
+{
+	char tmp[PATH_MAX], old[PATH_MAX], file[PATH_MAX], name[64];
+	int i, fd;
+
+	if (snprintf(tmp, PATH_MAX, "%s.tmp", path) >= PATH_MAX ||
+		snprintf(old, PATH_MAX, "%s.old", path) >= PATH_MAX)
+	{
+		printf("checkpoint_write_dir(): %s is too long!\n", path);
+		exit(EXIT_FAILURE);
+	}
+
+	/* whatever is left over from a checkpoint that didn't finish */
+	remove_dir(tmp);
+	if (mkdir(tmp, 0755) < 0)
+	{
+		printf("checkpoint_write_dir(): Couldn't make %s: %d(%s)\n", tmp,
+			errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	checkpoint_name(file, tmp, "topology.lctx");
+	fd = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		printf("checkpoint_write_dir(): Couldn't open %s: %d(%s)\n", file,
+			errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	checkpoint_write(fd, core->topology, core->topology_len, file);
+	if (fsync(fd) < 0)
+	{
+		printf("checkpoint_write_dir(): Couldn't sync %s: %d(%s)\n", file,
+			errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	close(fd);
+
+	for (i = 0; i < core->num_sec; i++)
+	{
+		sprintf(name, "sec%d.som", i);
+		checkpoint_name(file, tmp, name);
+		som_save(core->sec[i].som, file);
+	}
+
+	checkpoint_name(file, tmp, "state");
+	checkpoint_write_state(core, file);
+
+	/* and swap it in for the last one */
+	remove_dir(old);
+	if (rename(path, old) < 0 && errno != ENOENT)
+	{
+		printf("checkpoint_write_dir(): Couldn't move %s out of the way: "
+			"%d(%s)\n", path, errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	if (rename(tmp, path) < 0)
+	{
+		printf("checkpoint_write_dir(): Couldn't rename %s to %s: %d(%s)\n",
+			tmp, path, errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	remove_dir(old);
+}
+
+static void checkpoint_write_state(Cortex *core, char *file)
+{
+	CheckpointHeader hdr;
+	CheckpointSection cs;
+	CheckpointQueue cq;
+	WireFrame *wf;
+	Section *sec;
+	IntQueue *iq;
+	Symbol view;
+	int i, j, k, s, row, fd;
+
+	fd = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		printf("checkpoint_write_state(): Couldn't open %s: %d(%s)\n", file,
+			errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	memset(&hdr, 0, sizeof(CheckpointHeader));
+	hdr.magic = CHECKPOINT_MAGIC;
+	hdr.version = CHECKPOINT_VERSION;
+	hdr.topology_hash = core->topology_hash;
+	hdr.num_sec = core->num_sec;
+	hdr.num_input = core->num_input;
+	hdr.num_steps = core->num_steps;
+	hdr.generation = core->ckpt->generation;
+	checkpoint_write(fd, &hdr, sizeof(CheckpointHeader), file);
+
+	wf = wire_frame_init();
+
+	for (i = 0; i < core->num_sec; i++)
+	{
+		sec = &core->sec[i];
+
+		memset(&cs, 0, sizeof(CheckpointSection));
+		cs.serial_id = sec->serial_id;
+		cs.state = sec->state;
+		cs.learn_row = sec->secdisp.learn_row;
+		cs.learn_col = sec->secdisp.learn_col;
+		cs.batch_num = sec->batch_num;
+		cs.num_slot = sec->receptor.num_slot;
+		cs.log_len = core->ckpt->log_len[i];
+		checkpoint_write(fd, &cs, sizeof(CheckpointSection), file);
+
+		wire_frame_clear(wf);
+		for (j = 0; j < sec->batch_num; j++)
+		{
+			wire_frame_add(wf, sec->batch[j], j, i, sec->receptor.num_slot,
+				WIRE_FP32);
+		}
+
+		for (j = 0; j < sec->receptor.num_slot; j++)
+		{
+			iq = sec->receptor.slot[j].iq;
+
+			memset(&cq, 0, sizeof(CheckpointQueue));
+			cq.dim = iq->dim;
+			cq.num_syms = iq->num_syms;
+			cq.num_slices = iq->num_slices;
+			cq.curr_slice = iq->curr_slice;
+			cq.ready = iq->ready;
+			cq.ready_slice = iq->ready_slice;
+			checkpoint_write(fd, &cq, sizeof(CheckpointQueue), file);
+			checkpoint_write(fd, iq->head, sizeof(int) * iq->num_slices, file);
+			checkpoint_write(fd, iq->count, sizeof(int) * iq->num_slices,
+				file);
+
+			/* only the rows that have something in them, the newest count
+				of them before the head */
+			for (s = 0; s < iq->num_slices; s++)
+			{
+				for (k = 0; k < iq->count[s]; k++)
+				{
+					row = (iq->head[s] - iq->count[s] + k + iq->num_syms) %
+						iq->num_syms;
+					intqueue_row(iq, s, row, &view);
+					wire_frame_add(wf, &view, s * iq->num_syms + row, i, j,
+						WIRE_FP32);
+				}
+			}
+		}
+
+		wire_frame_write(fd, wf);
+	}
+
+	wire_frame_free(wf);
+
+	if (fsync(fd) < 0)
+	{
+		printf("checkpoint_write_state(): Couldn't sync %s: %d(%s)\n", file,
+			errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	close(fd);
+}
+
+Cortex* cortex_restore(char *path)
+{
+	char dir[PATH_MAX], file[PATH_MAX], name[64];
+	Cortex *core;
+	SOM *s;
+	int i, num_agents;
+
+	/* if the newest one didn't make it into place, the last one is whole */
+	checkpoint_name(file, path, "state");
+	if (access(file, R_OK) == 0) {
+		snprintf(dir, PATH_MAX, "%s", path);
+	} else if (snprintf(dir, PATH_MAX, "%s.old", path) >= PATH_MAX) {
+		printf("cortex_restore(): %s is too long!\n", path);
+		exit(EXIT_FAILURE);
+	}
+
+	checkpoint_name(file, dir, "topology.lctx");
+	core = cortex_init(file);
+
+	/* the SOMs have to be in place before the agents get copies of them */
+	num_agents = core->agents != NULL ? core->agents->num_agents : 0;
+	cortex_set_agents(core, 0);
+
+	for (i = 0; i < core->num_sec; i++)
+	{
+		sprintf(name, "sec%d.som", i);
+		checkpoint_name(file, dir, name);
+		s = som_load(file);
+		if (s == NULL ||
+			som_get_dimension(s) != som_get_dimension(core->sec[i].som) ||
+			som_get_rows(s) != som_get_rows(core->sec[i].som) ||
+			som_get_cols(s) != som_get_cols(core->sec[i].som))
+		{
+			printf("cortex_restore(): %s isn't the SOM of section %s!\n",
+				file, core->sec[i].name);
+			exit(EXIT_FAILURE);
+		}
+
+		som_free(core->sec[i].som);
+		core->sec[i].som = s;
+		som_set_pool(s, core->pool);
+	}
+
+	checkpoint_name(file, dir, "state");
+	checkpoint_read_state(core, dir, file);
+
+	if (num_agents > 0) {
+		cortex_set_agents(core, num_agents);
+	}
+
+	return core;
+}
+
+static void checkpoint_read_state(Cortex *core, char *dir, char *file)
+{
+	CheckpointHeader hdr;
+	CheckpointSection cs;
+	CheckpointQueue cq;
+	WireFrame *wf;
+	Section *sec;
+	IntQueue *iq;
+	Symbol *sym;
+	unsigned int step;
+	int i, j, n, where, slot, fd;
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0)
+	{
+		printf("checkpoint_read_state(): Couldn't open %s: %d(%s)\n", file,
+			errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	checkpoint_read(fd, &hdr, sizeof(CheckpointHeader), file);
+	if (hdr.magic != CHECKPOINT_MAGIC || hdr.version != CHECKPOINT_VERSION)
+	{
+		printf("checkpoint_read_state(): %s isn't a version %d checkpoint "
+			"from a machine like this one!\n", file, CHECKPOINT_VERSION);
+		exit(EXIT_FAILURE);
+	}
+	if (hdr.topology_hash != core->topology_hash)
+	{
+		printf("checkpoint_read_state(): %s is from a cortex with a "
+			"different topology (%llx, this one is %llx)!\n", file,
+			hdr.topology_hash, core->topology_hash);
+		exit(EXIT_FAILURE);
+	}
+	if (hdr.num_sec != core->num_sec || hdr.num_input != core->num_input)
+	{
+		printf("checkpoint_read_state(): %s has %d sections and %d inputs, "
+			"but its topology has %d and %d!\n", file, hdr.num_sec,
+			hdr.num_input, core->num_sec, core->num_input);
+		exit(EXIT_FAILURE);
+	}
+	core->num_steps = hdr.num_steps;
+
+	wf = wire_frame_init();
+
+	for (i = 0; i < core->num_sec; i++)
+	{
+		sec = &core->sec[i];
+
+		checkpoint_read(fd, &cs, sizeof(CheckpointSection), file);
+		if (cs.serial_id != sec->serial_id ||
+			cs.num_slot != sec->receptor.num_slot ||
+			cs.batch_num < 0 || cs.batch_num > sec->batch_size)
+		{
+			printf("checkpoint_read_state(): Section %d of %s doesn't go with "
+				"section %s!\n", i, file, sec->name);
+			exit(EXIT_FAILURE);
+		}
+		sec->state = cs.state;
+		sec->secdisp.learn_row = cs.learn_row;
+		sec->secdisp.learn_col = cs.learn_col;
+		sec->batch_num = cs.batch_num;
+
+		/* what changed since its SOM was written */
+		checkpoint_replay(sec->som, dir, i, cs.log_len);
+
+		for (j = 0; j < sec->receptor.num_slot; j++)
+		{
+			iq = sec->receptor.slot[j].iq;
+
+			checkpoint_read(fd, &cq, sizeof(CheckpointQueue), file);
+			if (cq.num_syms != iq->num_syms ||
+				cq.num_slices != iq->num_slices || cq.dim < 0 ||
+				cq.curr_slice < 0 || cq.curr_slice >= iq->num_slices)
+			{
+				printf("checkpoint_read_state(): Slot %d of section %s in %s "
+					"doesn't go with this cortex!\n", j, sec->name, file);
+				exit(EXIT_FAILURE);
+			}
+
+			/* the rows come in with the wire frame */
+			if (cq.dim != iq->dim)
+			{
+				free(iq->ring);
+				iq->ring = NULL;
+				iq->dim = cq.dim;
+			}
+			iq->curr_slice = cq.curr_slice;
+			iq->ready = cq.ready;
+			iq->ready_slice = cq.ready_slice;
+			checkpoint_read(fd, iq->head, sizeof(int) * iq->num_slices, file);
+			checkpoint_read(fd, iq->count, sizeof(int) * iq->num_slices, file);
+		}
+
+		if (wire_frame_read(fd, wf) == FALSE)
+		{
+			printf("checkpoint_read_state(): %s is cut off!\n", file);
+			exit(EXIT_FAILURE);
+		}
+
+		for (n = 0; n < wire_frame_num(wf); n++)
+		{
+			sym = wire_frame_symbol(wf, n, &step, &where, &slot);
+			if (where != i || slot > sec->receptor.num_slot)
+			{
+				printf("checkpoint_read_state(): %s has a symbol for section "
+					"%d slot %d in with section %d!\n", file, where, slot, i);
+				exit(EXIT_FAILURE);
+			}
+
+			if (slot == sec->receptor.num_slot)
+			{
+				/* one of the batch */
+				if (step >= (unsigned int)sec->batch_num)
+				{
+					printf("checkpoint_read_state(): %s has too big of a "
+						"batch for section %s!\n", file, sec->name);
+					exit(EXIT_FAILURE);
+				}
+				if (sec->batch[step] == NULL ||
+					sec->batch[step]->dim != sym->dim)
+				{
+					symbol_free(sec->batch[step]);
+					sec->batch[step] = symbol_init(sym->dim);
+				}
+				symbol_move(sec->batch[step], sym);
+				continue;
+			}
+
+			iq = sec->receptor.slot[slot].iq;
+			intqueue_put_row(iq, step / iq->num_syms, step % iq->num_syms,
+				sym);
+		}
+	}
+
+	wire_frame_free(wf);
+	close(fd);
+}
+
+static double checkpoint_now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+/* the cortex's checkpointer, made the first time it is needed */
+static CortexCheckpointer* checkpoint_get(Cortex *core)
+{
+	CortexCheckpointer *ck;
+
+	if (core->ckpt != NULL) {
+		return core->ckpt;
+	}
+
+	ck = (CortexCheckpointer*)xmalloc(sizeof(CortexCheckpointer));
+	memset(ck, 0, sizeof(CortexCheckpointer));
+	ck->path = NULL;
+	ck->pid = 0;
+	ck->fd = -1;
+	core->ckpt = ck;
+
+	return ck;
+}
+
+void cortex_set_checkpoint(Cortex *core, char *path, 
+	unsigned long every_steps, double every_secs)
+{
+	CortexCheckpointer *ck;
+
+	if (path == NULL)
+	{
+		if (core->ckpt == NULL) {
+			return;
+		}
+		ck = core->ckpt;
+		checkpoint_reap(core, TRUE);
+		free(ck->path);
+		ck->path = NULL;
+		ck->every_steps = 0;
+		ck->every_secs = 0;
+		return;
+	}
+
+	ck = checkpoint_get(core);
+	free(ck->path);
+	ck->path = strdup(path);
+	ck->every_steps = every_steps;
+	ck->every_secs = every_secs;
+	ck->last_step = core->num_steps;
+	ck->last_time = checkpoint_now();
+}
+
+void cortex_checkpoint_background(Cortex *core, char *path)
+{
+	if (core->pipe.num_waiting != 0 ||
+		core->pipe.next_done < core->pipe.num_done)
+	{
+		printf("cortex_checkpoint_background(): The pipeline has to be "
+			"flushed first!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	checkpoint_start(core, path);
+}
+
+int cortex_checkpoint_wait(Cortex *core)
+{
+	CortexCheckpointer *ck = core->ckpt;
+	unsigned long failed;
+
+	if (ck == NULL) {
+		return TRUE;
+	}
+
+	failed = ck->stats.failed;
+	checkpoint_reap(core, TRUE);
+
+	return ck->stats.failed == failed;
+}
+
+CheckpointStats* cortex_checkpoint_stats(Cortex *core)
+{
+	if (core->ckpt == NULL) {
+		return NULL;
+	}
+
+	return &core->ckpt->stats;
+}
+
+void checkpoint_stats_stdout(CheckpointStats *stats)
+{
+	printf("Checkpoints: %lu started, %lu written, %lu failed\n",
+		stats->started, stats->written, stats->failed);
+	printf("\t%lu full, %lu incremental, last %lu bytes, total %lu bytes\n",
+		stats->full, stats->incremental, stats->last_bytes, 
+		stats->total_bytes);
+	if (stats->started > 0) {
+		printf("\tStall: last %.6fs, max %.6fs, mean %.6fs\n",
+			stats->last_stall, stats->max_stall, 
+			stats->total_stall / stats->started);
+	}
+	if (stats->written > 0) {
+		printf("\tWrite: last %.6fs, max %.6fs, mean %.6fs\n",
+			stats->last_write, stats->max_write, 
+			stats->total_write / stats->written);
+	}
+}
+
+void checkpoint_step(Cortex *core)
+{
+	CortexCheckpointer *ck = core->ckpt;
+	int due = FALSE;
+	double now;
+
+	if (ck == NULL) {
+		return;
+	}
+
+	if (ck->pid != 0) {
+		checkpoint_reap(core, FALSE);
+	}
+
+	if (ck->path == NULL || ck->pid != 0) {
+		return;
+	}
+
+	if (ck->every_steps > 0 && 
+		core->num_steps - ck->last_step >= ck->every_steps)
+	{
+		due = TRUE;
+	}
+
+	if (due == FALSE && ck->every_secs > 0)
+	{
+		now = checkpoint_now();
+		if (now - ck->last_time >= ck->every_secs) {
+			due = TRUE;
+		}
+	}
+
+	if (due == TRUE) {
+		checkpoint_start(core, ck->path);
+	}
+}
+
+/* fork off a copy of the cortex as it is right now to write the checkpoint */
+static void checkpoint_start(Cortex *core, char *path)
+{
+	CortexCheckpointer *ck = checkpoint_get(core);
+	double start, stall, took;
+	int fds[2], full;
+	pid_t pid;
+
+	/* one at a time */
+	if (ck->pid != 0) {
+		checkpoint_reap(core, TRUE);
+	}
+
+	start = checkpoint_now();
+
+	/* the real sections are out in the agents */
+	if (core->agents != NULL) {
+		agents_sync(core);
+	}
+
+	/* the SOMs start over clean as the fork is taken */
+	full = checkpoint_prepare(core, path);
+
+	if (pipe(fds) < 0)
+	{
+		printf("checkpoint_start(): Couldn't make a pipe: %d(%s)\n", errno,
+			strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	/* or the child would print it again */
+	fflush(stdout);
+	fflush(stderr);
+
+	pid = fork();
+	if (pid < 0)
+	{
+		printf("checkpoint_start(): Couldn't fork: %d(%s)\n", errno,
+			strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	if (pid == 0)
+	{
+		/* Only this thread came along, and none of the pool's threads
+			were doing anything between steps anyway. Anything going wrong
+			in here exits and the parent counts it as failed. */
+		close(fds[0]);
+		took = checkpoint_now();
+		if (full == TRUE) {
+			checkpoint_write_dir(core, path);
+		} else {
+			checkpoint_write_delta(core, path);
+		}
+		took = checkpoint_now() - took;
+		if (writen(fds[1], &took, sizeof(double)) != sizeof(double)) {
+			_exit(EXIT_FAILURE);
+		}
+		_exit(EXIT_SUCCESS);
+	}
+
+	close(fds[1]);
+	ck->pid = pid;
+	ck->fd = fds[0];
+	ck->last_step = core->num_steps;
+	ck->last_time = checkpoint_now();
+
+	stall = ck->last_time - start;
+	ck->stats.started++;
+	ck->stats.last_stall = stall;
+	ck->stats.total_stall += stall;
+	if (stall > ck->stats.max_stall) {
+		ck->stats.max_stall = stall;
+	}
+}
+
+/* see if the checkpoint being written is done, waiting for it if hang is
+	TRUE */
+static void checkpoint_reap(Cortex *core, int hang)
+{
+	CortexCheckpointer *ck = core->ckpt;
+	double took;
+	int status;
+	pid_t ret;
+
+	if (ck == NULL || ck->pid == 0) {
+		return;
+	}
+
+	while((ret = waitpid(ck->pid, &status, hang == TRUE ? 0 : WNOHANG)) < 0 &&
+		errno == EINTR)
+	{
+		/* try again */
+	}
+
+	if (ret == 0) {
+		/* still writing */
+		return;
+	}
+
+	if (ret > 0 && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS &&
+		readn(ck->fd, &took, sizeof(double)) == sizeof(double))
+	{
+		ck->stats.written++;
+		ck->stats.last_write = took;
+		ck->stats.total_write += took;
+		if (took > ck->stats.max_write) {
+			ck->stats.max_write = took;
+		}
+	}
+	else
+	{
+		/* the logs on the disk don't have what the SOMs forgot about */
+		ck->stats.failed++;
+		ck->full_next = TRUE;
+	}
+
+	close(ck->fd);
+	ck->fd = -1;
+	ck->pid = 0;
+}
+
+void cortex_set_checkpoint_incremental(Cortex *core, int encoding,
+	int compact_every)
+{
+	CortexCheckpointer *ck;
+
+	if (encoding != CHECKPOINT_FULL && encoding != CHECKPOINT_TILES_FP32 &&
+		encoding != CHECKPOINT_TILES_FP16_DELTA)
+	{
+		printf("cortex_set_checkpoint_incremental(): Unknown encoding %d!\n",
+			encoding);
+		exit(EXIT_FAILURE);
+	}
+
+	ck = checkpoint_get(core);
+
+	/* the deltas would be from a shadow nobody kept up */
+	if (encoding != ck->encoding) {
+		ck->full_next = TRUE;
+	}
+
+	ck->encoding = encoding;
+	ck->compact_every = compact_every;
+}
+
+void checkpoint_free(Cortex *core)
+{
+	CortexCheckpointer *ck = core->ckpt;
+	int i;
+
+	if (ck == NULL) {
+		return;
+	}
+
+	/* let the last one finish */
+	cortex_set_checkpoint(core, NULL, 0, 0);
+
+	for (i = 0; i < ck->num_sec; i++)
+	{
+		free(ck->rec[i]);
+		free(ck->shadow[i]);
+	}
+	free(ck->rec);
+	free(ck->rec_len);
+	free(ck->rec_room);
+	free(ck->shadow);
+	free(ck->log_len);
+	free(ck->base);
+	free(ck);
+	core->ckpt = NULL;
+}
+
+/* make room to keep track of each section's log */
+static void checkpoint_sections(Cortex *core, CortexCheckpointer *ck)
+{
+	SOM *s;
+	int i;
+
+	if (ck->num_sec == core->num_sec) {
+		return;
+	}
+
+	ck->num_sec = core->num_sec;
+	ck->log_len = 
+		(unsigned long*)xmalloc(sizeof(unsigned long) * ck->num_sec);
+	ck->rec = (unsigned char**)xmalloc(sizeof(unsigned char*) * ck->num_sec);
+	ck->rec_len = 
+		(unsigned long*)xmalloc(sizeof(unsigned long) * ck->num_sec);
+	ck->rec_room = 
+		(unsigned long*)xmalloc(sizeof(unsigned long) * ck->num_sec);
+	ck->shadow = (float**)xmalloc(sizeof(float*) * ck->num_sec);
+	ck->log_total = 0;
+	ck->som_total = 0;
+
+	for (i = 0; i < ck->num_sec; i++)
+	{
+		s = core->sec[i].som;
+		ck->log_len[i] = 0;
+		ck->rec[i] = NULL;
+		ck->rec_len[i] = 0;
+		ck->rec_room[i] = 0;
+		ck->shadow[i] = NULL;
+		ck->som_total += sizeof(float) * 
+			(unsigned long)s->sd.rows * s->sd.cols * (s->stride + 1);
+	}
+}
+
+/* Decide whether this checkpoint is a full one and if it isn't, make the
+	records of what changed. Either way the SOMs start over clean, so this
+	happens here and not in whoever does the writing. Returns TRUE if it is
+	a full one. */
+static int checkpoint_prepare(Cortex *core, char *path)
+{
+	CortexCheckpointer *ck = checkpoint_get(core);
+	unsigned long bytes = 0;
+	SOM *s;
+	int i, full;
+
+	checkpoint_sections(core, ck);
+
+	full = ck->encoding == CHECKPOINT_FULL || ck->base == NULL ||
+		strcmp(ck->base, path) != 0 || ck->full_next == TRUE ||
+		(ck->compact_every > 0 && ck->num_deltas >= ck->compact_every) ||
+		ck->log_total > ck->som_total;
+
+	ck->generation++;
+
+	if (full == TRUE)
+	{
+		for (i = 0; i < ck->num_sec; i++)
+		{
+			s = core->sec[i].som;
+			som_clean(s);
+			ck->log_len[i] = 0;
+			ck->rec_len[i] = 0;
+
+			/* the deltas start from exactly what is being written */
+			if (ck->encoding == CHECKPOINT_TILES_FP16_DELTA)
+			{
+				if (ck->shadow[i] == NULL) {
+					ck->shadow[i] = (float*)xmalloc(sizeof(float) * 
+						s->sd.rows * s->sd.cols * s->stride);
+				}
+				memcpy(ck->shadow[i], s->slab, 
+					sizeof(float) * s->sd.rows * s->sd.cols * s->stride);
+			}
+		}
+
+		ck->log_total = 0;
+		ck->num_deltas = 0;
+		ck->full_next = FALSE;
+		free(ck->base);
+		ck->base = strdup(path);
+		bytes = ck->som_total;
+		ck->stats.full++;
+	}
+	else
+	{
+		for (i = 0; i < ck->num_sec; i++)
+		{
+			s = core->sec[i].som;
+			checkpoint_record(ck, i, s);
+			som_clean(s);
+			ck->log_len[i] += ck->rec_len[i];
+			ck->log_total += ck->rec_len[i];
+			bytes += ck->rec_len[i];
+		}
+
+		ck->num_deltas++;
+		ck->stats.incremental++;
+	}
+
+	ck->stats.last_bytes = bytes;
+	ck->stats.total_bytes += bytes;
+
+	return full;
+}
+
+/* put the dirty tiles of section i's SOM into its next log record */
+static void checkpoint_record(CortexCheckpointer *ck, int i, SOM *s)
+{
+	CheckpointTiles th;
+	unsigned long need;
+	unsigned int tile, enc;
+	unsigned short *h;
+	unsigned char *p;
+	float *w, *sh, d;
+	int t, r, k, n, srow, scol, erow, ecol, halves;
+
+	/* enough for every tile as floats */
+	need = sizeof(CheckpointTiles) + 
+		(unsigned long)s->tile_rows * s->tile_cols * 2 * sizeof(unsigned int) +
+		sizeof(float) * (unsigned long)s->sd.rows * s->sd.cols * 
+		(s->stride + 1);
+	if (ck->rec_room[i] < need)
+	{
+		free(ck->rec[i]);
+		ck->rec[i] = (unsigned char*)xmalloc(need);
+		ck->rec_room[i] = need;
+	}
+
+	memset(&th, 0, sizeof(CheckpointTiles));
+	p = ck->rec[i] + sizeof(CheckpointTiles);
+
+	for (t = 0; t < s->tile_rows * s->tile_cols; t++)
+	{
+		if (s->dirty[t] == FALSE) {
+			continue;
+		}
+		som_tile_box(s, t, &srow, &scol, &erow, &ecol);
+		n = (ecol - scol + 1) * s->stride;
+
+		/* anything a half float can't hold makes the tile floats */
+		enc = ck->encoding;
+		if (enc == CHECKPOINT_TILES_FP16_DELTA)
+		{
+			for (r = srow; r <= erow && enc != CHECKPOINT_TILES_FP32; r++)
+			{
+				w = s->slab + (SOM_ADR(r, scol, s) * s->stride);
+				sh = ck->shadow[i] + (SOM_ADR(r, scol, s) * s->stride);
+				for (k = 0; k < n; k++)
+				{
+					d = w[k] - sh[k];
+					if (!(fabsf(d) <= 65504.0)) {
+						enc = CHECKPOINT_TILES_FP32;
+						break;
+					}
+				}
+			}
+		}
+
+		tile = t;
+		memcpy(p, &tile, sizeof(unsigned int));
+		memcpy(p + sizeof(unsigned int), &enc, sizeof(unsigned int));
+		p += 2 * sizeof(unsigned int);
+
+		halves = 0;
+		for (r = srow; r <= erow; r++)
+		{
+			w = s->slab + (SOM_ADR(r, scol, s) * s->stride);
+			sh = ck->shadow[i] == NULL ? NULL :
+				ck->shadow[i] + (SOM_ADR(r, scol, s) * s->stride);
+
+			if (enc == CHECKPOINT_TILES_FP32)
+			{
+				memcpy(p, w, sizeof(float) * n);
+				p += sizeof(float) * n;
+				if (sh != NULL) {
+					memcpy(sh, w, sizeof(float) * n);
+				}
+				continue;
+			}
+
+			/* the shadow moves by what the restore will see */
+			h = (unsigned short*)p;
+			for (k = 0; k < n; k++)
+			{
+				h[k] = wire_float_to_half(w[k] - sh[k]);
+				sh[k] += wire_half_to_float(h[k]);
+			}
+			p += sizeof(unsigned short) * n;
+			halves += n;
+		}
+		if (halves % 2 != 0) {
+			memset(p, 0, sizeof(unsigned short));
+			p += sizeof(unsigned short);
+		}
+
+		for (r = srow; r <= erow; r++)
+		{
+			memcpy(p, s->qmap + SOM_ADR(r, scol, s), 
+				sizeof(float) * (ecol - scol + 1));
+			p += sizeof(float) * (ecol - scol + 1);
+		}
+
+		th.num_tiles++;
+	}
+
+	th.magic = CHECKPOINT_TILES_MAGIC;
+	th.generation = ck->generation;
+	th.current_iter = s->current_iter;
+	th.mode = s->mode;
+	th.bmu_row = s->bmu_row;
+	th.bmu_col = s->bmu_col;
+	th.final_computation = s->final_computation;
+	th.max_dist = s->max_dist;
+	th.rand_seed = s->rand_seed;
+	th.bytes = (p - ck->rec[i]) - sizeof(CheckpointTiles);
+	memcpy(ck->rec[i], &th, sizeof(CheckpointTiles));
+
+	ck->rec_len[i] = p - ck->rec[i];
+}
+
+/* append the records to the logs of the full checkpoint in path and put a
+	new state in place that counts them */
+static void checkpoint_write_delta(Cortex *core, char *path)
+{
+	CortexCheckpointer *ck = core->ckpt;
+	char file[PATH_MAX], tmp[PATH_MAX], name[64];
+	unsigned long start;
+	int i, fd;
+
+	for (i = 0; i < ck->num_sec; i++)
+	{
+		sprintf(name, "sec%d.log", i);
+		checkpoint_name(file, path, name);
+
+		/* anything past where the last state said the log ended is from
+			one that didn't make it */
+		start = ck->log_len[i] - ck->rec_len[i];
+		fd = open(file, O_WRONLY | O_CREAT, 0644);
+		if (fd < 0 || ftruncate(fd, start) < 0 || 
+			lseek(fd, start, SEEK_SET) < 0)
+		{
+			printf("checkpoint_write_delta(): Couldn't open %s: %d(%s)\n", 
+				file, errno, strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		checkpoint_write(fd, ck->rec[i], ck->rec_len[i], file);
+		if (fsync(fd) < 0)
+		{
+			printf("checkpoint_write_delta(): Couldn't sync %s: %d(%s)\n",
+				file, errno, strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		close(fd);
+	}
+
+	checkpoint_name(file, path, "state");
+	checkpoint_name(tmp, path, "state.tmp");
+	checkpoint_write_state(core, tmp);
+	if (rename(tmp, file) < 0)
+	{
+		printf("checkpoint_write_delta(): Couldn't rename %s to %s: %d(%s)\n",
+			tmp, file, errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+}
+
+/* play the first len bytes of section i's log over its SOM */
+static void checkpoint_replay(SOM *s, char *dir, int i, unsigned long len)
+{
+	char file[PATH_MAX], name[64];
+	CheckpointTiles th;
+	unsigned char *buf, *p, *end;
+	unsigned short *h;
+	unsigned int tile, enc;
+	unsigned long off, need;
+	float *w;
+	int t, r, k, n, srow, scol, erow, ecol, halves, fd;
+
+	if (len == 0) {
+		return;
+	}
+
+	sprintf(name, "sec%d.log", i);
+	checkpoint_name(file, dir, name);
+	buf = (unsigned char*)xmalloc(len);
+	fd = open(file, O_RDONLY);
+	if (fd < 0)
+	{
+		printf("checkpoint_replay(): Couldn't open %s: %d(%s)\n", file,
+			errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	checkpoint_read(fd, buf, len, file);
+	close(fd);
+
+	for (off = 0; off < len; off += sizeof(CheckpointTiles) + th.bytes)
+	{
+		if (len - off < sizeof(CheckpointTiles)) {
+			break;
+		}
+		memcpy(&th, buf + off, sizeof(CheckpointTiles));
+		if (th.magic != CHECKPOINT_TILES_MAGIC || 
+			th.bytes > len - off - sizeof(CheckpointTiles))
+		{
+			break;
+		}
+
+		p = buf + off + sizeof(CheckpointTiles);
+		end = p + th.bytes;
+		for (t = 0; t < (int)th.num_tiles; t++)
+		{
+			if (end - p < 2 * (long)sizeof(unsigned int)) {
+				break;
+			}
+			memcpy(&tile, p, sizeof(unsigned int));
+			memcpy(&enc, p + sizeof(unsigned int), sizeof(unsigned int));
+			p += 2 * sizeof(unsigned int);
+			if (tile >= (unsigned int)(s->tile_rows * s->tile_cols) ||
+				(enc != CHECKPOINT_TILES_FP32 && 
+				 enc != CHECKPOINT_TILES_FP16_DELTA))
+			{
+				break;
+			}
+
+			som_tile_box(s, tile, &srow, &scol, &erow, &ecol);
+			n = (ecol - scol + 1) * s->stride;
+			halves = n * (erow - srow + 1);
+			need = enc == CHECKPOINT_TILES_FP32 ? 
+				sizeof(float) * halves : 
+				sizeof(unsigned short) * (halves + (halves % 2));
+			need += sizeof(float) * (ecol - scol + 1) * (erow - srow + 1);
+			if ((unsigned long)(end - p) < need) {
+				break;
+			}
+
+			for (r = srow; r <= erow; r++)
+			{
+				w = s->slab + (SOM_ADR(r, scol, s) * s->stride);
+				if (enc == CHECKPOINT_TILES_FP32)
+				{
+					memcpy(w, p, sizeof(float) * n);
+					p += sizeof(float) * n;
+					continue;
+				}
+
+				/* the same additions the shadow saw */
+				h = (unsigned short*)p;
+				for (k = 0; k < n; k++)
+				{
+					w[k] += wire_half_to_float(h[k]);
+				}
+				p += sizeof(unsigned short) * n;
+			}
+			if (enc == CHECKPOINT_TILES_FP16_DELTA && halves % 2 != 0) {
+				p += sizeof(unsigned short);
+			}
+
+			for (r = srow; r <= erow; r++)
+			{
+				memcpy(s->qmap + SOM_ADR(r, scol, s), p, 
+					sizeof(float) * (ecol - scol + 1));
+				p += sizeof(float) * (ecol - scol + 1);
+			}
+		}
+		if (t != (int)th.num_tiles || p != end) {
+			break;
+		}
+
+		s->current_iter = th.current_iter;
+		s->mode = th.mode;
+		s->bmu_row = th.bmu_row;
+		s->bmu_col = th.bmu_col;
+		s->final_computation = th.final_computation;
+		s->max_dist = th.max_dist;
+		s->rand_seed = th.rand_seed;
+	}
+
+	if (off != len)
+	{
+		printf("checkpoint_replay(): %s is corrupt %lu bytes in!\n", file,
+			off);
+		exit(EXIT_FAILURE);
+	}
+
+	free(buf);
+	som_clean(s);
+}
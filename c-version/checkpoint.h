@@ -0,0 +1,262 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <sys/types.h>
+
+/* A checkpoint is everything a cortex needs to keep going exactly where it
+	left off, which is a lot more than its SOMs: the half filled slices of
+	every integration queue, each section's state and batch, and how many
+	steps have gone by. It is a directory with these in it:
+
+	topology.lctx	the cortex's own copy of its .lctx (see core->topology)
+	sec<i>.som		som_save() of section i's SOM
+	sec<i>.log		the tiles of section i's SOM that changed since
+					sec<i>.som was written, see below
+	state			a CheckpointHeader, then for each section a
+					CheckpointSection, then for each of its slots a
+					CheckpointQueue with the queue's head[] and count[]
+					after it, and then a wire frame (see wire.h) of the
+					section's batch and every row of its queues
+
+	In the wire frame the batch symbols have a slot one past the last real
+	slot and their step is where they are in the batch. The queue rows have
+	the slot they are in, and their step is slice * num_syms + row.
+
+	The checkpoint is put together in <path>.tmp and then renamed to path,
+	with the last one moved out of the way to <path>.old until the new one is
+	in place, so there is always one whole checkpoint on the disk. Each
+	SOM's own rand_seed comes back with it, so a restored cortex learns
+	exactly what the one that was checkpointed would have.
+
+	Late in training hardly any of a SOM changes between checkpoints, so
+	with cortex_set_checkpoint_incremental() most of them only append the
+	dirty tiles (see SOM_TILE in som.h) of each SOM to its log, as a
+	CheckpointTiles followed by each tile, and then put a new state file in
+	place. The state says how long each log is, so whatever a crash left
+	at the end of a log past that is ignored and written over next time.
+	Every so often the whole thing is written out again and the logs start
+	over. Restoring loads the sec<i>.som files and plays the logs over
+	them. */
+
+#define CHECKPOINT_MAGIC 0x504b434d /* "MCKP" */
+#define CHECKPOINT_VERSION 3
+#define CHECKPOINT_TILES_MAGIC 0x4c544b4d /* "MKTL" */
+
+/* how the SOMs are written by cortex_set_checkpoint_incremental() */
+enum
+{
+	/* all of every SOM every time */
+	CHECKPOINT_FULL,
+	/* the dirty tiles as they are */
+	CHECKPOINT_TILES_FP32,
+	/* The dirty tiles as half floats of how far each weight moved since
+		it was last written. What comes back is within a half float's
+		precision of the change, not exact, and the next checkpoint writes
+		whatever that missed. A tile with a change too big for a half
+		float is written as floats instead. */
+	CHECKPOINT_TILES_FP16_DELTA
+};
+
+typedef struct CheckpointHeader_s
+{
+	unsigned int magic;
+	unsigned int version;
+
+	/* core->topology_hash of the cortex this came from */
+	unsigned long long topology_hash;
+
+	int num_sec;
+	int num_input;
+	unsigned long num_steps;
+
+	/* how many checkpoints have gone into this directory */
+	unsigned long generation;
+
+} CheckpointHeader;
+
+typedef struct CheckpointSection_s
+{
+	int serial_id;
+	unsigned int state;
+	int learn_row;
+	int learn_col;
+	int batch_num;
+	int num_slot;
+
+	/* how many bytes of sec<i>.log go with this state */
+	unsigned long log_len;
+
+} CheckpointSection;
+
+/* One checkpoint's worth of a SOM's log. After it come num_tiles tiles,
+	each of which is an unsigned int tile number and an unsigned int
+	encoding, then the tile's neurons a row at a time as floats, or as half
+	floats padded out to 4 bytes, and then its quality map as floats. */
+typedef struct CheckpointTiles_s
+{
+	unsigned int magic;
+	unsigned int num_tiles;
+	unsigned long generation;
+
+	/* everything else about the SOM that changes as it learns */
+	int current_iter;
+	int mode;
+	int bmu_row;
+	int bmu_col;
+	int final_computation;
+	float max_dist;
+	unsigned int rand_seed;
+
+	/* how many bytes of tiles follow */
+	unsigned long bytes;
+
+} CheckpointTiles;
+
+typedef struct CheckpointQueue_s
+{
+	/* dim is 0 if nothing has ever been put into the queue */
+	int dim;
+	int num_syms;
+	int num_slices;
+	int curr_slice;
+	int ready;
+	int ready_slice;
+
+} CheckpointQueue;
+
+/* How the background checkpoints are going. A stall is how long the
+	cortex was held up to start one, which is syncing the agents, if there
+	are any, gathering up the dirty tiles, and the fork(). A write is how
+	long the forked process took to put the checkpoint on the disk while
+	the cortex kept going. The bytes are just the neurons, whole SOMs for
+	a full checkpoint or the tiles for an incremental one. The counts of
+	the full and incremental ones include the ones written in the
+	foreground. */
+typedef struct CheckpointStats_s
+{
+	unsigned long started;
+	unsigned long written;
+	unsigned long failed;
+
+	unsigned long full;
+	unsigned long incremental;
+	unsigned long last_bytes;
+	unsigned long total_bytes;
+
+	double last_stall;
+	double max_stall;
+	double total_stall;
+
+	double last_write;
+	double max_write;
+	double total_write;
+
+} CheckpointStats;
+
+/* Background checkpoints are written by a fork() of the cortex taken at the
+	end of a step, so the copy it writes can't change under it while this
+	process goes on learning. Only one is ever being written at a time, one
+	that comes due while the last is still going waits until the next step
+	after that one is done. */
+typedef struct CortexCheckpointer_s
+{
+	/* where the periodic ones go, NULL if there aren't any */
+	char *path;
+
+	/* take one every this many steps or this many seconds, 0 is never */
+	unsigned long every_steps;
+	double every_secs;
+
+	/* when the last one was started */
+	unsigned long last_step;
+	double last_time;
+
+	/* the process writing one, 0 if none is, and the pipe it says how
+		long it took down */
+	pid_t pid;
+	int fd;
+
+	/* CHECKPOINT_FULL or how the tiles are written, and how many
+		incremental checkpoints go between full ones */
+	int encoding;
+	int compact_every;
+
+	/* The directory the last full checkpoint went into, the incremental
+		ones only go on top of that. If one didn't make it, the next one is
+		full. */
+	char *base;
+	int full_next;
+	int num_deltas;
+	unsigned long generation;
+
+	/* how long each section's log is, all of them together, and how big
+		all of the SOMs are, once the logs are bigger than that it is
+		time for a full one */
+	int num_sec;
+	unsigned long *log_len;
+	unsigned long log_total;
+	unsigned long som_total;
+
+	/* The next record for each section's log, made before the write
+		starts so it is the same whether it is written here or in the
+		background. For CHECKPOINT_TILES_FP16_DELTA the shadow is each SOM
+		as the checkpoint has it, so the deltas are from that. */
+	unsigned char **rec;
+	unsigned long *rec_len;
+	unsigned long *rec_room;
+	float **shadow;
+
+	CheckpointStats stats;
+
+} CortexCheckpointer;
+
+/* Write everything about the cortex to the directory path. If the sections
+	are out in agents, they are brought up to date first and keep going.
+	The pipeline has to be empty. With incremental checkpoints on and the
+	last full one in path, only what changed is written. */
+void cortex_checkpoint(Cortex *core, char *path);
+
+/* Make a cortex out of a checkpoint, just as it was. If the newest
+	checkpoint got cut off in the middle of being put in place, the one
+	before it is used. */
+Cortex* cortex_restore(char *path);
+
+/* After a full checkpoint, only write the tiles of the SOMs that changed
+	into the same directory, using encoding, for compact_every checkpoints
+	before the next full one. CHECKPOINT_FULL, the default, goes back to
+	writing everything every time. */
+void cortex_set_checkpoint_incremental(Cortex *core, int encoding,
+	int compact_every);
+
+/* Checkpoint to path every every_steps steps or every every_secs seconds,
+	whichever comes first, in the background. 0 turns either one off, and
+	a NULL path turns them off and waits for one still being written. */
+void cortex_set_checkpoint(Cortex *core, char *path, 
+	unsigned long every_steps, double every_secs);
+
+/* Start a checkpoint to path in the background right now, waiting for one
+	that is still being written first. The pipeline has to be empty. */
+void cortex_checkpoint_background(Cortex *core, char *path);
+
+/* Wait for the checkpoint being written in the background, if there is one.
+	Returns FALSE if the last one that finished didn't make it. */
+int cortex_checkpoint_wait(Cortex *core);
+
+/* how the background checkpoints have gone so far, NULL if there never
+	were any */
+CheckpointStats* cortex_checkpoint_stats(Cortex *core);
+
+void checkpoint_stats_stdout(CheckpointStats *stats);
+
+/* BEGIN private stuff */
+
+/* the cortex calls this after every step, or every bunch of them, to start
+	the periodic checkpoints and notice when one has been written */
+void checkpoint_step(Cortex *core);
+
+/* wait for the last checkpoint and get rid of the checkpointer */
+void checkpoint_free(Cortex *core);
+
+/* END private stuff */
+
+#endif
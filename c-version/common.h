@@ -1,16 +1,8 @@
 #ifndef COMMON_H
 #define COMMON_H
 
-enum {
-	FALSE = 0,
-	TRUE = 1
-};
-
-enum
-{
-	/* often used for describing whether or not I found something in an array */
-	NOT_FOUND = -1
-};
+/* the engine itself */
+#include "manifold.h"
 
 enum 
 {
@@ -28,19 +20,12 @@ enum
 	NOISE_RANGE_RANDOM
 };
 
-#include "utils.h"
-#include "symbol.h"
-#include "slq.h"
-#include "som.h"
-#include "input.h"
-#include "intqueue.h"
-#include "cortex.h"
-#include "reverse.h"
-#include "conv.h"
-
 /* the various input modalities (which amount to demos) */
 #include "vinput.h"
 #include "turing_machine.h"
 #include "file_system.h"
 
+/* and how to look at all of it */
+#include "draw.h"
+
 #endif
@@ -1,6 +1,6 @@
 #include <stdio.h>
 #include <math.h>
-#include "common.h"
+#include "manifold.h"
 
 /* Create for me a representation of a specific convolution adjusting it, if
 	applicable, by the parameter the user supplies */
@@ -311,6 +311,7 @@ void conv_apply(SOM *s, Conv *c, double thld)
 				candidate = som_symbol_ref(s, slid, i);
 				symbol_move(candidate, data[i]);
 			}
+			som_dirty(s, slid, 0, slid, slqline_get_width(slql) - 1);
 
 			slqline_free(slql);
 			slql = NULL;
@@ -337,6 +338,7 @@ void conv_apply(SOM *s, Conv *c, double thld)
 			candidate = som_symbol_ref(s, slid, i);
 			symbol_move(candidate, data[i]);
 		}
+		som_dirty(s, slid, 0, slid, slqline_get_width(slql) - 1);
 
 		slqline_free(slql);
 		slql = NULL;
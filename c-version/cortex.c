@@ -2,18 +2,7 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
-#include <GL/gl.h>
-#include <GL/glu.h>
-#include "common.h"
-
-#define BUF_SIZE 2048
-#define NAME_SIZE 256
-
-enum
-{
-	/* This MUST be -1 since it represents an index into an array */
-	CORTEX_NOT_FOUND = -1
-};
+#include "manifold.h"
 
 /* When I ask wether a serial_id is a true section or just an input channel, 
 	this lets me know which one it is */
@@ -32,62 +21,118 @@ enum
 	CORTEX_NO_PARENT = -1
 };
 
-/* functions to help me read the .lctx file */
-static char* read_lctx_line(char *buf, int size, FILE *f, char *desc);
-static char* lowlevel_get_lctx_line(char *buf, int size, FILE *f);
-
 /* stuff to help me collate section results while I'm simulating the cortex */
 static Symbol* abstract_receptor(Section *sec);
 
-
-/* Load a cortex description from a .lctx file. There could be some buffer 
-	overflows in this code, but feh, I just need it to work in the common 
-	cases */
+/* turn the serial ids into pointers for cortex_process() */
+static void cortex_plan_init(Cortex *core);
+static void cortex_plan_free(Cortex *core);
+static void plan_emitter_init(PlanEmitter *pe, Emitter *em, Cortex *core);
+static int plan_reads(PlanStep *step, IntQueue *iq);
+static int plan_writes(PlanStep *step, IntQueue *iq);
+static int plan_conflict(PlanStep *a, PlanStep *b);
+static void plan_graph_init(CortexPlan *plan);
+static void plan_src_init(Cortex *core, int k);
+
+/* feeding inputs to the cortex */
+static void cortex_check_input(Cortex *core, Symbol **inputs, int num_inputs,
+	char *who);
+static void cortex_emit_input(Cortex *core, Symbol **inputs);
+
+/* pipelined mode */
+static void pipe_graph_init(Cortex *core, int depth);
+static void pipe_free(Cortex *core);
+static void pipe_run(Cortex *core);
+static void pipe_task(void *arg, int task);
+
+/* functions to help cortex_process_batch() */
+static void cortex_output_table_setup(Cortex *core, CortexOutputTable *ctxout);
+static void cortex_output_table_release(CortexOutputTable *ctxout);
+static void cortex_run_plan(Cortex *core, int request, 
+	CortexOutputTable *ctxout);
+static void cortex_batch_init(Cortex *core, int n);
+static void cortex_classify_step(void *arg, int task);
+
+
+/* Load a cortex from a .lctx file, a .lctxb, or a .ctx by way of the cache
+	of .lctxb files */
 Cortex* cortex_init(char *file)
+{
+	Cortex *core;
+	Lctx *lc;
+	size_t n;
+
+	n = strlen(file);
+	if (n > 4 && strcmp(file + n - 4, ".ctx") == 0) {
+		lc = lctx_compile(file);
+	} else {
+		lc = lctx_read(file);
+	}
+
+	core = cortex_init_lctx(lc);
+	lctx_free(lc);
+
+	return core;
+}
+
+Cortex* cortex_init_lctx(Lctx *lc)
 {
 	Cortex *core = NULL;
-	FILE *lctx = NULL;
-	char buf[BUF_SIZE] = {'\0'};
 	int i, j;
-	int serial_id, dim, x, y, rows, cols, iter, prop;
-	char name[NAME_SIZE];
-	int num, location;
-	int slot, int_num, slice_num;
-	int kind, acceptor_id, loc_acceptor;
-
-	lctx = fopen(file, "r");
-	if (lctx == NULL)
-	{
-		printf ("Could not open cortex file: %s : %d(%s)\n", file, errno,
-			strerror(errno));
-		exit(EXIT_FAILURE);
-	}
+	int serial_id, batch;
+	int location;
+	int slot, kind, loc_acceptor;
+	LctxSection *ls;
+	LctxReceptor *lr;
+	LctxEmitter *le;
+	LctxConnection *lcon;
+	Emitter *em;
 
 	core = (Cortex*)xmalloc(sizeof(Cortex) * 1);
 
-	/* read how many sections I'm going to need */
-	read_lctx_line(buf, BUF_SIZE, lctx, "Number of sections");
+	/* one thread per processor, shared by all of the sections */
+	core->pool = pool_init(0);
+
+	/* nobody has given back an output table yet */
+	core->spare_out = NULL;
+
+	/* no inputs yet, and no pipelining unless someone asks */
+	core->num_steps = 0;
+	core->pipe.depth = 0;
+	core->pipe.graph.num_tasks = 0;
+	core->pipe.graph.num_deps = NULL;
+	core->pipe.graph.succ_start = NULL;
+	core->pipe.graph.succ = NULL;
+	core->pipe.num_waiting = 0;
+	core->pipe.waiting = NULL;
+	core->pipe.request = NULL;
+	core->pipe.num_done = 0;
+	core->pipe.next_done = 0;
+	core->pipe.done = NULL;
+	core->batch_room = 0;
+	core->batch_out = NULL;
+	core->agents = NULL;
+	core->ckpt = NULL;
 
 	/* initialize the section array */
-	sscanf(buf, "%d\n", &core->num_sec);
+	core->num_sec = lc->hdr.num_sec;
 	core->sec = (Section*)xmalloc(sizeof(Section) * core->num_sec);
 
-	/* read the SOM data for each section */
+	/* set up the SOM for each section */
 	for (i = 0; i < core->num_sec; i++)
 	{
-		/* read section info */
-		read_lctx_line(buf, BUF_SIZE, lctx, "A section");
-		sscanf(buf, "%d %s %d %d %d %d %d %d %d\n", 
-			&serial_id, name, &dim, &x, &y, &rows, &cols, &iter, &prop);
+		ls = &lc->sections[i];
 
 		/* set up the basic info (not receptors or emitters) for the section */
 
-		core->sec[i].serial_id = serial_id;
-		core->sec[i].som = som_init(dim, iter, rows, cols, NULL);
-		core->sec[i].x = x;
-		core->sec[i].y = y;
-		core->sec[i].mode = (prop==1) ? SECTION_PROPOGATE : SECTION_CONSUME;
-		core->sec[i].name = strdup(name);
+		core->sec[i].serial_id = ls->serial_id;
+		core->sec[i].som = som_init(ls->dim, ls->iter, ls->rows, ls->cols,
+			NULL);
+		som_set_pool(core->sec[i].som, core->pool);
+		core->sec[i].x = ls->x;
+		core->sec[i].y = ls->y;
+		core->sec[i].mode = (ls->prop==1) ? SECTION_PROPOGATE : SECTION_CONSUME;
+		core->sec[i].name = strdup(lc->names + ls->name);
 
 		/* automatically start out as learning */
 		core->sec[i].state = SOM_LEARNING;
@@ -95,30 +140,54 @@ Cortex* cortex_init(char *file)
 		/* this stuff gets set up later */
 		core->sec[i].receptor.num_slot = 0;
 		core->sec[i].receptor.slot = NULL;
+		core->sec[i].rsym = NULL;
+		core->sec[i].rview = NULL;
 		core->sec[i].emitter.num_con = 0;
 		core->sec[i].emitter.con = NULL;
 
 		/* graphics stuff */
 		core->sec[i].secdisp.learn_row = 0;
 		core->sec[i].secdisp.learn_col = 0;
-	}
 
-	/* read the input channel description */
-	read_lctx_line(buf, BUF_SIZE, lctx, "Number of input channels");
-	sscanf(buf, "%d\n", &core->num_input);
+		/* batch learning, if asked for */
+		batch = ls->batch;
+		core->sec[i].batch_size = batch < 0 ? 0 : batch;
+		core->sec[i].batch_num = 0;
+		core->sec[i].batch = NULL;
+		core->sec[i].batch_rows = NULL;
+		core->sec[i].batch_cols = NULL;
+		if (core->sec[i].batch_size > 0)
+		{
+			core->sec[i].batch = (Symbol**)xmalloc(sizeof(Symbol*) * 
+				core->sec[i].batch_size);
+			for (j = 0; j < core->sec[i].batch_size; j++)
+			{
+				core->sec[i].batch[j] = NULL;
+			}
+			core->sec[i].batch_rows = (int*)xmalloc(sizeof(int) * 
+				core->sec[i].batch_size);
+			core->sec[i].batch_cols = (int*)xmalloc(sizeof(int) * 
+				core->sec[i].batch_size);
+		}
+
+		/* made by the first cortex_process_batch() */
+		core->sec[i].frame_room = 0;
+		core->sec[i].frame_sym = NULL;
+		core->sec[i].frame_ready = NULL;
+		core->sec[i].frame_rows = NULL;
+		core->sec[i].frame_cols = NULL;
+	}
 
+	/* set up the input channels */
+	core->num_input = lc->hdr.num_input;
 	core->input = (CortexInput*)xmalloc(sizeof(CortexInput) * core->num_input);
 	
-	/* initialize the inputs array */
 	for (i = 0; i < core->num_input; i++)
 	{
-		read_lctx_line(buf, BUF_SIZE, lctx, "An input channel");
-		sscanf(buf, "%d %s %d\n", &serial_id, name, &dim);
-
 		/* set up most of the input channel */
-		core->input[i].serial_id = serial_id;
-		core->input[i].name = strdup(name);
-		core->input[i].dim = dim;
+		core->input[i].serial_id = lc->inputs[i].serial_id;
+		core->input[i].name = strdup(lc->names + lc->inputs[i].name);
+		core->input[i].dim = lc->inputs[i].dim;
 		core->input[i].sym = NULL;
 
 		/* this stuff gets set up later */
@@ -126,59 +195,43 @@ Cortex* cortex_init(char *file)
 		core->input[i].emitter.con = NULL;
 	}
 
-	/* read the number of execution serial ids I need to read */
-	read_lctx_line(buf, BUF_SIZE, lctx, "Number of execution serial ids");
-	sscanf(buf, "%d\n", &core->num_exec);
-
+	/* the order the sections run in */
+	core->num_exec = lc->hdr.num_exec;
 	core->exec = (int*)xmalloc(sizeof(int) * core->num_exec);
-
-	/* read the execution ids and store them */
-	for (i = 0; i < core->num_exec; i++)
-	{
-		read_lctx_line(buf, BUF_SIZE, lctx, "Execution serial id");
-		sscanf(buf, "%d\n", &core->exec[i]);
-	}
+	memcpy(core->exec, lc->exec, sizeof(int) * core->num_exec);
 	
-	/* now read how many sections there are which need to have their receptors
-		set up */
-
-	read_lctx_line(buf, BUF_SIZE, lctx, "Number of sections needing receptors");
-	sscanf(buf, "%d\n", &num);
-
-	/* read the receptor information for each emitting section */
-	for (i = 0; i < num; i++)
+	/* set up the receptors of each section that has them */
+	for (i = 0; i < lc->hdr.num_receptor; i++)
 	{
-		/* which section id is the one I need to set up? */
-		read_lctx_line(buf, BUF_SIZE, lctx, "Recepting serial id");
-		sscanf(buf, "%d\n", &serial_id);
+		lr = &lc->receptors[i];
 
 		/* translate the serial number into a section array index number */
-		location = find_section_by_id(serial_id, core->sec, core->num_sec);
+		location = find_section_by_id(lr->serial_id, core->sec,
+			core->num_sec);
 		if (location == CORTEX_NOT_FOUND) {
 			printf("cortex_init(): Acceptor id[%d] not found!\n",
-				serial_id);
+				lr->serial_id);
 			exit(EXIT_FAILURE);
 		}
 
-		/* how many slots do I need to set up? */
-		read_lctx_line(buf, BUF_SIZE, lctx, "Number of receptor slots");
-		sscanf(buf, "%d\n", &core->sec[location].receptor.num_slot);
-
 		/* make the slot array */
+		core->sec[location].receptor.num_slot = lr->num;
 		core->sec[location].receptor.slot = 
 			(Slot*)xmalloc(sizeof(Slot) * 
 			core->sec[location].receptor.num_slot);
+		core->sec[location].rsym = NULL;
+		core->sec[location].rview = 
+			(Symbol*)xmalloc(sizeof(Symbol) * 
+			core->sec[location].receptor.num_slot);
 
 		/* now initialize each slot according to what I read */
-		for (j = 0; j < core->sec[location].receptor.num_slot; j++)
+		for (j = lr->first; j < lr->first + lr->num; j++)
 		{
-			read_lctx_line(buf, BUF_SIZE, lctx, "Slot info");
-			sscanf(buf, "%d %d %d\n", &slot, &int_num, &slice_num);
-
 			/* 'slot' is never going to be greater than the number of 
 				recepting slots, or less than zero */
+			slot = lc->slots[j].slot;
 			core->sec[location].receptor.slot[slot].iq =
-				intqueue_init(int_num, slice_num);
+				intqueue_init(lc->slots[j].int_num, lc->slots[j].slice_num);
 
 			/* This will be set up later when the connections are made */
 			core->sec[location].receptor.slot[slot].parent = CORTEX_NO_PARENT;
@@ -187,16 +240,12 @@ Cortex* cortex_init(char *file)
 		}
 	}
 
-	/* Now read the number of sections/inputs which are emitters and the
-		connection information that goes with each one of them */
-	read_lctx_line(buf, BUF_SIZE, lctx, "Number of emitter/inputs");
-	sscanf(buf, "%d\n", &num);
-	
-	/* read each emitter and record the connection information */
-	for (i = 0; i < num; i++)
+	/* Now hook up each of the sections/inputs which are emitters to the
+		slots they write into */
+	for (i = 0; i < lc->hdr.num_emitter; i++)
 	{
-		read_lctx_line(buf, BUF_SIZE, lctx, "Emitter/input serial id");
-		sscanf(buf, "%d\n", &serial_id);
+		le = &lc->emitters[i];
+		serial_id = le->serial_id;
 
 		/* a serial number can be an input channel OR a section, so figure
 			out which one it is right here */
@@ -210,70 +259,15 @@ Cortex* cortex_init(char *file)
 			case CORTEX_EMITTER_KIND_SECTION:
 				location = find_section_by_id(serial_id, core->sec, 
 					core->num_sec);
-
-				read_lctx_line(buf, BUF_SIZE, lctx, 
-					"Number of connection slots");
-				sscanf(buf, "%d\n", &core->sec[location].emitter.num_con);
-
-				core->sec[location].emitter.con = 
-					(Connection*)xmalloc(sizeof(Connection) *
-						core->sec[location].emitter.num_con);
-
-				/* now, read the connection information */
-				for(j = 0; j < core->sec[location].emitter.num_con; j++)
-				{
-					read_lctx_line(buf, BUF_SIZE, lctx, "A connection slot");
-					sscanf(buf, "%d %d\n", &acceptor_id, &slot);
-
-					/* set up the connection */
-					core->sec[location].emitter.con[j].section_id = 
-						acceptor_id;
-					core->sec[location].emitter.con[j].slot = slot;
-
-					/* set up the parent link */
-					loc_acceptor = find_section_by_id(acceptor_id, core->sec,
-						core->num_sec);
-					core->sec[loc_acceptor].receptor.slot[slot].parent = 
-						serial_id;
-					core->sec[loc_acceptor].receptor.slot[slot].parent_kind = 
-						CORTEX_KIND_SECTION;
-				}
-
+				em = &core->sec[location].emitter;
+				kind = CORTEX_KIND_SECTION;
 				break;
 			
 			case CORTEX_EMITTER_KIND_INPUT:
-
 				location = find_input_by_id(serial_id, core->input, 
 					core->num_input);
-
-				read_lctx_line(buf, BUF_SIZE, lctx, 
-					"Number of connection slots");
-				sscanf(buf, "%d\n", &core->input[location].emitter.num_con);
-
-				core->input[location].emitter.con = 
-					(Connection*)xmalloc(sizeof(Connection) *
-						core->input[location].emitter.num_con);
-
-				/* now, read the connection information */
-				for(j = 0; j < core->input[location].emitter.num_con; j++)
-				{
-					read_lctx_line(buf, BUF_SIZE, lctx, "A connection slot");
-					sscanf(buf, "%d %d\n", &acceptor_id, &slot);
-
-					/* set up the connection */
-					core->input[location].emitter.con[j].section_id = 
-						acceptor_id;
-					core->input[location].emitter.con[j].slot = slot;
-
-					/* set up the parent link */
-					loc_acceptor = find_section_by_id(acceptor_id, core->sec,
-						core->num_sec);
-					core->sec[loc_acceptor].receptor.slot[slot].parent = 
-						serial_id;
-					core->sec[loc_acceptor].receptor.slot[slot].parent_kind = 
-						CORTEX_KIND_INPUT;
-				}
-
+				em = &core->input[location].emitter;
+				kind = CORTEX_KIND_INPUT;
 				break;
 
 			case CORTEX_EMITTER_KIND_UNKNOWN:
@@ -287,88 +281,126 @@ Cortex* cortex_init(char *file)
 				exit(EXIT_FAILURE);
 				break;
 		}
+
+		em->num_con = le->num;
+		em->con = (Connection*)xmalloc(sizeof(Connection) * em->num_con);
+
+		/* now, set up the connection information */
+		for(j = 0; j < em->num_con; j++)
+		{
+			lcon = &lc->cons[le->first + j];
+
+			em->con[j].section_id = lcon->acceptor_id;
+			em->con[j].slot = lcon->slot;
+
+			/* set up the parent link */
+			loc_acceptor = find_section_by_id(lcon->acceptor_id, core->sec,
+				core->num_sec);
+			if (loc_acceptor == CORTEX_NOT_FOUND || lcon->slot < 0 ||
+				lcon->slot >= core->sec[loc_acceptor].receptor.num_slot)
+			{
+				printf("cortex_init(): Emitter[%d] connects to slot %d of "
+					"[%d], which isn't there!\n", serial_id, lcon->slot,
+					lcon->acceptor_id);
+				exit(EXIT_FAILURE);
+			}
+			core->sec[loc_acceptor].receptor.slot[lcon->slot].parent = 
+				serial_id;
+			core->sec[loc_acceptor].receptor.slot[lcon->slot].parent_kind = 
+				kind;
+		}
 	}
 
-	/* read the pre-calculated reverse lookup observation tables for each
+	/* the pre-calculated reverse lookup observation tables for each
 		lookupable section */
-	read_lctx_line(buf, BUF_SIZE, lctx, "Number of root nodes in obtable");
-	sscanf(buf, "%d\n", &core->rt.num_roots);
-
-	/* allocate the obtable memory for all of the possible roots */
+	core->rt.num_roots = lc->hdr.num_root;
 	core->rt.root = (ObservationTable*)
 		xmalloc(sizeof(ObservationTable) * core->rt.num_roots);
 
-	/* read the observation table for each root node */
 	for (i = 0; i < core->rt.num_roots; i++)
 	{
-		read_lctx_line(buf, BUF_SIZE, lctx, "A root node in the obtable");
-		sscanf(buf, "%d\n", &core->rt.root[i].serial_id);
-		read_lctx_line(buf, BUF_SIZE, lctx, "Num of observations for a root");
-		sscanf(buf, "%d\n", &core->rt.root[i].num_obs);
+		core->rt.root[i].serial_id = lc->roots[i].serial_id;
+		core->rt.root[i].num_obs = lc->roots[i].num;
 
-		/* allocate the memory desired for the observation for this particular
-			root node */
 		core->rt.root[i].ob = (Observation*)
 			xmalloc(sizeof(Observation) * core->rt.root[i].num_obs);
 
-		/* read the observations for this particular root */
 		for (j = 0; j < core->rt.root[i].num_obs; j++)
 		{
-			read_lctx_line(buf, BUF_SIZE, lctx, "An observation");
-			sscanf(buf, "%d %d\n", &core->rt.root[i].ob[j].serial_id,
-				&core->rt.root[i].ob[j].obs);
+			core->rt.root[i].ob[j].serial_id =
+				lc->obs[lc->roots[i].first + j].serial_id;
+			core->rt.root[i].ob[j].obs =
+				lc->obs[lc->roots[i].first + j].obs;
 		}
 	}
 
-	/* read the output channel identification/ordering table */
+	/* the output channel identification/ordering table */
 	core->outchan = NULL;
-	read_lctx_line(buf, BUF_SIZE, lctx, "Number of Output Channels");
-	sscanf(buf, "%d\n", &core->num_outchan);
+	core->num_outchan = lc->hdr.num_outchan;
 	if (core->num_outchan != 0)
 	{
 		core->outchan = 
 			(CortexOutputChannel*)xmalloc(sizeof(CortexOutputChannel) * 
 				core->num_outchan);
 
-		/* read each output channels description */
 		for (i = 0; i < core->num_outchan; i++)
 		{
-			read_lctx_line(buf, BUF_SIZE, lctx, "An output channel");
-			sscanf(buf, "%d %s\n", &core->outchan[i].serial_id, name);
-			core->outchan[i].name = strdup(name);
+			core->outchan[i].serial_id = lc->outchans[i].serial_id;
+			core->outchan[i].name = strdup(lc->names + lc->outchans[i].name);
 		}
 	}
 
-	/* read the section to output_channel mapping table */
+	/* the section to output_channel mapping table */
 	core->outmap = NULL;
-	read_lctx_line(buf, BUF_SIZE, lctx, "Number of Output Channel Maps");
-	sscanf(buf, "%d\n", &core->num_outmap);
+	core->num_outmap = lc->hdr.num_outmap;
 	if (core->num_outmap != 0)
 	{
 		core->outmap = 
 			(CortexOutputMapping*)xmalloc(sizeof(CortexOutputMapping) * 
 				core->num_outmap);
 
-		/* read each output channel map description */
 		for (i = 0; i < core->num_outmap; i++)
 		{
-			read_lctx_line(buf, BUF_SIZE, lctx, "An output channel map");
-			sscanf(buf, "%d %d\n", &core->outmap[i].sec_id, 
-				&core->outmap[i].ochan_id);
+			core->outmap[i].sec_id = lc->outmaps[i].sec_id;
+			core->outmap[i].ochan_id = lc->outmaps[i].ochan_id;
 		}
 	}
 
-	fclose(lctx);
+	/* keep my own copy of what this cortex was made from */
+	core->topology_len = lc->hdr.topology_len;
+	core->topology = (char*)xmalloc(core->topology_len + 1);
+	memcpy(core->topology, lc->topology, core->topology_len + 1);
+	core->topology_hash = hash_fnv1a(core->topology, core->topology_len,
+		HASH_FNV1A_INIT);
 
 	/* initialize the wave propogation table used for reverse lookups */
 	wavetable_init(core);
 
+	/* and figure out once and for all who talks to who */
+	cortex_plan_init(core);
+
+	/* farm the sections out to other processes if asked to */
+	if (getenv("MANIFOLD_AGENTS") != NULL && 
+		atoi(getenv("MANIFOLD_AGENTS")) > 0)
+	{
+		cortex_set_agents(core, atoi(getenv("MANIFOLD_AGENTS")));
+	}
+
 	return core;
 }
 
 void cortex_free(Cortex *core)
 {
 	int i, j;
+	CortexOutputTable *ctxout;
+
+	/* let the last checkpoint finish */
+	checkpoint_free(core);
+
+	/* bring the sections home and get rid of anything still in the
+		pipeline */
+	cortex_set_agents(core, 0);
+	pipe_free(core);
 
 	/* free the sections */
 	for (i = 0; i < core->num_sec; i++)
@@ -381,6 +413,27 @@ void cortex_free(Cortex *core)
 		som_free(core->sec[i].som);
 		core->sec[i].som = NULL;
 
+		/* and the symbols the batch keeps reusing */
+		for (j = 0; j < core->sec[i].batch_size; j++)
+		{
+			symbol_free(core->sec[i].batch[j]);
+		}
+		free(core->sec[i].batch);
+		free(core->sec[i].batch_rows);
+		free(core->sec[i].batch_cols);
+		core->sec[i].batch = NULL;
+
+		/* and what cortex_process_batch() left lying around */
+		for (j = 0; j < core->sec[i].frame_room; j++)
+		{
+			symbol_free(core->sec[i].frame_sym[j]);
+		}
+		free(core->sec[i].frame_sym);
+		free(core->sec[i].frame_ready);
+		free(core->sec[i].frame_rows);
+		free(core->sec[i].frame_cols);
+		core->sec[i].frame_sym = NULL;
+
 		/* free the receptor */
 		for (j = 0; j < core->sec[i].receptor.num_slot; j++)
 		{
@@ -390,6 +443,12 @@ void cortex_free(Cortex *core)
 		/* free the slot array */
 		free(core->sec[i].receptor.slot);
 		core->sec[i].receptor.slot = NULL;
+		if (core->sec[i].rsym != NULL) {
+			symbol_free(core->sec[i].rsym);
+			core->sec[i].rsym = NULL;
+		}
+		free(core->sec[i].rview);
+		core->sec[i].rview = NULL;
 
 		/* free the emitter */
 		free(core->sec[i].emitter.con);
@@ -461,8 +520,35 @@ void cortex_free(Cortex *core)
 	/* get rid of the wavetable */
 	wavetable_destroy(core);
 
+	/* nobody is using the threads anymore */
+	pool_free(core->pool);
+
+	cortex_plan_free(core);
+
+	/* get rid of the output table I was saving for later */
+	while(core->spare_out != NULL) {
+		ctxout = core->spare_out;
+		core->spare_out = ctxout->next_spare;
+		ctxout->owner = NULL;
+		cortex_output_table_free(ctxout);
+	}
+
+	for (i = 0; i < core->batch_room; i++)
+	{
+		cortex_output_table_release(&core->batch_out[i]);
+	}
+	free(core->batch_out);
+	core->batch_out = NULL;
+
+	free(core->topology);
+	core->topology = NULL;
+
 	/* now, finally, free the cortex */
 	free(core);
+
+	/* and the symbols this thread was keeping for reuse, the workers let
+		go of theirs when pool_free() stopped them */
+	symbol_pool_drain();
 }
 
 /* print a reasonably readable traversal of the Cortex structure */
@@ -605,132 +691,317 @@ void cortex_stdout(Cortex *core)
 	printf("\n");
 }
 
-void cortex_draw(Cortex *core, int style)
+void cortex_set_trace(Cortex *core, int on)
 {
 	int i;
-	Section *sec;
-	int row, col;
-	int draw_boxes = 1;
-
-	/* ok, let's draw the SOMs at the location required */
 
 	for (i = 0; i < core->num_sec; i++)
 	{
-		sec = &core->sec[i];
-		som_draw(sec->som, style, sec->x, sec->y);
+		som_set_trace(core->sec[i].som, on);
+	}
+}
 
-		/* draw the marker box around the WTA */
-		if (draw_boxes == 1)
-		{
-			row = core->sec[i].secdisp.learn_row;
-			col = core->sec[i].secdisp.learn_col;
+/* what each section needs to know to do its part of a cortex_process() */
+typedef struct CortexStepJob_s
+{
+	Cortex *core;
+	int request;
+	CortexOutputTable *ctxout;
+} CortexStepJob;
+
+/* Run one section of the execution plan. The plan's graph makes sure
+	everything that writes into this section's receptor, in an earlier
+	step, has already run, and nothing that writes into it in a later step
+	has, so it sees the same queues it would if the steps ran in order. */
+static void cortex_process_step(void *arg, int task)
+{
+	CortexStepJob *job = (CortexStepJob*)arg;
+	CortexOutputTable *ctxout = job->ctxout;
+	int request = job->request;
+	PlanStep *step = &job->core->plan.step[task];
+	Section *sec = step->sec;
+	Symbol *sym, *output;
+	int prow, pcol;
+	int j;
 
-			/* mark winning neuron */
-			glBegin(GL_POINTS);
-				glColor3f(1, 1, 1);
-				glVertex3f(col+sec->x, row+sec->y, 0.5);
-			glEnd();
+	step->emitted = FALSE;
 
-			/* TODO: update this to use som_draw_reticule() */
+	/* if this function returns to me something, it means this section is
+		ready for its input */
+	if ((sym = abstract_receptor(sec)) != NULL)
+	{
+		/* Have the SOM learn/classify this symbol as per the caller's 
+			wishes */
+		switch(request)
+		{
+			case CORTEX_REQUEST_CLASSIFY:
+				sec->state = 
+					som_learn(sec->som, sym, &prow, &pcol,
+					SOM_REQUEST_CLASSIFY, FALSE);
+				break;
 
-			/* draw a little box around the last learning location */
-			glBegin(GL_LINE_LOOP);
-			switch(core->sec[i].state)
-			{
-				case SOM_LEARNING:
-					glColor3f(1, 1, 0);
+			case CORTEX_REQUEST_LEARN:
+				if (sec->batch_size == 0)
+				{
+					sec->state = 
+						som_learn(sec->som, sym, &prow, 
+						&pcol, SOM_REQUEST_LEARN, FALSE);
 					break;
-				case SOM_CLASSIFYING:
-					glColor3f(0, 1, 0);
+				}
+
+				/* A batch section answers with what the SOM thinks of
+					the symbol right now, and saves the symbol to learn
+					later with the rest of its batch. */
+				sec->state = 
+					som_learn(sec->som, sym, &prow, &pcol,
+					SOM_REQUEST_CLASSIFY, FALSE);
+				if (sec->state != SOM_LEARNING) {
 					break;
-				default:
-					glColor3f(1, 0, 0);
+				}
+
+				/* the batch keeps its symbols around from batch to batch
+					so nothing is malloced here */
+				if (sec->batch[sec->batch_num] == NULL ||
+					sec->batch[sec->batch_num]->dim != sym->dim)
+				{
+					symbol_free(sec->batch[sec->batch_num]);
+					sec->batch[sec->batch_num] = symbol_init(sym->dim);
+				}
+				symbol_move(sec->batch[sec->batch_num], sym);
+				sec->batch_num++;
+
+				if (sec->batch_num == 
+					sec->batch_size)
+				{
+					sec->state =
+						som_learn_batch(sec->som, 
+							sec->batch,
+							sec->batch_num,
+							sec->batch_rows,
+							sec->batch_cols,
+							SOM_REQUEST_LEARN);
+
+					sec->batch_num = 0;
+				}
+				break;
+
+			default:
+				printf("cortex_process(): Invalid request! %d\n", request);
+				exit(EXIT_FAILURE);
 				break;
+		}
+
+		/* Smooth/sharpen the SOM by some XXX arbitrary amount. 
+			Figure out if I can do this both for classify or learn
+			requests. */
+		if (sec->state == SOM_LEARNING)
+		{
+			/* try and figure out of I can get the amount of 
+				softening/sharpening to be autodiscovered */
+
+			/* Blur out some noise from the system */
+/*				conv_apply_easy(sec->som, CONV_BLUR_SMEAR, .5, .1);*/
+
+			/* Sharpen the edges a little bit more than I blurred them
+				between the regions */
+/*				conv_apply_easy(sec->som, CONV_LAPLACIAN, 1, 1.0);*/
+
+		}
+
+		/* record the bmu for later display */
+		sec->secdisp.learn_row = prow;
+		sec->secdisp.learn_col = pcol;
+		
+		/* If this section is in classification stage, and it is
+			propogating information, then copy the dimensionally reduced
+			output to all of its children in the emitter list. */
+		if (sec->state == SOM_CLASSIFYING && 
+			sec->mode == SECTION_PROPOGATE)
+		{
+			output = step->emit;
+			symbol_set_2(output, 
+				(double)prow/(double)som_get_rows(sec->som),
+				(double)pcol/(double)som_get_cols(sec->som));
+
+			/* copy the result to all of the connection's intqueues */
+			for (j = 0; j < step->out.num_dest; j++)
+			{
+				intqueue_enqueue(step->out.dest[j], output);
 			}
-			glVertex3f(col-10+sec->x, row-10+sec->y, 0.5);
-			glVertex3f(col-10+sec->x, row+10+sec->y, 0.5);
-			glVertex3f(col+10+sec->x, row+10+sec->y, 0.5);
-			glVertex3f(col+10+sec->x, row-10+sec->y, 0.5);
-			glEnd();
+			step->emitted = TRUE;
+
+			output = NULL;
+		}
+
+		/* This next part dealing with the output channels of sections that
+			have them will happen no matter if the section was classifying 
+			or learning.  */
+
+		if (step->output != CORTEX_NOT_FOUND) {
+			/* This section has an output, so set it up into the output
+				table */
+
+			/* make the output representation symbol:
+				dim 0,1 contain the physical location in the cortex
+				dim 2,3 contain the physical location in the section
+				dim 4,5 contain the normalized location for the section
+			*/
+			output = ctxout->output[step->output].store;
+			symbol_set_6(output,
+				sec->y + prow,
+				sec->x + pcol,
+				prow, 
+				pcol,
+				(double)prow/(double)som_get_rows(sec->som),
+				(double)pcol/(double)som_get_cols(sec->som));
+
+			/* now, place the symbol into the output table and mark the
+				output channel as active. The symbol belongs to the table. */
+			ctxout->output[step->output].active = TRUE;
+			ctxout->output[step->output].osym = output;
+
+			output = NULL;
 		}
 	}
 }
 
+void cortex_run_step(Cortex *core, int step, int request, 
+	CortexOutputTable *ctxout)
+{
+	CortexStepJob job;
 
-/* Take some input, process it either learning or classifying it, then return
-	the output channels if any */
-CortexOutputTable* cortex_process(Cortex *core, Symbol **inputs, 
-	int num_inputs, int request)
+	job.core = core;
+	job.request = request;
+	job.ctxout = ctxout;
+	cortex_process_step(&job, step);
+}
+
+/* make sure the inputs are what the cortex wants */
+static void cortex_check_input(Cortex *core, Symbol **inputs, int num_inputs,
+	char *who)
 {
-	int i, j, location, acc_loc, emission_slot;
-	Symbol *sym, *output;
-	int pcol, prow;
-	CortexOutputTable *ctxout = NULL;
-	int omindex;
-	int outputindex;
+	int i;
 
 	if (num_inputs != core->num_input)
 	{
-		printf("cortex_process(): Number of input symbol mismatch!\n");
+		printf("%s(): Number of input symbol mismatch!\n", who);
 		exit(EXIT_FAILURE);
 	}
 
-	/* move the input into the Cortex. I am taking control of the passed
-		in memory. */
 	for (i = 0; i < core->num_input; i++)
 	{
-		core->input[i].sym = inputs[i];
-
 		/* sanity check the dimension of each input channel */
 		if (core->input[i].dim != symbol_get_dim(inputs[i]))
 		{
-			printf("cortex_process(): Input channel %d is of dimension %d, "
-				"but the cortex was expecting dimension %d\n", i, 
+			printf("%s(): Input channel %d is of dimension %d, "
+				"but the cortex was expecting dimension %d\n", who, i, 
 				symbol_get_dim(inputs[i]), core->input[i].dim);
 			exit(EXIT_FAILURE);
 		}
 	}
+}
+
+/* Move the input into the Cortex and copy it into the slots of all of the
+	accepting sections. The input memory is mine, so once the slots have
+	their copies, it gets freed. */
+static void cortex_emit_input(Cortex *core, Symbol **inputs)
+{
+	int i, j;
+	PlanEmitter *pe;
 
-	/* ok, now propogate all inputs into the accepting sections */
 	for (i = 0; i < core->num_input; i++)
 	{
-		/* distribute this symbol to each accepting section */
-		for (j = 0; j < core->input[i].emitter.num_con; j++)
+		core->input[i].sym = inputs[i];
+
+		pe = &core->plan.input[i];
+		for (j = 0; j < pe->num_dest; j++)
 		{
-			/* We only forward copies of things to the accepting slots */
-			sym = symbol_copy(core->input[i].sym);
-			
-			/* find the location in the section array of the serial number
-				of the section we want to give the information to */
-			location = find_section_by_id(
-					core->input[i].emitter.con[j].section_id, core->sec, 
-					core->num_sec);
-			if (location == CORTEX_NOT_FOUND)
-			{
-				printf("cortex_process(): Can't emit input to acceptor!\n");
-				exit(EXIT_FAILURE);
-			}
-			emission_slot = core->input[i].emitter.con[j].slot;
-			
-			/* physically put it into the slot in the section requested */
-			intqueue_enqueue(
-				core->sec[location].receptor.slot[emission_slot].iq,
-				sym);
+			intqueue_enqueue(pe->dest[j], core->input[i].sym);
 		}
+
+		symbol_free(core->input[i].sym);
+		core->input[i].sym = NULL;
 	}
+}
+
+/* Take some input, process it either learning or classifying it, then return
+	the output channels if any */
+CortexOutputTable* cortex_process(Cortex *core, Symbol **inputs, 
+	int num_inputs, int request)
+{
+	CortexOutputTable *ctxout = NULL;
 
-	/* set up some of the output table */
 	ctxout = cortex_output_table_init(core);
+	cortex_process_into(core, inputs, num_inputs, request, ctxout);
+
+	/* the result of what I asked to do, for the available output channels */
+	return ctxout;
+}
+
+void cortex_process_into(Cortex *core, Symbol **inputs, int num_inputs, 
+	int request, CortexOutputTable *ctxout)
+{
+	int i;
+
+	cortex_check_input(core, inputs, num_inputs, "cortex_process_into");
+
+	if (core->pipe.num_waiting != 0 || 
+		core->pipe.next_done < core->pipe.num_done)
+	{
+		printf("cortex_process_into(): The pipeline has to be flushed "
+			"first!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (ctxout->num_output != core->num_outchan)
+	{
+		printf("cortex_process_into(): The output table has %d channels, "
+			"but the cortex has %d!\n", ctxout->num_output, 
+			core->num_outchan);
+		exit(EXIT_FAILURE);
+	}
+
+	/* set up some of the output table, nothing is active until a section
+		says so */
+	for (i = 0; i < ctxout->num_output; i++)
+	{
+		ctxout->output[i].active = FALSE;
+		ctxout->output[i].osym = NULL;
+	}
 	ctxout->request = request;
+	ctxout->step = core->num_steps++;
 
-	/* now that we are done, remove the memory stored in the input array since
-		we made copies of it for the accepting sections */
-	for (i = 0; i < core->num_input; i++)
+	if (core->agents != NULL)
 	{
-		symbol_free(core->input[i].sym);
-		core->input[i].sym = NULL;
+		/* the agents do it all */
+		agents_room(core, 1);
+		core->agents->frames[0] = inputs;
+		core->agents->request[0] = request;
+		core->agents->tables[0] = ctxout;
+		agents_run(core, 1);
+	}
+	else
+	{
+		/* ok, now propogate all inputs into the accepting sections */
+		cortex_emit_input(core, inputs);
+
+		cortex_run_plan(core, request, ctxout);
 	}
 
+	/* XXX wrong */
+	ctxout->mode = CORTEX_LEARNING;
+
+	/* a good time for a checkpoint, if one is due */
+	checkpoint_step(core);
+}
+
+/* run every section once for the input already in the slots */
+static void cortex_run_plan(Cortex *core, int request, 
+	CortexOutputTable *ctxout)
+{
+	int i;
+	CortexStepJob job;
+
 	/* now, execute the sections in the order specified. Be careful to 
 		only propogate the "result" of a SOM if it is in the CLASSIFYING
 		state AND it is propogating. This results in a propogating "convergance
@@ -740,165 +1011,646 @@ CortexOutputTable* cortex_process(Cortex *core, Symbol **inputs,
 		to do if the concatenation of the integration queues doesn't yield a
 		new symbol to learn. */
 
-	for (i = 0; i < core->num_exec; i++)
-	{
-		/* I'm going to work with a single section at a time */
-		location = find_section_by_id(core->exec[i], core->sec, core->num_sec);
-		if (location == CORTEX_NOT_FOUND)
-		{
-			printf("cortex_process(): Can't execute unknown section!\n");
-			exit(EXIT_FAILURE);
-		}
+	job.core = core;
+	job.request = request;
+	job.ctxout = ctxout;
 
-		/* if this function returns to me something, it means this section is
-			ready for its input */
-		if ((sym = abstract_receptor(&core->sec[location])) != NULL)
+	/* Independent sections, like all of the rows of vision.ctx, can run at
+		the same time on the cortex's threads. With only one thread this
+		just runs them in the execution order. */
+	if (pool_get_num_threads(core->pool) == 1) {
+		for (i = 0; i < core->plan.num_step; i++)
 		{
-			/* Have the SOM learn/classify this symbol as per the caller's 
-				wishes (and draw how it is doing) */
-			switch(request)
-			{
-				case CORTEX_REQUEST_CLASSIFY:
-					core->sec[location].state = 
-						som_learn(core->sec[location].som, sym, &prow, &pcol,
-						core->sec[location].x, core->sec[location].y,
-						SOM_REQUEST_CLASSIFY, FALSE);
-					break;
+			cortex_process_step(&job, i);
+		}
+	} else {
+		pool_run_graph(core->pool, &core->plan.graph, cortex_process_step, 
+			&job);
+	}
+}
 
-				case CORTEX_REQUEST_LEARN:
-					core->sec[location].state = 
-						som_learn(core->sec[location].som, sym, &prow, &pcol,
-						core->sec[location].x, core->sec[location].y,
-						SOM_REQUEST_LEARN, FALSE);
-					break;
+/* what each section needs to know to do its part of a classifying
+	cortex_process_batch() */
+typedef struct CortexBatchJob_s
+{
+	Cortex *core;
+	Symbol ***frames;
+	int n;
+} CortexBatchJob;
 
-				default:
-					printf("cortex_process(): Invalid request! %d\n", request);
-					exit(EXIT_FAILURE);
-					break;
-			}
+CortexOutputTable* cortex_process_batch(Cortex *core, Symbol ***frames, 
+	int n, int num_inputs, int request)
+{
+	int i, t;
+	CortexBatchJob job;
 
-			/* Smooth/sharpen the SOM by some XXX arbitrary amount. 
-				Figure out if I can do this both for classify or learn
-				requests. */
-			if (core->sec[location].state == SOM_LEARNING)
-			{
-				/* try and figure out of I can get the amount of 
-					softening/sharpening to be autodiscovered */
+	if (request != CORTEX_REQUEST_CLASSIFY && request != CORTEX_REQUEST_LEARN)
+	{
+		printf("cortex_process_batch(): Invalid request! %d\n", request);
+		exit(EXIT_FAILURE);
+	}
 
-				/* Blur out some noise from the system */
-/*				conv_apply_easy(core->sec[location].som, CONV_BLUR_SMEAR, .5, .1);*/
+	if (core->pipe.num_waiting != 0 || 
+		core->pipe.next_done < core->pipe.num_done)
+	{
+		printf("cortex_process_batch(): The pipeline has to be flushed "
+			"first!\n");
+		exit(EXIT_FAILURE);
+	}
 
-				/* Sharpen the edges a little bit more than I blurred them
-					between the regions */
-/*				conv_apply_easy(core->sec[location].som, CONV_LAPLACIAN, 1, 1.0);*/
+	if (n <= 0) {
+		return NULL;
+	}
 
-			}
+	for (t = 0; t < n; t++)
+	{
+		cortex_check_input(core, frames[t], num_inputs, 
+			"cortex_process_batch");
+	}
 
-			/* record the bmu for later display */
-			core->sec[location].secdisp.learn_row = prow;
-			core->sec[location].secdisp.learn_col = pcol;
-			
-			/* now that I've learned the symbol, get rid of it */
-			symbol_free(sym);
-			
-			/* If this section is in classification stage, and it is
-				propogating information, then copy the dimensionally reduced
-				output to all of its children in the emitter list. */
-			if (core->sec[location].state == SOM_CLASSIFYING && 
-				core->sec[location].mode == SECTION_PROPOGATE)
-			{
-				/* copy the result to all of the connection's intqueues */
-				for (j = 0; j < core->sec[location].emitter.num_con; j++)
-				{
-					output = symbol_init(2);
-					symbol_set_2(output, 
-					(double)prow/(double)som_get_rows(core->sec[location].som),
-					(double)pcol/(double)som_get_cols(core->sec[location].som));
-
-					/* where in the section array is the acceptor in 
-						question */
-					acc_loc = find_section_by_id(
-						core->sec[location].emitter.con[j].section_id, 
-							core->sec, core->num_sec);
-					emission_slot = core->sec[location].emitter.con[j].slot;
-
-					/* ok, add the output to the correct intqueue slot for the
-						acceptor. This function takes ownership of the memory.
-						*/
-					intqueue_enqueue(
-						core->sec[acc_loc].receptor.slot[emission_slot].iq,
-						output);
-					output = NULL;
-				}
-			}
+	/* all of the tables at once */
+	cortex_batch_init(core, n);
+	for (t = 0; t < n; t++)
+	{
+		core->batch_out[t].request = request;
+		core->batch_out[t].step = core->num_steps++;
+		/* XXX wrong, just like in cortex_process() */
+		core->batch_out[t].mode = CORTEX_LEARNING;
+	}
 
-			/* This next part dealing with the output channels of sections that
-				have them will happen no matter if the section was classifying 
-				or learning.  */
-
-			/* find the output channel serial id associated with this 
-				section id. */
-			omindex = find_outmap_by_sec_id(core->exec[i], core->outmap, 
-							core->num_outmap);
-
-			if (omindex != CORTEX_NOT_FOUND) {
-				/* This section has an output, so set it up into the output
-					table */
-
-				/* find it in the output table */
-				outputindex = cortex_output_table_find_output_by_outchan_id(
-									core->outmap[omindex].ochan_id, ctxout);
-
-				/* make the output representation symbol:
-					dim 0,1 contain the physical location in the cortex
-					dim 2,3 contain the physical location in the section
-					dim 4,5 contain the normalized location for the section
-				*/
-				output = symbol_init(6);
-				symbol_set_6(output,
-					core->sec[location].y + prow,
-					core->sec[location].x + pcol,
-					prow, 
-					pcol,
-					(double)prow/(double)som_get_rows(core->sec[location].som),
-					(double)pcol/(double)som_get_cols(core->sec[location].som));
-
-				/* now, place the symbol into the output table and mark the
-					output channel as active. The output table gains owner
-					ship of the symbol memory. */
-				ctxout->output[omindex].active = TRUE;
-				ctxout->output[omindex].osym = output;
-
-				output = NULL;
-			}
+	/* the agents overlap the frames on their own */
+	if (core->agents != NULL) {
+		agents_room(core, n);
+		for (t = 0; t < n; t++)
+		{
+			core->agents->frames[t] = frames[t];
+			core->agents->request[t] = request;
+			core->agents->tables[t] = &core->batch_out[t];
 		}
+		agents_run(core, n);
+		checkpoint_step(core);
 
-		/* if I got a NULL from trying to abstract the receptor, then just go
-			to the next section in the execution order */
+		return core->batch_out;
 	}
 
-	/* XXX wrong */
-	ctxout->mode = CORTEX_LEARNING;
-	
-	/* the result of what I asked to do, for the available output channels */
-	return ctxout;
-}
+	/* Learning changes the SOMs as it goes, so every section has to see
+		frame t before anyone sees frame t + 1. */
+	if (request == CORTEX_REQUEST_LEARN || core->plan.step_major == FALSE)
+	{
+		for (t = 0; t < n; t++)
+		{
+			cortex_emit_input(core, frames[t]);
+			cortex_run_plan(core, request, &core->batch_out[t]);
+		}
+		checkpoint_step(core);
 
+		return core->batch_out;
+	}
 
-/* ------------------------------------------------------------------------- */
-/* some helper functions to deal with the cortex structure */
+	/* Classifying doesn't change the SOMs, so each section can do the
+		whole batch before the next one starts. */
+	job.core = core;
+	job.frames = frames;
+	job.n = n;
+	if (pool_get_num_threads(core->pool) == 1) {
+		for (i = 0; i < core->plan.num_step; i++)
+		{
+			cortex_classify_step(&job, i);
+		}
+	} else {
+		pool_run_graph(core->pool, &core->plan.graph, cortex_classify_step, 
+			&job);
+	}
 
-/* if all of the slots in the receptor are ready, then ask each of them for
-	their concatenated symbols, and then concatenate all of those results
-	together into a super symbol which is then the input for this section. If
-	for whatever reason(not all queues are ready, etc) a full receptor
-	abstraction can't hapen, then return NULL */
+	/* the inputs are mine, and everybody has their copies now */
+	for (t = 0; t < n; t++)
+	{
+		for (i = 0; i < core->num_input; i++)
+		{
+			symbol_free(frames[t][i]);
+		}
+	}
+	checkpoint_step(core);
+
+	return core->batch_out;
+}
+
+/* make sure there is room for n frames and clean off the tables */
+static void cortex_batch_init(Cortex *core, int n)
+{
+	int i, t;
+	Section *sec;
+
+	if (n > core->batch_room)
+	{
+		for (t = 0; t < core->batch_room; t++)
+		{
+			cortex_output_table_release(&core->batch_out[t]);
+		}
+		free(core->batch_out);
+
+		core->batch_out = 
+			(CortexOutputTable*)xmalloc(sizeof(CortexOutputTable) * n);
+		for (t = 0; t < n; t++)
+		{
+			cortex_output_table_setup(core, &core->batch_out[t]);
+			/* these aren't given back one at a time */
+			core->batch_out[t].owner = NULL;
+		}
+		core->batch_room = n;
+	}
+
+	for (t = 0; t < n; t++)
+	{
+		for (i = 0; i < core->batch_out[t].num_output; i++)
+		{
+			core->batch_out[t].output[i].active = FALSE;
+			core->batch_out[t].output[i].osym = NULL;
+		}
+	}
+
+	for (i = 0; i < core->num_sec; i++)
+	{
+		sec = &core->sec[i];
+		if (n <= sec->frame_room) {
+			continue;
+		}
+
+		for (t = 0; t < sec->frame_room; t++)
+		{
+			symbol_free(sec->frame_sym[t]);
+		}
+		free(sec->frame_sym);
+		free(sec->frame_ready);
+		free(sec->frame_rows);
+		free(sec->frame_cols);
+		sec->frame_sym = (Symbol**)xmalloc(sizeof(Symbol*) * n);
+		for (t = 0; t < n; t++)
+		{
+			sec->frame_sym[t] = NULL;
+		}
+		sec->frame_ready = (Symbol**)xmalloc(sizeof(Symbol*) * n);
+		sec->frame_rows = (int*)xmalloc(sizeof(int) * n);
+		sec->frame_cols = (int*)xmalloc(sizeof(int) * n);
+		sec->frame_room = n;
+	}
+}
+
+/* One section of the plan for every frame of a classifying batch. All of
+	the slots are fed by inputs or earlier steps, which are done with the
+	whole batch already, so I put each frame's symbols into the slots right
+	before looking at them. Every slot has only one emitter writing into it,
+	so they go in the same order as they would have one frame at a time. */
+static void cortex_classify_step(void *arg, int task)
+{
+	CortexBatchJob *job = (CortexBatchJob*)arg;
+	Cortex *core = job->core;
+	PlanStep *step = &core->plan.step[task];
+	Section *sec = step->sec;
+	Section *from;
+	PlanEmitter *pe;
+	IntQueue *iq;
+	Symbol *sym, *output;
+	Symbol emitted;
+	float vec[2];
+	int i, j, k, t, w;
+	int num_ready = 0;
+
+	emitted.dim = 2;
+	emitted.pool_class = SYMBOL_VIEW;
+	emitted.vec = vec;
+
+	for (t = 0; t < job->n; t++)
+	{
+		for (i = 0; i < sec->receptor.num_slot; i++)
+		{
+			iq = sec->receptor.slot[i].iq;
+			w = step->src[i];
+			if (w == CORTEX_NOT_FOUND) {
+				continue;
+			}
+
+			if (w < core->num_input)
+			{
+				pe = &core->plan.input[w];
+				sym = job->frames[t][w];
+			}
+			else
+			{
+				/* the same thing cortex_process_step() would have emitted */
+				pe = &core->plan.step[w - core->num_input].out;
+				from = core->plan.step[w - core->num_input].sec;
+				if (from->frame_rows[t] < 0 || 
+					from->state != SOM_CLASSIFYING || 
+					from->mode != SECTION_PROPOGATE)
+				{
+					continue;
+				}
+				symbol_set_2(&emitted, 
+					(double)from->frame_rows[t]/(double)som_get_rows(from->som),
+					(double)from->frame_cols[t]/(double)som_get_cols(from->som));
+				sym = &emitted;
+			}
+
+			for (j = 0; j < pe->num_dest; j++)
+			{
+				if (pe->dest[j] == iq) {
+					intqueue_enqueue(iq, sym);
+				}
+			}
+		}
+
+		/* keep a copy of the receptor for the search */
+		if ((sym = abstract_receptor(sec)) == NULL) {
+			continue;
+		}
+		if (sec->frame_sym[t] == NULL || sec->frame_sym[t]->dim != sym->dim)
+		{
+			symbol_free(sec->frame_sym[t]);
+			sec->frame_sym[t] = symbol_init(sym->dim);
+		}
+		symbol_move(sec->frame_sym[t], sym);
+		sec->frame_ready[num_ready++] = sec->frame_sym[t];
+	}
+
+	/* the bmus of all of the ready frames in one pass over the neurons */
+	if (num_ready > 0) {
+		sec->state = som_classify_batch(sec->som, sec->frame_ready, num_ready,
+			sec->frame_rows, sec->frame_cols);
+		sec->secdisp.learn_row = sec->frame_rows[num_ready - 1];
+		sec->secdisp.learn_col = sec->frame_cols[num_ready - 1];
+	}
+
+	/* spread the packed bmus back out to their frames, backwards so
+		nothing is overwritten before it is moved */
+	k = num_ready - 1;
+	for (t = job->n - 1; t >= 0; t--)
+	{
+		if (k >= 0 && sec->frame_ready[k] == sec->frame_sym[t])
+		{
+			sec->frame_rows[t] = sec->frame_rows[k];
+			sec->frame_cols[t] = sec->frame_cols[k];
+			k--;
+		}
+		else
+		{
+			sec->frame_rows[t] = -1;
+		}
+	}
+
+	if (step->output == CORTEX_NOT_FOUND) {
+		return;
+	}
+
+	/* the same output cortex_process_step() makes */
+	for (t = 0; t < job->n; t++)
+	{
+		if (sec->frame_rows[t] < 0) {
+			continue;
+		}
+
+		output = core->batch_out[t].output[step->output].store;
+		symbol_set_6(output,
+			sec->y + sec->frame_rows[t],
+			sec->x + sec->frame_cols[t],
+			sec->frame_rows[t], 
+			sec->frame_cols[t],
+			(double)sec->frame_rows[t]/(double)som_get_rows(sec->som),
+			(double)sec->frame_cols[t]/(double)som_get_cols(sec->som));
+		core->batch_out[t].output[step->output].active = TRUE;
+		core->batch_out[t].output[step->output].osym = output;
+	}
+}
+
+
+void cortex_set_pipeline(Cortex *core, int depth)
+{
+	if (core->pipe.num_waiting != 0 || 
+		core->pipe.next_done < core->pipe.num_done)
+	{
+		printf("cortex_set_pipeline(): The pipeline has to be flushed "
+			"first!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	pipe_free(core);
+
+	if (depth <= 0) {
+		return;
+	}
+
+	core->pipe.depth = depth;
+	core->pipe.waiting = 
+		(Symbol**)xmalloc(sizeof(Symbol*) * depth * (core->num_input + 1));
+	core->pipe.request = (int*)xmalloc(sizeof(int) * depth);
+	core->pipe.done = 
+		(CortexOutputTable**)xmalloc(sizeof(CortexOutputTable*) * depth);
+
+	pipe_graph_init(core, depth);
+}
+
+void cortex_set_agents(Cortex *core, int num_agents)
+{
+	if (core->pipe.num_waiting != 0 || 
+		core->pipe.next_done < core->pipe.num_done)
+	{
+		printf("cortex_set_agents(): The pipeline has to be flushed "
+			"first!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* the sections come back here before going anywhere else */
+	if (core->agents != NULL) {
+		agents_stop(core);
+	}
+
+	if (num_agents > 0) {
+		agents_start(core, num_agents);
+	}
+}
+
+void cortex_sync(Cortex *core)
+{
+	if (core->agents != NULL) {
+		agents_sync(core);
+	}
+}
+
+CortexOutputTable* cortex_pipeline_push(Cortex *core, Symbol **inputs, 
+	int num_inputs, int request)
+{
+	int i;
+	CortexPipeline *pipe = &core->pipe;
+
+	if (pipe->depth == 0)
+	{
+		printf("cortex_pipeline_push(): Pipelining isn't on!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (request != CORTEX_REQUEST_CLASSIFY && request != CORTEX_REQUEST_LEARN)
+	{
+		printf("cortex_pipeline_push(): Invalid request! %d\n", request);
+		exit(EXIT_FAILURE);
+	}
+
+	cortex_check_input(core, inputs, num_inputs, "cortex_pipeline_push");
+
+	/* get in line */
+	for (i = 0; i < core->num_input; i++)
+	{
+		pipe->waiting[(pipe->num_waiting * core->num_input) + i] = inputs[i];
+	}
+	pipe->request[pipe->num_waiting] = request;
+	pipe->num_waiting++;
+
+	/* By the time the line is full, all of the tables from the last run have
+		been handed out, so run the next bunch. */
+	if (pipe->num_waiting == pipe->depth) {
+		pipe_run(core);
+	}
+
+	if (pipe->next_done < pipe->num_done) {
+		return pipe->done[pipe->next_done++];
+	}
+
+	return NULL;
+}
+
+CortexOutputTable* cortex_pipeline_flush(Cortex *core)
+{
+	CortexPipeline *pipe = &core->pipe;
+
+	if (pipe->next_done == pipe->num_done && pipe->num_waiting != 0) {
+		pipe_run(core);
+	}
+
+	if (pipe->next_done < pipe->num_done) {
+		return pipe->done[pipe->next_done++];
+	}
+
+	return NULL;
+}
+
+/* run everything waiting in the pipeline at once */
+static void pipe_run(Cortex *core)
+{
+	int t;
+	CortexPipeline *pipe = &core->pipe;
+	PoolGraph graph;
+
+	for (t = 0; t < pipe->num_waiting; t++)
+	{
+		pipe->done[t] = cortex_output_table_init(core);
+		pipe->done[t]->request = pipe->request[t];
+		pipe->done[t]->step = core->num_steps++;
+	}
+
+	if (core->agents != NULL)
+	{
+		agents_room(core, pipe->num_waiting);
+		for (t = 0; t < pipe->num_waiting; t++)
+		{
+			core->agents->frames[t] = &pipe->waiting[t * core->num_input];
+			core->agents->request[t] = pipe->request[t];
+			core->agents->tables[t] = pipe->done[t];
+		}
+		agents_run(core, pipe->num_waiting);
+	}
+	else
+	{
+		/* The edges of the unrolled graph only go forward in time, so the
+			first few time steps of it are a graph by themselves. */
+		graph = pipe->graph;
+		graph.num_tasks = pipe->num_waiting * (core->plan.num_step + 1);
+		pool_run_graph(core->pool, &graph, pipe_task, core);
+	}
+
+	for (t = 0; t < pipe->num_waiting; t++)
+	{
+		/* XXX wrong, just like in cortex_process() */
+		pipe->done[t]->mode = CORTEX_LEARNING;
+	}
+
+	pipe->num_done = pipe->num_waiting;
+	pipe->next_done = 0;
+	pipe->num_waiting = 0;
+
+	checkpoint_step(core);
+}
+
+/* one piece of one time step of the unrolled plan */
+static void pipe_task(void *arg, int task)
+{
+	Cortex *core = (Cortex*)arg;
+	CortexPipeline *pipe = &core->pipe;
+	int t = task / (core->plan.num_step + 1);
+	int k = task % (core->plan.num_step + 1);
+	CortexStepJob job;
+
+	if (k == 0) {
+		cortex_emit_input(core, &pipe->waiting[t * core->num_input]);
+		return;
+	}
+
+	job.core = core;
+	job.request = pipe->request[t];
+	job.ctxout = pipe->done[t];
+	cortex_process_step(&job, k - 1);
+}
+
+/* Unroll the plan's graph depth times. A task has to wait for the latest
+	earlier instance of every step it conflicts with, and every step
+	conflicts with itself since it has a SOM. The earlier instances before
+	that are taken care of because each step waits on its own last
+	instance. */
+static void pipe_graph_init(Cortex *core, int depth)
+{
+	int a, b, i, t, u, v;
+	int num_step = core->plan.num_step;
+	int per = num_step + 1;
+	int n = depth * per;
+	int num_edges;
+	char *conf;
+	int *num_succ;
+	PlanStep input;
+	PoolGraph *g = &core->pipe.graph;
+
+	/* the input pretends to be a step which writes into every slot any
+		input goes into */
+	input.sec = NULL;
+	input.output = CORTEX_NOT_FOUND;
+	input.out.num_dest = 0;
+	for (i = 0; i < core->num_input; i++)
+	{
+		input.out.num_dest += core->plan.input[i].num_dest;
+	}
+	input.out.dest = 
+		(IntQueue**)xmalloc(sizeof(IntQueue*) * (input.out.num_dest + 1));
+	input.out.num_dest = 0;
+	for (i = 0; i < core->num_input; i++)
+	{
+		for (a = 0; a < core->plan.input[i].num_dest; a++)
+		{
+			input.out.dest[input.out.num_dest++] = 
+				core->plan.input[i].dest[a];
+		}
+	}
+
+	/* which kinds of tasks conflict, kind 0 is the input, kind k is step
+		k - 1 */
+	conf = (char*)xmalloc(sizeof(char) * per * per);
+	for (a = 0; a < per; a++)
+	{
+		for (b = 0; b < per; b++)
+		{
+			conf[a * per + b] = (a == b) || plan_conflict(
+				a == 0 ? &input : &core->plan.step[a - 1],
+				b == 0 ? &input : &core->plan.step[b - 1]);
+		}
+	}
+	free(input.out.dest);
+
+	g->num_tasks = n;
+	g->num_deps = (int*)xmalloc(sizeof(int) * (n + 1));
+	g->succ_start = (int*)xmalloc(sizeof(int) * (n + 2));
+	num_succ = (int*)xmalloc(sizeof(int) * (n + 1));
+
+	for (u = 0; u < n; u++)
+	{
+		g->num_deps[u] = 0;
+		num_succ[u] = 0;
+	}
+
+	/* count, then fill in. v is an instance of kind b at time t, and it
+		waits on the latest instance of kind a before it. */
+	for (i = 0; i < 2; i++)
+	{
+		if (i == 1) {
+			num_edges = 0;
+			for (u = 0; u < n; u++)
+			{
+				g->succ_start[u] = num_edges;
+				num_edges += num_succ[u];
+				num_succ[u] = 0;
+			}
+			g->succ_start[n] = num_edges;
+			g->succ = (int*)xmalloc(sizeof(int) * (num_edges + 1));
+		}
+
+		for (v = 0; v < n; v++)
+		{
+			t = v / per;
+			b = v % per;
+			for (a = 0; a < per; a++)
+			{
+				u = (a < b) ? (t * per) + a : ((t - 1) * per) + a;
+				if (u < 0 || conf[a * per + b] == FALSE) {
+					continue;
+				}
+
+				if (i == 0) {
+					g->num_deps[v]++;
+				} else {
+					g->succ[g->succ_start[u] + num_succ[u]] = v;
+				}
+				num_succ[u]++;
+			}
+		}
+	}
+
+	free(num_succ);
+	free(conf);
+}
+
+/* throw away everything in the pipeline and turn it off */
+static void pipe_free(Cortex *core)
+{
+	int i;
+	CortexPipeline *pipe = &core->pipe;
+
+	for (i = 0; i < pipe->num_waiting * core->num_input; i++)
+	{
+		symbol_free(pipe->waiting[i]);
+	}
+	for (i = pipe->next_done; i < pipe->num_done; i++)
+	{
+		cortex_output_table_free(pipe->done[i]);
+	}
+
+	free(pipe->waiting);
+	free(pipe->request);
+	free(pipe->done);
+	free(pipe->graph.num_deps);
+	free(pipe->graph.succ_start);
+	free(pipe->graph.succ);
+
+	pipe->depth = 0;
+	pipe->graph.num_tasks = 0;
+	pipe->graph.num_deps = NULL;
+	pipe->graph.succ_start = NULL;
+	pipe->graph.succ = NULL;
+	pipe->num_waiting = 0;
+	pipe->waiting = NULL;
+	pipe->request = NULL;
+	pipe->num_done = 0;
+	pipe->next_done = 0;
+	pipe->done = NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* some helper functions to deal with the cortex structure */
+
+/* if all of the slots in the receptor are ready, then ask each of them for
+	their concatenated symbols, and then concatenate all of those results
+	together into a super symbol which is then the input for this section. If
+	for whatever reason(not all queues are ready, etc) a full receptor
+	abstraction can't hapen, then return NULL. The returned symbol belongs
+	to the section and gets overwritten next time. */
 static Symbol* abstract_receptor(Section *sec)
 {
 	int i;
-	Symbol **abs_list;
-	Symbol *sym;
+	int dim, offset;
 
 	/* check to see if all receptors are ready */
 	for (i = 0; i < sec->receptor.num_slot; i++)
@@ -916,16 +1668,33 @@ static Symbol* abstract_receptor(Section *sec)
 	/* ok, if I made it here, it means that the entire receptor is ready for
 		abstraction... */
 
-	abs_list = (Symbol**)xmalloc(sizeof(Symbol*) * sec->receptor.num_slot);
+	/* the receptor symbol is only remade if the abstraction changes size,
+		which in practice is just the first time */
+	dim = 0;
+	for (i = 0; i < sec->receptor.num_slot; i++)
+	{
+		dim += intqueue_dim(sec->receptor.slot[i].iq);
+	}
+	if (sec->rsym == NULL || sec->rsym->dim != dim)
+	{
+		if (sec->rsym != NULL) {
+			symbol_free(sec->rsym);
+		}
+		sec->rsym = symbol_init(dim);
+	}
 
-	/* gather the results from each integration queue */
+	/* have each integration queue write its abstraction straight into its
+		piece of the receptor symbol */
+	offset = 0;
 	for (i = 0; i < sec->receptor.num_slot; i++)
 	{
-		/* this returns a new piece of memory, so remember to free it later */
-		abs_list[i] = intqueue_dequeue(sec->receptor.slot[i].iq);
+		symbol_view(&sec->rview[i], sec->rsym, offset, 
+			intqueue_dim(sec->receptor.slot[i].iq));
+		offset += sec->rview[i].dim;
 
 		/* sanity check */
-		if (abs_list[i] == NULL)
+		if (intqueue_dequeue_into(sec->receptor.slot[i].iq, 
+				&sec->rview[i]) == FALSE)
 		{
 			printf("abstract_receptor(): I couldn't dequeue when I thought I "
 				"could!\n");
@@ -933,18 +1702,278 @@ static Symbol* abstract_receptor(Section *sec)
 		}
 	}
 
-	/* produce the super abstraction of the entire receptor */
-	sym = symbol_abstract(abs_list, sec->receptor.num_slot);
+	return sec->rsym;
+}
+
+/* look up the intqueue of every connection in the emitter */
+static void plan_emitter_init(PlanEmitter *pe, Emitter *em, Cortex *core)
+{
+	int i;
+	int location;
 
-	/* get rid of my little container structure, and the symbols inside it */
-	for (i = 0; i < sec->receptor.num_slot; i++)
+	pe->num_dest = em->num_con;
+	pe->dest = (IntQueue**)xmalloc(sizeof(IntQueue*) * em->num_con);
+
+	for (i = 0; i < em->num_con; i++)
+	{
+		location = find_section_by_id(em->con[i].section_id, core->sec, 
+			core->num_sec);
+		if (location == CORTEX_NOT_FOUND)
+		{
+			printf("cortex_plan_init(): Can't emit to unknown section %d!\n",
+				em->con[i].section_id);
+			exit(EXIT_FAILURE);
+		}
+
+		if (em->con[i].slot < 0 || 
+			em->con[i].slot >= core->sec[location].receptor.num_slot)
+		{
+			printf("cortex_plan_init(): Section %d has no slot %d!\n",
+				em->con[i].section_id, em->con[i].slot);
+			exit(EXIT_FAILURE);
+		}
+
+		pe->dest[i] = core->sec[location].receptor.slot[em->con[i].slot].iq;
+	}
+}
+
+/* Everything cortex_process() does per step used to search for serial ids,
+	so do all of those searches once here instead. */
+static void cortex_plan_init(Cortex *core)
+{
+	int i;
+	int location, omindex;
+
+	core->plan.input = 
+		(PlanEmitter*)xmalloc(sizeof(PlanEmitter) * core->num_input);
+	for (i = 0; i < core->num_input; i++)
+	{
+		plan_emitter_init(&core->plan.input[i], &core->input[i].emitter, core);
+	}
+
+	core->plan.num_step = core->num_exec;
+	core->plan.step = (PlanStep*)xmalloc(sizeof(PlanStep) * core->num_exec);
+	for (i = 0; i < core->num_exec; i++)
+	{
+		location = find_section_by_id(core->exec[i], core->sec, core->num_sec);
+		if (location == CORTEX_NOT_FOUND)
+		{
+			printf("cortex_plan_init(): Can't execute unknown section %d!\n",
+				core->exec[i]);
+			exit(EXIT_FAILURE);
+		}
+
+		core->plan.step[i].sec = &core->sec[location];
+		plan_emitter_init(&core->plan.step[i].out, 
+			&core->sec[location].emitter, core);
+		core->plan.step[i].src = (int*)xmalloc(sizeof(int) * 
+			(core->sec[location].receptor.num_slot + 1));
+		core->plan.step[i].emit = symbol_init(2);
+		core->plan.step[i].emitted = FALSE;
+
+		/* the output table is in the same order as the output channels */
+		core->plan.step[i].output = CORTEX_NOT_FOUND;
+		omindex = find_outmap_by_sec_id(core->exec[i], core->outmap, 
+			core->num_outmap);
+		if (omindex != CORTEX_NOT_FOUND)
+		{
+			core->plan.step[i].output = find_outchan_by_id(
+				core->outmap[omindex].ochan_id, core->outchan, 
+				core->num_outchan);
+			if (core->plan.step[i].output == CORTEX_NOT_FOUND)
+			{
+				printf("cortex_plan_init(): Section %d outputs to unknown "
+					"output channel %d!\n", core->exec[i],
+					core->outmap[omindex].ochan_id);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	/* work out which steps have to wait for which */
+	plan_graph_init(&core->plan);
+
+	/* and who feeds each slot */
+	core->plan.step_major = TRUE;
+	for (i = 0; i < core->num_exec; i++)
+	{
+		plan_src_init(core, i);
+	}
+}
+
+/* Find the emitter which writes into each of a step's slots, and if it is
+	a step which doesn't come before this one, then the batches can't go a
+	step at a time */
+static void plan_src_init(Cortex *core, int k)
+{
+	int i, j, w;
+	IntQueue *iq;
+	PlanStep *step = &core->plan.step[k];
+	PlanEmitter *pe;
+
+	for (i = 0; i < step->sec->receptor.num_slot; i++)
+	{
+		iq = step->sec->receptor.slot[i].iq;
+		step->src[i] = CORTEX_NOT_FOUND;
+
+		for (w = 0; w < core->num_input + core->plan.num_step; w++)
+		{
+			if (w < core->num_input) {
+				pe = &core->plan.input[w];
+			} else {
+				pe = &core->plan.step[w - core->num_input].out;
+			}
+
+			for (j = 0; j < pe->num_dest; j++)
+			{
+				if (pe->dest[j] != iq) {
+					continue;
+				}
+
+				/* there is only ever one parent per slot, but make sure */
+				if (step->src[i] != CORTEX_NOT_FOUND && step->src[i] != w) {
+					core->plan.step_major = FALSE;
+				}
+				step->src[i] = w;
+			}
+		}
+
+		if (step->src[i] >= core->num_input + k) {
+			core->plan.step_major = FALSE;
+		}
+	}
+}
+
+/* does the step's section read from that queue? */
+static int plan_reads(PlanStep *step, IntQueue *iq)
+{
+	int i;
+
+	/* feeding in the input doesn't read anything */
+	if (step->sec == NULL) {
+		return FALSE;
+	}
+
+	for (i = 0; i < step->sec->receptor.num_slot; i++)
+	{
+		if (step->sec->receptor.slot[i].iq == iq) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* does the step's section write into that queue? */
+static int plan_writes(PlanStep *step, IntQueue *iq)
+{
+	int i;
+
+	for (i = 0; i < step->out.num_dest; i++)
+	{
+		if (step->out.dest[i] == iq) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* do the two steps touch a queue in a way where their order matters? */
+static int plan_conflict(PlanStep *a, PlanStep *b)
+{
+	int i;
+
+	for (i = 0; i < a->out.num_dest; i++)
+	{
+		if (plan_reads(b, a->out.dest[i]) || plan_writes(b, a->out.dest[i])) {
+			return TRUE;
+		}
+	}
+
+	for (i = 0; i < b->out.num_dest; i++)
+	{
+		if (plan_reads(a, b->out.dest[i])) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* an earlier step which conflicts with a later one has to run first */
+static void plan_graph_init(CortexPlan *plan)
+{
+	int i, j, num_edges;
+	int n = plan->num_step;
+	char *edge;
+
+	edge = (char*)xmalloc(sizeof(char) * (n * n + 1));
+
+	num_edges = 0;
+	for (i = 0; i < n; i++)
+	{
+		for (j = 0; j < n; j++)
+		{
+			edge[i * n + j] = 
+				(i < j && plan_conflict(&plan->step[i], &plan->step[j]));
+			num_edges += edge[i * n + j];
+		}
+	}
+
+	plan->graph.num_tasks = n;
+	plan->graph.num_deps = (int*)xmalloc(sizeof(int) * (n + 1));
+	plan->graph.succ_start = (int*)xmalloc(sizeof(int) * (n + 1));
+	plan->graph.succ = (int*)xmalloc(sizeof(int) * (num_edges + 1));
+
+	for (j = 0; j < n; j++)
+	{
+		plan->graph.num_deps[j] = 0;
+		for (i = 0; i < j; i++)
+		{
+			plan->graph.num_deps[j] += edge[i * n + j];
+		}
+	}
+
+	num_edges = 0;
+	for (i = 0; i < n; i++)
+	{
+		plan->graph.succ_start[i] = num_edges;
+		for (j = i + 1; j < n; j++)
+		{
+			if (edge[i * n + j]) {
+				plan->graph.succ[num_edges++] = j;
+			}
+		}
+	}
+	plan->graph.succ_start[n] = num_edges;
+
+	free(edge);
+}
+
+static void cortex_plan_free(Cortex *core)
+{
+	int i;
+
+	free(core->plan.graph.num_deps);
+	free(core->plan.graph.succ_start);
+	free(core->plan.graph.succ);
+
+	for (i = 0; i < core->num_input; i++)
 	{
-		symbol_free(abs_list[i]);
-		abs_list[i] = NULL;
+		free(core->plan.input[i].dest);
 	}
-	free(abs_list);
+	free(core->plan.input);
+	core->plan.input = NULL;
 
-	return sym;
+	for (i = 0; i < core->plan.num_step; i++)
+	{
+		free(core->plan.step[i].out.dest);
+		free(core->plan.step[i].src);
+		symbol_free(core->plan.step[i].emit);
+	}
+	free(core->plan.step);
+	core->plan.step = NULL;
 }
 
 int which_kind_of_emitter(int serial_id, Section *sec, int num_sec,
@@ -1053,9 +2082,50 @@ CortexOutputTable* cortex_output_table_init(Cortex *core)
 	int i;
 	CortexOutputTable *ctxout = NULL;
 
+	/* if one was given back to me, clean it off and use that */
+	if (core->spare_out != NULL) {
+		ctxout = core->spare_out;
+		core->spare_out = ctxout->next_spare;
+		ctxout->next_spare = NULL;
+
+		for (i = 0; i < ctxout->num_output; i++)
+		{
+			ctxout->output[i].active = FALSE;
+			ctxout->output[i].osym = NULL;
+		}
+
+		return ctxout;
+	}
+
 	ctxout = (CortexOutputTable*)xmalloc(sizeof(CortexOutputTable) * 1);
+	cortex_output_table_setup(core, ctxout);
+
+	return ctxout;
+}
+
+CortexOutputTable* cortex_output_table_init_reusable(Cortex *core)
+{
+	CortexOutputTable *ctxout = NULL;
+
+	ctxout = (CortexOutputTable*)xmalloc(sizeof(CortexOutputTable) * 1);
+	cortex_output_table_setup(core, ctxout);
+
+	/* nothing to do with the cortex's spares */
+	ctxout->owner = NULL;
+
+	return ctxout;
+}
+
+/* fill in a brand new output table wherever it happens to live */
+static void cortex_output_table_setup(Cortex *core, CortexOutputTable *ctxout)
+{
+	int i;
+
 	ctxout->num_output = core->num_outchan;
 	ctxout->output = NULL;
+	ctxout->owner = core;
+	ctxout->next_spare = NULL;
+	ctxout->step = 0;
 	/* WARNING: request and mode are undefined at this point! */
 
 	if (ctxout->num_output != 0) {
@@ -1066,17 +2136,13 @@ CortexOutputTable* cortex_output_table_init(Cortex *core)
 		for (i = 0; i < ctxout->num_output; i++)
 		{
 			ctxout->output[i].active = FALSE;
+			ctxout->output[i].store = symbol_init(CORTEX_OUTPUT_DIM);
 			ctxout->output[i].ochan.serial_id = core->outchan[i].serial_id;
-			ctxout->output[i].ochan.name = NULL;
-			if (core->outchan[i].name != NULL) {
-				ctxout->output[i].ochan.name = strdup(core->outchan[i].name);
-			}
+			ctxout->output[i].ochan.name = core->outchan[i].name;
 				
 			ctxout->output[i].osym = NULL;
 		}
 	}
-
-	return ctxout;
 }
 
 /* get rid of the output table structure, lock stock and barrel */
@@ -1084,24 +2150,37 @@ void cortex_output_table_free(CortexOutputTable *ctxout)
 {
 	int i;
 
-	if (ctxout->num_output != 0) {
-		for (i = 0; i < ctxout->num_output; i++) {
-			if (ctxout->output[i].ochan.name != NULL) {
-				free(ctxout->output[i].ochan.name);
-				ctxout->output[i].ochan.name = NULL;
-			}
+	for (i = 0; i < ctxout->num_output; i++) {
+		ctxout->output[i].active = FALSE;
+		ctxout->output[i].osym = NULL;
+	}
 
-			if (ctxout->output[i].osym != NULL) {
-				symbol_free(ctxout->output[i].osym);
-				ctxout->output[i].osym = NULL;
-			}
-		}
+	/* the cortex keeps it to reuse */
+	if (ctxout->owner != NULL) {
+		ctxout->next_spare = ctxout->owner->spare_out;
+		ctxout->owner->spare_out = ctxout;
+		return;
 	}
 
-	free(ctxout->output);
-	ctxout->output = NULL;
+	cortex_output_table_release(ctxout);
 
-	free(ctxout);
+	xfree(ctxout);
+}
+
+/* free what the table holds, but not the table itself */
+static void cortex_output_table_release(CortexOutputTable *ctxout)
+{
+	int i;
+
+	/* the names belong to the cortex */
+	for (i = 0; i < ctxout->num_output; i++) {
+		ctxout->output[i].ochan.name = NULL;
+		symbol_free(ctxout->output[i].store);
+		ctxout->output[i].store = NULL;
+	}
+
+	xfree(ctxout->output);
+	ctxout->output = NULL;
 }
 
 /* print out an output table to stdout */
@@ -1158,55 +2237,6 @@ int cortex_output_table_find_output_by_outchan_id(int ochanid,
 	return CORTEX_NOT_FOUND;
 }
 
-/* ------------------------------------------------------------------------ */
-/* some file parsing helper functions */
-
-static char* read_lctx_line(char *buf, int size, FILE *f, char *desc)
-{
-	char *ptr = NULL;
-
-	if ((ptr = lowlevel_get_lctx_line(buf, size, f)) == NULL) {
-		printf("cortex_init(): Short read while reading: %s\n", desc);
-		exit(EXIT_FAILURE);
-	}
-
-/*	printf("READ(%s): %s", desc, ptr);*/
-
-	return ptr;
-}
-
-/* Return a line which is not a comment/whitespace line */
-static char* lowlevel_get_lctx_line(char *buf, int size, FILE *f)
-{
-	int meat;
-	char *str;
-	char *ptr;
-
-	do {
-		/* assume I'm going to read something valid at first */
-		meat = TRUE;
-
-		str = fgets(buf, size, f);
-
-		/* check for end of input */
-		if (str == NULL) {
-			return NULL;
-		}
-
-		/* check to see if it isn't a comment/whitespace line */
-		ptr = str;
-		while(*ptr == ' ' || *ptr == '\t' || *ptr == '\n') {
-			ptr++;
-		}
-		if (*ptr == '#' || *ptr == '\0') {
-			/* this is a comment, or line of whitespace */
-			meat = FALSE;
-		}
-
-	} while(meat == FALSE);
-
-	return buf;
-}
 
 
 
@@ -1,6 +1,12 @@
 #ifndef CORTEX_H
 #define CORTEX_H
 
+enum
+{
+	/* This MUST be -1 since it represents an index into an array */
+	CORTEX_NOT_FOUND = -1
+};
+
 enum
 {
 	/* if the section produces output, I can just consume it and do nothing */
@@ -125,6 +131,30 @@ typedef struct Section_s
 		purposes */
 	SecDisp secdisp;
 
+	/* If batch_size is 0 the SOM learns each symbol as it arrives, otherwise
+		up to batch_size symbols are saved up here and handed to
+		som_learn_batch() all at once. The rows/cols are where the batch's
+		bmus get written. */
+	int batch_size;
+	int batch_num;
+	Symbol **batch;
+	int *batch_rows, *batch_cols;
+
+	/* The abstraction of the whole receptor is written here, rview has a
+		view for each slot looking at its piece of rsym. The section keeps
+		rsym, so whoever wants it past the current step has to copy it. */
+	Symbol *rsym;
+	Symbol *rview;
+
+	/* cortex_process_batch() scratch with room for frame_room frames: the
+		receptor symbol of each frame, the ones which were ready packed
+		together, and where the SOM put each frame. The row is -1 if the
+		receptor wasn't ready at that frame. */
+	int frame_room;
+	Symbol **frame_sym;
+	Symbol **frame_ready;
+	int *frame_rows, *frame_cols;
+
 } Section;
 
 /* -------------------------------------------------------------------------- */
@@ -169,6 +199,10 @@ typedef struct CortexOutputMapping_s
 
 } CortexOutputMapping;
 
+/* How many floats are in an output symbol, the location in the cortex, in
+	the section, and normalized to the section, each a row and a column. */
+#define CORTEX_OUTPUT_DIM 6
+
 /* there will always be the same number of these as there are output channels */
 typedef struct CortexOutput_s
 {
@@ -176,14 +210,18 @@ typedef struct CortexOutput_s
 	int active;
 
 	/* to which output channel does this particular output bind. The char
-		pointer in this structure is strdup()'ed from the CortexOutputChannel
-		structure so it needs to be freed then the table this is used in below
-		is freed. */
+		pointer in this structure is the cortex's own name for the channel,
+		so it is only good as long as the cortex is around. */
 	CortexOutputChannel ochan;
 
-	/* The normalized 2d output of the section outputting to this channel */
+	/* The normalized 2d output of the section outputting to this channel,
+		it points at store when the output is active and is NULL when not. */
 	Symbol *osym;
 
+	/* the table's own symbol for the output, so no thread making an output
+		has to malloc one. It goes away with the table. */
+	Symbol *store;
+
 } CortexOutput;
 
 /* This is the structure that gets produced and returned as output from
@@ -206,10 +244,22 @@ typedef struct CortexOutputTable_s
 	/* what mode is the cortex in? learning or classifying? */
 	int mode;
 
+	/* which input this is the output for, the first input the cortex ever
+		gets is step 0 */
+	unsigned long step;
+
 	/* how many output channels are there at this time? */
 	int num_output;
 	CortexOutput *output;
 
+	/* The cortex which made this table. When the table is freed the cortex
+		keeps it to hand out again from the next cortex_process(), so free
+		all of the tables before freeing the cortex. It is NULL for a table
+		the caller owns, which really goes away when it is freed. */
+	struct Cortex_s *owner;
+	/* the next table the cortex is saving for reuse */
+	struct CortexOutputTable_s *next_spare;
+
 } CortexOutputTable;
 
 /* -------------------------------------------------------------------------- */
@@ -345,6 +395,90 @@ typedef struct ReverseTable_s
 
 /* This is the big cortex structure which holds everything needed to build a
 	noncyclic statistical feature classifier */
+/* cortex_init() compiles the serial ids in the .lctx file down to this so
+	cortex_process() never has to look anything up. */
+
+/* where one emitter (an input or a section) writes its symbols */
+typedef struct PlanEmitter_s
+{
+	int num_dest;
+	IntQueue **dest;
+
+} PlanEmitter;
+
+/* one section in execution order */
+typedef struct PlanStep_s
+{
+	Section *sec;
+
+	/* the intqueues of the slots this section feeds */
+	PlanEmitter out;
+
+	/* where in an output table this section's output goes, or
+		CORTEX_NOT_FOUND if it doesn't have an output channel */
+	int output;
+
+	/* what this section gave its emitter the last time it ran, emitted is
+		FALSE if it didn't give it anything */
+	Symbol *emit;
+	int emitted;
+
+	/* Who writes into each of the section's slots. Less than num_input
+		means that input, otherwise it is plan step src - num_input. It is
+		CORTEX_NOT_FOUND if nothing ever writes there. */
+	int *src;
+
+} PlanStep;
+
+typedef struct CortexPlan_s
+{
+	/* one for each input, in the same order as core->input */
+	PlanEmitter *input;
+
+	/* one for each entry in core->exec */
+	int num_step;
+	PlanStep *step;
+
+	/* Step j depends on an earlier step i if i writes into a queue j reads,
+		j writes into a queue i reads, or they both write into the same
+		queue. Running the steps in any order that respects this gives the
+		same answer as running them in the execution order. */
+	PoolGraph graph;
+
+	/* TRUE if every slot is written by an input or by an earlier step, so
+		cortex_process_batch() can classify a whole batch one step at a
+		time */
+	int step_major;
+
+} CortexPlan;
+
+/* In pipelined mode the cortex saves up depth inputs and then runs all of
+	them at once, so the bottom of the cortex can start on a later input
+	while the top is still working on an earlier one. Everything still
+	happens in an order that gives the same answers as one cortex_process()
+	per input. */
+typedef struct CortexPipeline_s
+{
+	/* how many inputs are in flight at most, 0 if not pipelining */
+	int depth;
+
+	/* The plan unrolled depth times. Task t * (num_step + 1) is feeding
+		the input of time step t into the cortex, and the num_step tasks
+		after it are the plan's steps for that time step. */
+	PoolGraph graph;
+
+	/* inputs waiting for their turn, depth rows of num_input symbols */
+	int num_waiting;
+	Symbol **waiting;
+	int *request;
+
+	/* output tables from the last run, handed out oldest first */
+	int num_done;
+	int next_done;
+	CortexOutputTable **done;
+
+} CortexPipeline;
+
 typedef struct Cortex_s
 {
 	/* The sections I'm simulating */
@@ -375,6 +509,40 @@ typedef struct Cortex_s
 	/* the wave propogation table used when doing reverse lookups */
 	WaveTable wt;
 
+	/* the threads every section's SOM shares for bmu searches and batch
+		learning */
+	Pool *pool;
+
+	/* a freed output table waiting to be reused, or NULL */
+	CortexOutputTable *spare_out;
+
+	/* the graph above, with everything looked up */
+	CortexPlan plan;
+
+	/* how many inputs the cortex has been given */
+	unsigned long num_steps;
+
+	CortexPipeline pipe;
+
+	/* the tables cortex_process_batch() hands back, room of them */
+	int batch_room;
+	CortexOutputTable *batch_out;
+
+	/* If this isn't NULL, the sections are being run by worker processes
+		and only they have the real SOMs and slots, see agent.h */
+	struct CortexAgents_s *agents;
+
+	/* the background checkpoints, NULL if there never were any, see
+		checkpoint.h */
+	struct CortexCheckpointer_s *ckpt;
+
+	/* The .lctx this cortex came from without the comments and extra
+		whitespace, one line after another, and its hash. A checkpoint
+		only goes back into a cortex with the same hash. */
+	char *topology;
+	unsigned long topology_len;
+	unsigned long long topology_hash;
+
 } Cortex;
 
 /* -------------------------------------------------------------------------- */
@@ -417,14 +585,23 @@ int cortex_output_table_find_output_by_outchan_id(int outchanid,
 
 void cortex_output_table_stdout(CortexOutputTable *ctxout);
 
+/* run one step of the plan for whatever is in its slots right now, writing
+	its output, if any, into ctxout */
+void cortex_run_step(Cortex *core, int step, int request, 
+	CortexOutputTable *ctxout);
+
 /* END private stuff */
 
 /* PUBLIC stuff */
 
 /* -------------------------------------------------------------------------- */
-/* construct a corex given a file which contains an .lctx description */
+/* construct a corex given a file which contains an .lctx description, or
+	its .lctxb, or the .ctx itself, see lctx.h */
 Cortex* cortex_init(char *file);
 
+/* construct a cortex out of a description that was already read in */
+Cortex* cortex_init_lctx(Lctx *lc);
+
 /* Take whatever input I have and give it to the cortex. The cortex takes 
 	control of this memory, so pass it malloc()'ed stuff, also the inputs
 	must be in the same order as the .ctx file specified it. The return
@@ -435,8 +612,56 @@ Cortex* cortex_init(char *file);
 CortexOutputTable* cortex_process(Cortex *core, Symbol **inputs, 
 	int num_inputs, int request);
 
-/* draw the cortex */
-void cortex_draw(Cortex *core, int style);
+/* Just like cortex_process(), but the answer is written into a table the
+	caller made with cortex_output_table_init_reusable() and keeps using
+	step after step, so nothing about the output ever touches the heap. */
+void cortex_process_into(Cortex *core, Symbol **inputs, int num_inputs, 
+	int request, CortexOutputTable *ctxout);
+
+/* Make an output table for cortex_process_into() that belongs to the
+	caller. cortex_output_table_free() gets rid of it, and it has to go
+	before the cortex does since it shares the channel names. */
+CortexOutputTable* cortex_output_table_init_reusable(Cortex *core);
+
+/* Process n frames at once, frames[t] is the num_inputs input symbols of
+	frame t and the cortex takes them just like cortex_process() does. The
+	answers are what n calls to cortex_process() would give, and come back
+	as an array of n tables, one per frame, which belongs to the cortex and
+	is good until the next call. Don't free them. When classifying, each
+	section finds the bmus of all of the frames in one trip through its
+	neurons. */
+CortexOutputTable* cortex_process_batch(Cortex *core, Symbol ***frames, 
+	int n, int num_inputs, int request);
+
+/* Pipeline up to depth inputs at a time, 0 turns it back off. Don't change
+	this while there is anything in the pipeline. */
+void cortex_set_pipeline(Cortex *core, int depth);
+
+/* The pipelined version of cortex_process(). The inputs are taken just
+	the same, but the table that comes back is for some earlier input, look
+	at its step to see which one, or NULL if nothing is done yet. Once the
+	pipeline fills up, every push gives back one table. */
+CortexOutputTable* cortex_pipeline_push(Cortex *core, Symbol **inputs, 
+	int num_inputs, int request);
+
+/* Finish whatever inputs are still in the pipeline and hand back their
+	tables, one per call, in order. Returns NULL when it is empty. */
+CortexOutputTable* cortex_pipeline_flush(Cortex *core);
+
+/* Run the sections in num_agents worker processes instead of in this one,
+	0 brings them all back. This is also done by cortex_init() if the
+	environment variable MANIFOLD_AGENTS is set. See agent.h. */
+void cortex_set_agents(Cortex *core, int num_agents);
+
+/* With agents, the sections and SOMs in core->sec are only as new as the
+	last time they were brought back, this brings them up to date. Anything
+	that looks at their state, iterations, or neurons should call it first.
+	Without agents it does nothing. */
+void cortex_sync(Cortex *core);
+
+/* Start (TRUE) or stop (FALSE) recording the bmu search traces of every
+	section so cortex_draw() can show them */
+void cortex_set_trace(Cortex *core, int on);
 
 /* get rid of it all */
 void cortex_free(Cortex *core);
@@ -0,0 +1,359 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <GL/gl.h>
+#include <GL/glu.h>
+#include "common.h"
+
+/* All of the OpenGL drawing of SOMs, cortices, and glyphs lives in here.
+	Nothing in the compute side (som.c, cortex.c, etc) draws anything, it
+	just leaves behind what there is to see (the bmus, quality maps, and
+	bmu search traces) and these functions look at it afterwards. */
+
+static void som_draw_actual(SOM *s, int x, int y);
+static void som_draw_quality(SOM *s, unsigned int quality, int x, int y);
+
+/* draw the som at some offset */
+void som_draw(SOM *s, unsigned int style, int x, int y)
+{
+	int default_quality = 4;
+
+	glPushMatrix();
+	switch(style)
+	{
+		case SOM_STYLE_ACTUAL:
+			som_draw_actual(s, x, y);
+			break;
+		case SOM_STYLE_QUALITY:
+			som_draw_quality(s, default_quality, x, y);
+			break;
+		default:
+			printf("som_draw(): Unknown style: %d\n", style);
+			exit(EXIT_FAILURE);
+	}
+	glPopMatrix();
+}
+
+static void som_draw_quality(SOM *s, unsigned int quality, int x, int y)
+{
+	int row, col;
+	float v0, v1, v2, v3;
+
+	som_compute_quality(s, quality);
+
+	/* now draw the quality field */
+
+	/* a little inefficient, I really need to use textures... */
+	glBegin(GL_QUADS);
+	for(row = 0; row < s->sd.rows - 1; row++)
+	{
+		for (col = 0; col < s->sd.cols - 1; col++)
+		{
+			/* don't forget to normalize it */
+			/* in this convolution, the neurons which are closest together will
+				be white, and those farthest apart will be black */
+			v0 = 1.0 - (s->qmap[SOM_ADR(row, col, s)] / s->max_dist);
+			v1 = 1.0 - (s->qmap[SOM_ADR(row, col+1, s)] / s->max_dist);
+			v2 = 1.0 - (s->qmap[SOM_ADR(row+1, col+1, s)] / s->max_dist);
+			v3 = 1.0 - (s->qmap[SOM_ADR(row+1, col, s)] / s->max_dist);
+
+			glColor3f(v0, v0, v0);
+			glVertex3f(x + col, y + row, 0.0);
+
+			glColor3f(v1, v1, v1);
+			glVertex3f(x + col+1, y + row, 0.0);
+
+			glColor3f(v2, v2, v2);
+			glVertex3f(x + col + 1, y + row + 1, 0.0);
+
+			glColor3f(v3, v3, v3);
+			glVertex3f(x + col, y + row+1, 0.0);
+		}
+	}
+	glEnd();
+}
+
+void som_draw_reticule(SOM *s, int x, int y, int row, int col)
+{
+	/* draw a little box around the specified location in x, y. It is
+		colored yellow if the SOM is still learning and green otherwise. */
+
+	glBegin(GL_LINE_LOOP);
+	switch(s->mode)
+	{
+		case SOM_LEARNING:
+			glColor3f(1, 1, 0);
+			break;
+		case SOM_CLASSIFYING:
+			glColor3f(0, 1, 0);
+			break;
+		default:
+			glColor3f(1, 0, 0);
+		break;
+	}
+	glVertex3f(col-10+x, row-10+y, 0.5);
+	glVertex3f(col-10+x, row+10+y, 0.5);
+	glVertex3f(col+10+x, row+10+y, 0.5);
+	glVertex3f(col+10+x, row-10+y, 0.5);
+	glEnd();
+}
+
+/* draw the points the last bmu search recorded, if it recorded any. Ties
+	are red and new bests are green. */
+void som_draw_trace(SOM *s, int x, int y)
+{
+	int i;
+
+	if (s->trace == NULL) {
+		return;
+	}
+
+	glBegin(GL_POINTS);
+	for (i = 0; i < s->trace_num; i++)
+	{
+		switch(s->trace[i].kind)
+		{
+			case SOM_TRACE_TIE:
+				glColor3f(1.0, 0.0, 0.0);
+				break;
+			case SOM_TRACE_BETTER:
+				glColor3f(0.0, 1.0, 0.0);
+				break;
+			default:
+				glColor3f(1.0, 1.0, 1.0);
+				break;
+		}
+		glVertex3f(s->trace[i].col + x, s->trace[i].row + y, .2);
+	}
+	glEnd();
+}
+
+static void som_draw_actual(SOM *s, int x, int y)
+{
+	int row, col;
+	Symbol *sym;
+/*	glBegin(GL_LINES);*/
+/*		glColor3f(1, 1, 1);*/
+/*		glVertex3f(x, y, 0.1);*/
+/*		glVertex3f(x + s->sd.cols, y + s->sd.rows, 1.0);*/
+/*	glEnd();*/
+
+	glNormal3f(0, 0, 1);
+	switch(s->sd.dim)
+	{
+		case 0:
+			printf("oops, can't draw a zero dimensional som\n");
+			exit(EXIT_FAILURE);
+			break;
+
+		case 1:
+			glBegin(GL_QUADS);
+			for(row = 0; row < s->sd.rows - 1; row++)
+			{
+				for (col = 0; col < s->sd.cols - 1; col++)
+				{
+					/* According to page 45 of the opengl book */
+					/* V0 */
+					sym = som_symbol_ref(s, row, col);
+					glColor3f(sym->vec[0], sym->vec[0], sym->vec[0]);
+					glVertex3f(x + col, y + row, 0.0);
+					
+					/* V1 */
+					sym = som_symbol_ref(s, row, col+1);
+					glColor3f(sym->vec[0], sym->vec[0], sym->vec[0]);
+					glVertex3f(x + col + 1, y + row, 0.0);
+		
+					/* V2 */
+					sym = som_symbol_ref(s, row + 1, col + 1);
+					glColor3f(sym->vec[0], sym->vec[0], sym->vec[0]);
+					glVertex3f(x + col + 1, y + row + 1, 0.0);
+		
+					/* V3 */
+					sym = som_symbol_ref(s, row+1, col);
+					glColor3f(sym->vec[0], sym->vec[0], sym->vec[0]);
+					glVertex3f(x + col, y + row + 1, 0.0);
+				}
+			}
+			glEnd();
+			break;
+
+		case 2:
+			glBegin(GL_QUADS);
+			for(row = 0; row < s->sd.rows - 1; row++)
+			{
+				for (col = 0; col < s->sd.cols - 1; col++)
+				{
+					/* According to page 45 of the opengl book */
+					/* V0 */
+					sym = som_symbol_ref(s, row, col);
+					glColor3f(sym->vec[0], sym->vec[1], 0);
+					glVertex3f(x + col, y + row, 0.0);
+					
+					/* V1 */
+					sym = som_symbol_ref(s, row, col+1);
+					glColor3f(sym->vec[0], sym->vec[1], 0);
+					glVertex3f(x + col+1, y + row, 0.0);
+		
+					/* V2 */
+					sym = som_symbol_ref(s, row + 1, col + 1);
+					glColor3f(sym->vec[0], sym->vec[1], 0);
+					glVertex3f(x + col + 1, y + row + 1, 0.0);
+		
+					/* V3 */
+					sym = som_symbol_ref(s, row+1, col);
+					glColor3f(sym->vec[0], sym->vec[1], 0);
+					glVertex3f(x + col + 1, y + row+1, 0.0);
+				}
+			}
+			glEnd();
+			break;
+
+		default:
+			glBegin(GL_QUADS);
+			for(row = 0; row < s->sd.rows - 1; row++)
+			{
+				for (col = 0; col < s->sd.cols - 1; col++)
+				{
+					/* According to page 45 of the opengl book */
+					/* V0 */
+					sym = som_symbol_ref(s, row, col);
+					glColor3f(sym->vec[0], sym->vec[1], sym->vec[2]);
+					glVertex3f(x + col, y + row, 0.0);
+					
+					/* V1 */
+					sym = som_symbol_ref(s, row, col+1);
+					glColor3f(sym->vec[0], sym->vec[1], sym->vec[2]);
+					glVertex3f(x + col+1, y + row, 0.0);
+		
+					/* V2 */
+					sym = som_symbol_ref(s, row + 1, col + 1);
+					glColor3f(sym->vec[0], sym->vec[1], sym->vec[2]);
+					glVertex3f(x + col + 1, y + row + 1, 0.0);
+		
+					/* V3 */
+					sym = som_symbol_ref(s, row+1, col);
+					glColor3f(sym->vec[0], sym->vec[1], sym->vec[2]);
+					glVertex3f(x + col, y + row+1, 0.0);
+				}
+			}
+			glEnd();
+			break;
+
+	}
+}
+
+void cortex_draw(Cortex *core, int style)
+{
+	int i;
+	Section *sec;
+	int row, col;
+	int draw_boxes = 1;
+
+	/* if agents are running the sections, my copies are old */
+	cortex_sync(core);
+
+	/* ok, let's draw the SOMs at the location required */
+
+	for (i = 0; i < core->num_sec; i++)
+	{
+		sec = &core->sec[i];
+		som_draw(sec->som, style, sec->x, sec->y);
+		som_draw_trace(sec->som, sec->x, sec->y);
+
+		/* draw the marker box around the WTA */
+		if (draw_boxes == 1)
+		{
+			row = core->sec[i].secdisp.learn_row;
+			col = core->sec[i].secdisp.learn_col;
+
+			/* mark winning neuron */
+			glBegin(GL_POINTS);
+				glColor3f(1, 1, 1);
+				glVertex3f(col+sec->x, row+sec->y, 0.5);
+			glEnd();
+
+			/* TODO: update this to use som_draw_reticule() */
+
+			/* draw a little box around the last learning location */
+			glBegin(GL_LINE_LOOP);
+			switch(core->sec[i].state)
+			{
+				case SOM_LEARNING:
+					glColor3f(1, 1, 0);
+					break;
+				case SOM_CLASSIFYING:
+					glColor3f(0, 1, 0);
+					break;
+				default:
+					glColor3f(1, 0, 0);
+				break;
+			}
+			glVertex3f(col-10+sec->x, row-10+sec->y, 0.5);
+			glVertex3f(col-10+sec->x, row+10+sec->y, 0.5);
+			glVertex3f(col+10+sec->x, row+10+sec->y, 0.5);
+			glVertex3f(col+10+sec->x, row-10+sec->y, 0.5);
+			glEnd();
+		}
+	}
+}
+
+/* draw a single glyph */
+void vinput_draw_glyph(VInput *vinp, Symbol **glyph, int x, int y)
+{
+	int i, j;
+	float val;
+
+	glPointSize(5.0);
+	glBegin(GL_POINTS);
+
+	for(i = 0; i < vinp->subimage_bit_rows; i++)
+	{
+		for(j = 0; j < vinp->subimage_bit_cols; j++)
+		{
+			symbol_get_index(glyph[i], &val, j);
+			glColor3f(val, val, val);
+			glVertex3f(x + j*5, y - i*5, 0.0);
+		}
+	}
+
+	glEnd();
+	glPointSize(1.0);
+}
+
+/* draw the timeslices of an input resolution */
+void vinput_draw_irt(VInput *vinp, InputResTable *irt, int x, int y)
+{
+	int input;
+	int pixel;
+	float color;
+
+	/* for now, just draw time slice zero. The null inputs get a blue
+		shade, error will be a red 'x' over the "pixel" whose intensity
+		is modulated by the actual error value */
+
+	glPointSize(5.0);
+	glBegin(GL_POINTS);
+	for (input = 0; input < irt->num_inres; input++) {
+		if (irt->inres[input].active == TRUE) {
+			for (pixel = 0; pixel < vinp->subimage_bit_cols; pixel++)
+			{
+				symbol_get_index(irt->inres[input].resolution[0], 
+						&color, pixel);
+				glColor3f(color, color, color);
+				/* flip the y axis */
+				glVertex3f(x + pixel*5, y - input*5, 0.0);
+			}
+		}
+		else
+		{
+			for (pixel = 0; pixel < vinp->subimage_bit_cols; pixel++)
+			{
+				glColor3f(1.0, 0, 0);
+
+				/* flip the y axis */
+				glVertex3f(x + pixel*5, y - input*5, 0.0);
+			}
+		}
+	}
+	glEnd();
+	glPointSize(1.0);
+}
@@ -0,0 +1,23 @@
+#ifndef DRAW_H
+#define DRAW_H
+
+/* draw the SOM, either drawing the neurons themselves, or the quality map */
+void som_draw(SOM *s, unsigned int style, int x, int y);
+
+/* Draw a reticule (whose color changes if the SOM is learning or not) around
+	the row,col point in the SOM which is located at x,y. */
+void som_draw_reticule(SOM *s, int x, int y, int row, int col);
+
+/* draw the neurons the last bmu search traced, see som_set_trace() */
+void som_draw_trace(SOM *s, int x, int y);
+
+/* draw the cortex */
+void cortex_draw(Cortex *core, int style);
+
+/* draw the input resolution of a reverse lookup */
+void vinput_draw_irt(VInput *vinp, InputResTable *irt, int x, int y);
+
+/* draw a glyph */
+void vinput_draw_glyph(VInput *vinp, Symbol **glyph, int x, int y);
+
+#endif
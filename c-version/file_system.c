@@ -90,6 +90,12 @@ FileSystem* filesystem_init(int num_files, File **files, int iterations)
 	fs->block = som_init(8, iterations, 256, 512, NULL);
 	fs->map = som_init(2, iterations, 256, 256, NULL);
 
+	/* one thread per processor for the bmu searches */
+	fs->pool = pool_init(0);
+	som_set_pool(fs->location, fs->pool);
+	som_set_pool(fs->block, fs->pool);
+	som_set_pool(fs->map, fs->pool);
+
 	return fs;
 }
 
@@ -104,6 +110,7 @@ void filesystem_destroy(FileSystem *fs)
 	som_free(fs->location);
 	som_free(fs->block);
 	som_free(fs->map);
+	pool_free(fs->pool);
 
 	free(fs);
 }
@@ -276,16 +283,12 @@ int filesystem_train(FileSystem *fs)
 	*/
 	som_learn(fs->block, block,
 		&block_bmu_row, &block_bmu_col, 
-						256, 0, SOM_REQUEST_LEARN, FALSE);
-	
-	som_draw_reticule(fs->block, 256, 0, block_bmu_row, block_bmu_col);
+						SOM_REQUEST_LEARN, FALSE);
 
 	/* Then we learn the uid/fid/pos at any old place in the location som. */
 	state = som_learn(fs->location, location,
 						&location_bmu_row, &location_bmu_col, 
-						0, 0, SOM_REQUEST_LEARN, FALSE);
-
-	som_draw_reticule(fs->block, 0, 0, location_bmu_row, location_bmu_col);
+						SOM_REQUEST_LEARN, FALSE);
 
 	/*
 		****************************************
@@ -304,9 +307,7 @@ int filesystem_train(FileSystem *fs)
 			are done learning.
 		*/
 		state = som_learn(fs->map, map, &location_bmu_row, &location_bmu_col, 
-						128, 256, SOM_REQUEST_LEARN, TRUE);
-		som_draw_reticule(fs->block, 128, 256, location_bmu_row, 
-							location_bmu_col);
+						SOM_REQUEST_LEARN, TRUE);
 		symbol_free(map);
 		map = NULL;
 	}
@@ -461,6 +462,10 @@ void test_filesystem(void)
 
 	fs = filesystem_init(3, files, iterations);
 
+	/* show the ties the bmu searches run into */
+	som_set_trace(fs->location, TRUE);
+	som_set_trace(fs->block, TRUE);
+
 	now = SDL_GetTicks();
 	sample = now - 1; /* draw one frame immediately */
 	iter = 0;
@@ -540,6 +545,16 @@ void test_filesystem(void)
 			som_draw(fs->location, drawing_mode, 0, 0);
 			som_draw(fs->map, drawing_mode, 128, 256);
 			som_draw(fs->block, drawing_mode, 256, 0);
+			som_draw_trace(fs->location, 0, 0);
+			som_draw_trace(fs->block, 256, 0);
+
+			/* and where each SOM last learned something */
+			som_draw_reticule(fs->location, 0, 0, 
+				som_get_bmu_row(fs->location), som_get_bmu_col(fs->location));
+			som_draw_reticule(fs->map, 128, 256, 
+				som_get_bmu_row(fs->map), som_get_bmu_col(fs->map));
+			som_draw_reticule(fs->block, 256, 0, 
+				som_get_bmu_row(fs->block), som_get_bmu_col(fs->block));
 
 			glerr = glGetError();
 			if (glerr != GL_NO_ERROR) {
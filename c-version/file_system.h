@@ -39,6 +39,9 @@ typedef struct FileSystem_s
 	/* Contains <location> : <block> */
 	SOM *map;
 
+	/* the maps are huge, so their bmu searches use these threads */
+	Pool *pool;
+
 } FileSystem;
 
 /* create a new file structure (with real file-names), ready to read. */
@@ -1,7 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
-#include "common.h"
+#include "manifold.h"
 
 /* initialize the table to read convert printable ascii characters into 
 	symbols of arbitrary(but constant) dimension */
@@ -1,43 +1,32 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include "common.h"
+#include <string.h>
+#include "manifold.h"
+
+/* where row r of slice s starts in the ring */
+#define IQ_ROW(iq, s, r) \
+	((iq)->ring + ((((s) * 2 * (iq)->num_syms) + (r)) * (iq)->dim))
 
 IntQueue* intqueue_init(int num_syms, int num_slices)
 {
-	int i, j;
+	int i;
 	IntQueue *iq = NULL;
-	Symbol **sq = NULL;
 
 	iq = (IntQueue*)xmalloc(sizeof(IntQueue) * 1);
 
 	iq->num_syms = num_syms;
 	iq->num_slices = num_slices;
 
-	/* allocate the slice array */
-	iq->slice = (Symbol***)xmalloc(sizeof(Symbol**) * num_slices);
-
-	/* allocate the requested queue(of length num_syms) for each slice */
-	for (i = 0; i < num_slices; i++)
-	{
-		iq->slice[i] = (Symbol**)xmalloc(sizeof(Symbol*) * num_syms);
-		
-		/* initialize it to NULL */
-		sq = iq->slice[i];
-		
-		for (j = 0; j < num_syms; j++)
-		{
-			sq[j] = NULL;
-		}
-	}
+	/* I don't know how big the symbols are until the first one shows up */
+	iq->dim = 0;
+	iq->ring = NULL;
 
-	/* allocate the array that tells me how full each slice queue is */
-	iq->slice_top = (int*)xmalloc(sizeof(int) * num_slices);
+	iq->head = (int*)xmalloc(sizeof(int) * num_slices);
+	iq->count = (int*)xmalloc(sizeof(int) * num_slices);
 	for (i = 0; i < num_slices; i++)
 	{
-		/* when the queue is completely empty, the top is equal to num_syms
-			and this mustr be treated carefully during insertion of symbols
-			int othe queue */
-		iq->slice_top[i] = num_syms;
+		iq->head[i] = 0;
+		iq->count[i] = 0;
 	}
 
 	/* start at the beginning slice */
@@ -53,116 +42,64 @@ IntQueue* intqueue_init(int num_syms, int num_slices)
 
 void intqueue_free(IntQueue *iq)
 {
-	Symbol **sq = NULL;
-	int i, j;
-
-	for (i = 0; i < iq->num_slices; i++)
-	{
-		sq = iq->slice[i];
-		/* delete the queue, taking care if it is partially full */
-		for (j = iq->slice_top[i]; j < iq->num_syms; j++)
-		{
-			/* The integration queue owns the symbol memory, so it must free
-				them */
-			if (sq[j] != NULL)
-			{
-				symbol_free(sq[j]);
-			}
-		}
-
-		free(iq->slice[i]);
-	}
-
-	free(iq->slice);
-
-	free(iq->slice_top);
+	free(iq->ring);
+	free(iq->head);
+	free(iq->count);
+	free(iq);
 }
 
-/* put the symbol into the current slice's queue, if the slice would be full 
-	after I put it in, then mark the intqueue as ready, and set up the ready
-	slice variable. Then increment the slice index. */
+/* Copy the symbol into the next row of the current slice's ring, which
+	overwrites the oldest one if the slice is already full. If the slice is
+	full after I put it in, then mark the intqueue as ready, and set up the
+	ready slice variable. Then increment the slice index. */
 void intqueue_enqueue(IntQueue *iq, Symbol *sym)
 {
-	int i;
-	Symbol **sq = NULL;
+	int s = iq->curr_slice;
+	int r;
 
-	sq = iq->slice[iq->curr_slice];
+	if (iq->ring == NULL) {
+		iq->dim = sym->dim;
+		iq->ring = (float*)xmalloc(sizeof(float) *
+			iq->num_slices * 2 * iq->num_syms * iq->dim);
+	}
 
-	switch(iq->slice_top[iq->curr_slice])
+	if (sym->dim != iq->dim)
 	{
-		/* if I enqueue this symbol into an already full current slice, then
-			free the top, move everything up, and add it to the bottom. Then
-			mark this slicing queue as the ready queue, and increment the 
-			slice index */
-		case 0:
-			/* get rid of the top of the slice queue */
-			symbol_free(sq[0]);
-
-			/* move everything up */
-			for (i = 1; i < iq->num_syms; i++)
-			{
-				sq[i-1] = sq[i];
-			}
-
-			/* enqueue the symbol onto the bottom */
-			(iq->slice[iq->curr_slice])[iq->num_syms - 1] = sym;
-
-			/* do not modify the top of this slice, cause it is still zero */
-
-			/* this queue is now ready */
-			iq->ready = TRUE;
-			iq->ready_slice = iq->curr_slice;
-		
-			break;
-
-			/* if I enqueue this symbol into an slice queue which then becomes 
-				full as a result of the enqueue, then mark it as ready */
-		case 1:
-
-			/* move everything up */
-			for (i = iq->slice_top[iq->curr_slice]; i < iq->num_syms; i++)
-			{
-				sq[i-1] = sq[i];
-			}
-
-			/* enqueue the symbol onto the bottom */
-			(iq->slice[iq->curr_slice])[iq->num_syms - 1] = sym;
-
-			/* fix the top of this slice to be correct */
-			iq->slice_top[iq->curr_slice]--;
-
-			/* this queue is now ready */
-			iq->ready = TRUE;
-			iq->ready_slice = iq->curr_slice;
-			
-			break;
-
-		/* just enqueue the symbol into this particular slice */
-		default:
-			/* move everything up */
-			for (i = iq->slice_top[iq->curr_slice]; i < iq->num_syms; i++)
-			{
-				sq[i-1] = sq[i];
-			}
+		printf("intqueue_enqueue(): A %d dimensional symbol can't go into "
+			"a queue of %d dimensional symbols!\n", sym->dim, iq->dim);
+		exit(EXIT_FAILURE);
+	}
 
-			/* enqueue the symbol onto the bottom */
-			(iq->slice[iq->curr_slice])[iq->num_syms - 1] = sym;
+	/* write it twice, num_syms rows apart, so the newest num_syms rows are
+		always sitting in one contiguous piece starting at the head */
+	r = iq->head[s];
+	memcpy(IQ_ROW(iq, s, r), sym->vec, sizeof(float) * iq->dim);
+	memcpy(IQ_ROW(iq, s, r + iq->num_syms), sym->vec,
+		sizeof(float) * iq->dim);
+	iq->head[s] = (r + 1) % iq->num_syms;
 
-			/* Now that I added something to the queue, move the head */
-			iq->slice_top[iq->curr_slice]--;
+	if (iq->count[s] < iq->num_syms) {
+		iq->count[s]++;
+	}
 
-			/* once an slicing queue becomes ready, every next slicing queue
-				MUST be ready when the next enqueue happens, so this is a 
-				sanity check for that. */
-			if (iq->ready == TRUE)
-			{
-				printf("intqueue_enqueue(): cannot go from ready to "
-					"nonready!\n");
-				exit(EXIT_FAILURE);
-			}
-			iq->ready = FALSE;
-			
-			break;
+	if (iq->count[s] == iq->num_syms)
+	{
+		/* this queue is now ready */
+		iq->ready = TRUE;
+		iq->ready_slice = s;
+	}
+	else
+	{
+		/* once an slicing queue becomes ready, every next slicing queue
+			MUST be ready when the next enqueue happens, so this is a
+			sanity check for that. */
+		if (iq->ready == TRUE)
+		{
+			printf("intqueue_enqueue(): cannot go from ready to "
+				"nonready!\n");
+			exit(EXIT_FAILURE);
+		}
+		iq->ready = FALSE;
 	}
 
 	/* the next enqueue goes to the next slice in a round robin fashion */
@@ -174,19 +111,59 @@ int intqueue_ready(IntQueue *iq)
 	return iq->ready;
 }
 
+Symbol* intqueue_window(IntQueue *iq)
+{
+	if (iq->ready == FALSE)
+	{
+		return NULL;
+	}
+
+	/* the oldest row is the one the head will overwrite next */
+	iq->window.dim = iq->num_syms * iq->dim;
+	iq->window.pool_class = SYMBOL_VIEW;
+	iq->window.vec = IQ_ROW(iq, iq->ready_slice, iq->head[iq->ready_slice]);
+
+	return &iq->window;
+}
+
 /* Take the particular ready queue specified and produce an abstraction of it */
 Symbol* intqueue_dequeue(IntQueue *iq)
 {
-	Symbol *abstraction;
+	Symbol *window;
 
-	if (iq->ready == FALSE)
+	if ((window = intqueue_window(iq)) == NULL)
 	{
 		return NULL;
 	}
 
-	abstraction = symbol_abstract(iq->slice[iq->ready_slice], iq->num_syms);
+	return symbol_copy(window);
+}
+
+/* Write the abstraction of the ready slice into out instead of making a new
+	symbol */
+int intqueue_dequeue_into(IntQueue *iq, Symbol *out)
+{
+	Symbol *window;
+
+	if ((window = intqueue_window(iq)) == NULL)
+	{
+		return FALSE;
+	}
+
+	symbol_move(out, window);
+
+	return TRUE;
+}
+
+/* how big of a symbol would a dequeue make right now */
+int intqueue_dim(IntQueue *iq)
+{
+	if (iq->ready == FALSE)
+	{
+		return 0;
+	}
 
-	return abstraction;
+	return iq->num_syms * iq->dim;
 }
 
 /* return how many integrations this int queue is performing. */
@@ -195,10 +172,40 @@ int intqueue_integrations(IntQueue *iq)
 	return iq->num_syms;
 }
 
+void intqueue_row(IntQueue *iq, int slice, int row, Symbol *view)
+{
+	view->dim = iq->dim;
+	view->pool_class = SYMBOL_VIEW;
+	view->vec = iq->ring == NULL ? NULL : IQ_ROW(iq, slice, row);
+}
+
+void intqueue_put_row(IntQueue *iq, int slice, int row, Symbol *sym)
+{
+	if (iq->ring == NULL) {
+		iq->dim = sym->dim;
+		iq->ring = (float*)xmalloc(sizeof(float) *
+			iq->num_slices * 2 * iq->num_syms * iq->dim);
+	}
+
+	if (sym->dim != iq->dim || slice < 0 || slice >= iq->num_slices ||
+		row < 0 || row >= iq->num_syms)
+	{
+		printf("intqueue_put_row(): A %d dimensional symbol can't go into "
+			"row %d of slice %d of a queue of %d dimensional symbols!\n",
+			sym->dim, row, slice, iq->dim);
+		exit(EXIT_FAILURE);
+	}
+
+	/* both copies, like intqueue_enqueue() */
+	memcpy(IQ_ROW(iq, slice, row), sym->vec, sizeof(float) * iq->dim);
+	memcpy(IQ_ROW(iq, slice, row + iq->num_syms), sym->vec,
+		sizeof(float) * iq->dim);
+}
+
 void intqueue_stdout(IntQueue *iq)
 {
 	int i, j;
-	Symbol **sq = NULL;
+	Symbol row;
 
 	printf("\t\tIntegration Queue:\n");
 	printf("\t\t\tReady: %s\n", iq->ready==TRUE?"TRUE":"FALSE");
@@ -207,35 +214,19 @@ void intqueue_stdout(IntQueue *iq)
 	printf("\t\t\tNum Slices: %d\n", iq->num_slices);
 	for (i = 0; i < iq->num_slices; i++)
 	{
-		sq = iq->slice[i];
 		printf("\t\t\t\tSlice: %d\n", i);
+		/* oldest to newest, the empty ones are at the top */
 		for (j = 0; j < iq->num_syms; j++)
 		{
-			if (j < iq->slice_top[i]) {
+			if (j < iq->num_syms - iq->count[i]) {
 				printf("\t\t\t\t\tN/A\n");
 			} else {
+				row.dim = iq->dim;
+				row.pool_class = SYMBOL_VIEW;
+				row.vec = IQ_ROW(iq, i, iq->head[i] + j);
 				printf("\t\t\t\t\t");
-				symbol_stdout(sq[j]);
+				symbol_stdout(&row);
 			}
 		}
 	}
 }
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
@@ -17,16 +17,24 @@ typedef struct IntQueue_s
 	/* how many internal queues do I need to preserve the alias ordering */
 	int num_slices;
 
-	/* each slice index is another queue of num_syms length, the queues
-		fill from the end to the beginning and when something gets pushed off
-		the top, it is deallocated. */
-	Symbol ***slice;
+	/* the dimension of every symbol in the queue, it is set by the first
+		enqueue */
+	int dim;
 
-	/* each slice is a queue, and this array holds how full each slicing
-		queue is, this lets me know how to append new symbols into each 
-		individual queue. The TOP of the queue is 0 and the END of the queue
-		is num_syms. This number is a valid index to the head of the queue. */
-	int *slice_top;
+	/* Each slice is a ring of num_syms rows of dim floats, and the ring is
+		mirrored: every row is also written num_syms rows later. So, no
+		matter where the ring wraps, the last num_syms symbols of a slice
+		are one contiguous piece of floats, oldest first, and the abstraction
+		of a slice is just a view of it. Slice s starts at
+		ring + s * 2 * num_syms * dim. */
+	float *ring;
+
+	/* for each slice, the row the next symbol goes into, which is also the
+		oldest symbol once the slice is full */
+	int *head;
+
+	/* for each slice, how many symbols it holds, up to num_syms */
+	int *count;
 
 	/* which slice queue to enqueue the data into this wraps at the mod of
 		num_slices */
@@ -40,6 +48,9 @@ typedef struct IntQueue_s
 		curr_slice */
 	int ready_slice;
 
+	/* the view intqueue_window() hands out */
+	Symbol window;
+
 } IntQueue;
 
 /* set up an integration queue */
@@ -50,8 +61,7 @@ void intqueue_free(IntQueue *iq);
 
 /* insert a symbol into the integration queue, making sure to stick it into
 	the right slice, as determined by how many previous integration requests
-	there had been. This function takes control of the incomming memory
-	associated with the symbol. */
+	there had been. The symbol is copied in, so the caller still owns it. */
 void intqueue_enqueue(IntQueue *iq, Symbol *sym);
 
 /* return TRUE or FALSE if this queue is ready to be abstracted */
@@ -62,9 +72,33 @@ int intqueue_ready(IntQueue *iq);
 	active, then return NULL */
 Symbol* intqueue_dequeue(IntQueue *iq);
 
+/* the abstraction of the active slice as a view right into the queue, with
+	nothing copied. It is only good until the next enqueue. If no slice is
+	active, then return NULL */
+Symbol* intqueue_window(IntQueue *iq);
+
+/* like intqueue_dequeue(), but write the abstraction into out, which is
+	often a view into a bigger symbol, and return TRUE. If no slice is
+	active, out is left alone and this returns FALSE. */
+int intqueue_dequeue_into(IntQueue *iq, Symbol *out);
+
+/* the dimension of the symbol a dequeue would produce right now, or 0 if
+	the queue isn't ready */
+int intqueue_dim(IntQueue *iq);
+
 /* tell me how many integrations this intqueue is performing */
 int intqueue_integrations(IntQueue *iq);
 
+/* Look at row (0 up to num_syms) of a slice's ring through view, for
+	saving a queue somewhere. Only the count newest rows before the head
+	have anything in them. */
+void intqueue_row(IntQueue *iq, int slice, int row, Symbol *view);
+
+/* put sym back into row of a slice's ring, for bringing a saved queue back.
+	It doesn't touch head, count, or the readiness, that is up to the
+	caller. */
+void intqueue_put_row(IntQueue *iq, int slice, int row, Symbol *sym);
+
 void intqueue_stdout(IntQueue *iq);
 
 #endif
@@ -0,0 +1,457 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "manifold.h"
+
+/* the vector versions are x86 only, anything else gets the plain C one */
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNEL_X86
+#include <immintrin.h>
+#endif
+
+/* NOTE: None of these functions are allowed to use fused multiply adds, even
+	if the cpu has them, because the rounding would be different from the
+	scalar code. gcc will happily fuse a multiply and an add on its own if the
+	target allows it (and avx512f implies fma), so the targets below turn fma
+	off explicitly. */
+
+typedef void (*KERNEL_DIST_FUNC)(float *slab, unsigned int stride,
+	unsigned int num, unsigned short dim, float *p, float *out);
+
+static void kernel_pick(void);
+
+static KERNEL_DIST_FUNC kernel_dist_impl = NULL;
+static const char *kernel_impl_name = NULL;
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+/* The reference implementation, every other one must match this exactly.
+	It starts at neuron "from" so the vector versions can use it to mop up
+	the neurons which don't fill a whole vector. It is never inlined so it
+	is always compiled for the plain target. */
+static void kernel_dist_scalar_from(float *slab, unsigned int stride,
+	unsigned int from, unsigned int num, unsigned short dim, float *p,
+	float *out)
+	__attribute__((noinline));
+
+static void kernel_dist_scalar_from(float *slab, unsigned int stride,
+	unsigned int from, unsigned int num, unsigned short dim, float *p,
+	float *out)
+{
+	unsigned int n;
+	int i;
+	float sum, tmp;
+	float *w;
+
+	for (n = from; n < num; n++)
+	{
+		w = slab + (n * stride);
+		sum = 0;
+		for (i = 0; i < dim; i++)
+		{
+			tmp = p[i] - w[i];
+			sum += tmp*tmp;
+		}
+		out[n] = sum;
+	}
+}
+
+static void kernel_dist_scalar(float *slab, unsigned int stride,
+	unsigned int num, unsigned short dim, float *p, float *out)
+{
+	kernel_dist_scalar_from(slab, stride, 0, num, dim, p, out);
+}
+
+#ifdef KERNEL_X86
+
+/* The general case of all of the vector versions go like this: take 4
+	neurons, grab the same 4 dimensions out of each of them, and compute the
+	squared differences. Then transpose that 4x4 block so each vector holds
+	ONE dimension of the 4 neurons and add them into the accumulator in
+	dimension order. The wider versions do this in each 128 bit lane at the
+	same time, so lane group g handles neurons 4g to 4g+3. If the dimension
+	isn't a multiple of 4, the last block reads a little past the end of
+	the neuron (into the next one or the slab padding) and the extra rows
+	are just not added. The input symbol doesn't have padding, so its last
+	partial block is copied into a zero padded buffer first. */
+
+static void kernel_dist_sse2(float *slab, unsigned int stride,
+	unsigned int num, unsigned short dim, float *p, float *out)
+	__attribute__((target("sse2,no-fma")));
+
+static void kernel_dist_sse2(float *slab, unsigned int stride,
+	unsigned int num, unsigned short dim, float *p, float *out)
+{
+	unsigned int n;
+	int c, full, rem;
+	float ptail[4] = {0, 0, 0, 0};
+	float *w;
+	__m128 pv, acc, a, b;
+	__m128 r0, r1, r2, r3, t0, t1, t2, t3;
+
+	n = 0;
+
+	if (dim == 1 && stride == 1)
+	{
+		pv = _mm_set1_ps(p[0]);
+		for (; n + 4 <= num; n += 4)
+		{
+			a = _mm_sub_ps(pv, _mm_loadu_ps(slab + n));
+			_mm_storeu_ps(out + n, _mm_mul_ps(a, a));
+		}
+	}
+	else if (dim == 2 && stride == 2)
+	{
+		pv = _mm_setr_ps(p[0], p[1], p[0], p[1]);
+		for (; n + 4 <= num; n += 4)
+		{
+			w = slab + (n * 2);
+			a = _mm_sub_ps(pv, _mm_loadu_ps(w));
+			a = _mm_mul_ps(a, a);
+			b = _mm_sub_ps(pv, _mm_loadu_ps(w + 4));
+			b = _mm_mul_ps(b, b);
+			/* evens are dimension 0, odds are dimension 1 */
+			acc = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+			acc = _mm_add_ps(acc,
+				_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+			_mm_storeu_ps(out + n, acc);
+		}
+	}
+	else
+	{
+		full = dim & ~3;
+		rem = dim - full;
+		memcpy(ptail, p + full, sizeof(float) * rem);
+
+		for (; n + 4 <= num; n += 4)
+		{
+			w = slab + (n * stride);
+			acc = _mm_setzero_ps();
+			for (c = 0; c < dim; c += 4)
+			{
+				pv = (c < full) ? _mm_loadu_ps(p + c) : _mm_loadu_ps(ptail);
+
+				r0 = _mm_sub_ps(pv, _mm_loadu_ps(w + c));
+				r0 = _mm_mul_ps(r0, r0);
+				r1 = _mm_sub_ps(pv, _mm_loadu_ps(w + stride + c));
+				r1 = _mm_mul_ps(r1, r1);
+				r2 = _mm_sub_ps(pv, _mm_loadu_ps(w + (2 * stride) + c));
+				r2 = _mm_mul_ps(r2, r2);
+				r3 = _mm_sub_ps(pv, _mm_loadu_ps(w + (3 * stride) + c));
+				r3 = _mm_mul_ps(r3, r3);
+
+				t0 = _mm_unpacklo_ps(r0, r1);
+				t1 = _mm_unpacklo_ps(r2, r3);
+				t2 = _mm_unpackhi_ps(r0, r1);
+				t3 = _mm_unpackhi_ps(r2, r3);
+
+				acc = _mm_add_ps(acc,
+					_mm_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0)));
+				if (c + 1 < dim) {
+					acc = _mm_add_ps(acc,
+						_mm_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2)));
+				}
+				if (c + 2 < dim) {
+					acc = _mm_add_ps(acc,
+						_mm_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0)));
+				}
+				if (c + 3 < dim) {
+					acc = _mm_add_ps(acc,
+						_mm_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2)));
+				}
+			}
+			_mm_storeu_ps(out + n, acc);
+		}
+	}
+
+	kernel_dist_scalar_from(slab, stride, n, num, dim, p, out);
+}
+
+static void kernel_dist_avx2(float *slab, unsigned int stride,
+	unsigned int num, unsigned short dim, float *p, float *out)
+	__attribute__((target("avx2,no-fma")));
+
+static void kernel_dist_avx2(float *slab, unsigned int stride,
+	unsigned int num, unsigned short dim, float *p, float *out)
+{
+	unsigned int n;
+	int c, full, rem;
+	float ptail[4] = {0, 0, 0, 0};
+	float *w;
+	__m128 p4;
+	__m256 pv, acc, a, b;
+	__m256 r0, r1, r2, r3, t0, t1, t2, t3;
+
+	n = 0;
+
+	if (dim == 1 && stride == 1)
+	{
+		pv = _mm256_set1_ps(p[0]);
+		for (; n + 8 <= num; n += 8)
+		{
+			a = _mm256_sub_ps(pv, _mm256_loadu_ps(slab + n));
+			_mm256_storeu_ps(out + n, _mm256_mul_ps(a, a));
+		}
+	}
+	else if (dim == 2 && stride == 2)
+	{
+		pv = _mm256_setr_ps(p[0], p[1], p[0], p[1], p[0], p[1], p[0], p[1]);
+		for (; n + 8 <= num; n += 8)
+		{
+			w = slab + (n * 2);
+			a = _mm256_sub_ps(pv, _mm256_loadu_ps(w));
+			a = _mm256_mul_ps(a, a);
+			b = _mm256_sub_ps(pv, _mm256_loadu_ps(w + 8));
+			b = _mm256_mul_ps(b, b);
+			/* the shuffles work per lane, so this comes out as neurons
+				0 1 4 5 2 3 6 7 and has to be put back in order */
+			acc = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+			acc = _mm256_add_ps(acc,
+				_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+			acc = _mm256_castpd_ps(_mm256_permute4x64_pd(
+				_mm256_castps_pd(acc), _MM_SHUFFLE(3, 1, 2, 0)));
+			_mm256_storeu_ps(out + n, acc);
+		}
+	}
+	else
+	{
+		full = dim & ~3;
+		rem = dim - full;
+		memcpy(ptail, p + full, sizeof(float) * rem);
+
+		for (; n + 8 <= num; n += 8)
+		{
+			w = slab + (n * stride);
+			acc = _mm256_setzero_ps();
+			for (c = 0; c < dim; c += 4)
+			{
+				p4 = (c < full) ? _mm_loadu_ps(p + c) : _mm_loadu_ps(ptail);
+				pv = _mm256_set_m128(p4, p4);
+
+				/* neuron k in the low lane, neuron k+4 in the high lane */
+				r0 = _mm256_loadu2_m128(w + (4 * stride) + c, w + c);
+				r0 = _mm256_sub_ps(pv, r0);
+				r0 = _mm256_mul_ps(r0, r0);
+				r1 = _mm256_loadu2_m128(w + (5 * stride) + c, w + stride + c);
+				r1 = _mm256_sub_ps(pv, r1);
+				r1 = _mm256_mul_ps(r1, r1);
+				r2 = _mm256_loadu2_m128(w + (6 * stride) + c,
+					w + (2 * stride) + c);
+				r2 = _mm256_sub_ps(pv, r2);
+				r2 = _mm256_mul_ps(r2, r2);
+				r3 = _mm256_loadu2_m128(w + (7 * stride) + c,
+					w + (3 * stride) + c);
+				r3 = _mm256_sub_ps(pv, r3);
+				r3 = _mm256_mul_ps(r3, r3);
+
+				t0 = _mm256_unpacklo_ps(r0, r1);
+				t1 = _mm256_unpacklo_ps(r2, r3);
+				t2 = _mm256_unpackhi_ps(r0, r1);
+				t3 = _mm256_unpackhi_ps(r2, r3);
+
+				acc = _mm256_add_ps(acc,
+					_mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0)));
+				if (c + 1 < dim) {
+					acc = _mm256_add_ps(acc,
+						_mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2)));
+				}
+				if (c + 2 < dim) {
+					acc = _mm256_add_ps(acc,
+						_mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0)));
+				}
+				if (c + 3 < dim) {
+					acc = _mm256_add_ps(acc,
+						_mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2)));
+				}
+			}
+			_mm256_storeu_ps(out + n, acc);
+		}
+	}
+
+	/* gcc doesn't always put this in for me, and without it every bit of
+		plain sse code after this (like most of libm) pays for the dirty
+		upper halves of the registers */
+	_mm256_zeroupper();
+
+	kernel_dist_scalar_from(slab, stride, n, num, dim, p, out);
+}
+
+static void kernel_dist_avx512(float *slab, unsigned int stride,
+	unsigned int num, unsigned short dim, float *p, float *out)
+	__attribute__((target("avx512f,no-fma")));
+
+/* load the same 4 floats out of neurons k, k+4, k+8, and k+12 */
+static inline __m512 kernel_load4x4(float *w, unsigned int stride, int k,
+	int c)
+	__attribute__((target("avx512f,no-fma"), always_inline));
+
+static inline __m512 kernel_load4x4(float *w, unsigned int stride, int k,
+	int c)
+{
+	__m512 v;
+
+	v = _mm512_castps128_ps512(_mm_loadu_ps(w + (k * stride) + c));
+	v = _mm512_insertf32x4(v, _mm_loadu_ps(w + ((k + 4) * stride) + c), 1);
+	v = _mm512_insertf32x4(v, _mm_loadu_ps(w + ((k + 8) * stride) + c), 2);
+	v = _mm512_insertf32x4(v, _mm_loadu_ps(w + ((k + 12) * stride) + c), 3);
+
+	return v;
+}
+
+static void kernel_dist_avx512(float *slab, unsigned int stride,
+	unsigned int num, unsigned short dim, float *p, float *out)
+{
+	unsigned int n;
+	int c, full, rem;
+	float ptail[4] = {0, 0, 0, 0};
+	float *w;
+	__m128 p4;
+	__m512 pv, acc, a, b;
+	__m512 r0, r1, r2, r3, t0, t1, t2, t3;
+	__m512i evens, odds;
+
+	n = 0;
+
+	if (dim == 1 && stride == 1)
+	{
+		pv = _mm512_set1_ps(p[0]);
+		for (; n + 16 <= num; n += 16)
+		{
+			a = _mm512_sub_ps(pv, _mm512_loadu_ps(slab + n));
+			_mm512_storeu_ps(out + n, _mm512_mul_ps(a, a));
+		}
+	}
+	else if (dim == 2 && stride == 2)
+	{
+		pv = _mm512_setr_ps(p[0], p[1], p[0], p[1], p[0], p[1], p[0], p[1],
+			p[0], p[1], p[0], p[1], p[0], p[1], p[0], p[1]);
+		evens = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14,
+			16, 18, 20, 22, 24, 26, 28, 30);
+		odds = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15,
+			17, 19, 21, 23, 25, 27, 29, 31);
+		for (; n + 16 <= num; n += 16)
+		{
+			w = slab + (n * 2);
+			a = _mm512_sub_ps(pv, _mm512_loadu_ps(w));
+			a = _mm512_mul_ps(a, a);
+			b = _mm512_sub_ps(pv, _mm512_loadu_ps(w + 16));
+			b = _mm512_mul_ps(b, b);
+			acc = _mm512_permutex2var_ps(a, evens, b);
+			acc = _mm512_add_ps(acc, _mm512_permutex2var_ps(a, odds, b));
+			_mm512_storeu_ps(out + n, acc);
+		}
+	}
+	else
+	{
+		full = dim & ~3;
+		rem = dim - full;
+		memcpy(ptail, p + full, sizeof(float) * rem);
+
+		for (; n + 16 <= num; n += 16)
+		{
+			w = slab + (n * stride);
+			acc = _mm512_setzero_ps();
+			for (c = 0; c < dim; c += 4)
+			{
+				p4 = (c < full) ? _mm_loadu_ps(p + c) : _mm_loadu_ps(ptail);
+				pv = _mm512_broadcast_f32x4(p4);
+
+				r0 = _mm512_sub_ps(pv, kernel_load4x4(w, stride, 0, c));
+				r0 = _mm512_mul_ps(r0, r0);
+				r1 = _mm512_sub_ps(pv, kernel_load4x4(w, stride, 1, c));
+				r1 = _mm512_mul_ps(r1, r1);
+				r2 = _mm512_sub_ps(pv, kernel_load4x4(w, stride, 2, c));
+				r2 = _mm512_mul_ps(r2, r2);
+				r3 = _mm512_sub_ps(pv, kernel_load4x4(w, stride, 3, c));
+				r3 = _mm512_mul_ps(r3, r3);
+
+				t0 = _mm512_unpacklo_ps(r0, r1);
+				t1 = _mm512_unpacklo_ps(r2, r3);
+				t2 = _mm512_unpackhi_ps(r0, r1);
+				t3 = _mm512_unpackhi_ps(r2, r3);
+
+				acc = _mm512_add_ps(acc,
+					_mm512_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0)));
+				if (c + 1 < dim) {
+					acc = _mm512_add_ps(acc,
+						_mm512_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2)));
+				}
+				if (c + 2 < dim) {
+					acc = _mm512_add_ps(acc,
+						_mm512_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0)));
+				}
+				if (c + 3 < dim) {
+					acc = _mm512_add_ps(acc,
+						_mm512_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2)));
+				}
+			}
+			_mm512_storeu_ps(out + n, acc);
+		}
+	}
+
+	_mm256_zeroupper();
+
+	kernel_dist_scalar_from(slab, stride, n, num, dim, p, out);
+}
+
+#endif
+
+/* Ask the cpu what it can do and pick the widest thing that works, unless
+	the environment says otherwise */
+static void kernel_pick(void)
+{
+	char *want;
+
+	want = getenv("MANIFOLD_KERNEL");
+
+	kernel_dist_impl = kernel_dist_scalar;
+	kernel_impl_name = "scalar";
+
+	if (want != NULL && strcmp(want, "scalar") == 0) {
+		return;
+	}
+
+#ifdef KERNEL_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f") &&
+		(want == NULL || strcmp(want, "avx512") == 0))
+	{
+		kernel_dist_impl = kernel_dist_avx512;
+		kernel_impl_name = "avx512";
+	}
+	else if (__builtin_cpu_supports("avx2") &&
+		(want == NULL || strcmp(want, "avx2") == 0))
+	{
+		kernel_dist_impl = kernel_dist_avx2;
+		kernel_impl_name = "avx2";
+	}
+	else if (__builtin_cpu_supports("sse2") &&
+		(want == NULL || strcmp(want, "sse2") == 0))
+	{
+		kernel_dist_impl = kernel_dist_sse2;
+		kernel_impl_name = "sse2";
+	}
+#endif
+
+	if (want != NULL && strcmp(want, kernel_impl_name) != 0)
+	{
+		printf("kernel_pick(): Can't use MANIFOLD_KERNEL=%s on this cpu, "
+			"using %s instead\n", want, kernel_impl_name);
+	}
+}
+
+void kernel_dist_all(float *slab, unsigned int stride, unsigned int num,
+	unsigned short dim, float *p, float *out)
+{
+	pthread_once(&kernel_once, kernel_pick);
+
+	kernel_dist_impl(slab, stride, num, dim, p, out);
+}
+
+const char* kernel_name(void)
+{
+	pthread_once(&kernel_once, kernel_pick);
+
+	return kernel_impl_name;
+}
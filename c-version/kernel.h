@@ -0,0 +1,33 @@
+#ifndef KERNEL_H
+#define KERNEL_H
+
+/* The distance kernels which find the distance from one input vector to every
+	neuron in a SOM's slab in one go. The best implementation the cpu can run
+	(avx512, avx2, sse2 or plain C) is picked the first time one is used.
+	Anything that isn't x86 always gets the plain C one.
+
+	Every implementation computes the exact same floats as symbol_fdist()
+	does, bit for bit. They get their speed by vectorizing across neurons
+	(each lane of a vector register is a different neuron) and each lane adds
+	up its squared differences in dimension order just like the scalar loop
+	does. This matters since the bmu tie breaking in som.c compares distances
+	with a very tight tolerance and I don't want the answer to depend on what
+	machine I'm running on. */
+
+/* The kernels may read up to this many floats past the end of the last
+	neuron in a slab (the values are ignored), so slabs must be allocated
+	with at least this much padding. */
+#define KERNEL_SLAB_OVERRUN 4
+
+/* For num neurons of dimension dim starting at slab, each stride floats apart,
+	write the squared distance between the neuron and p into out[i]. */
+void kernel_dist_all(float *slab, unsigned int stride, unsigned int num,
+	unsigned short dim, float *p, float *out);
+
+/* Which implementation was picked, "avx512", "avx2", "sse2", or "scalar".
+	Setting the environment variable MANIFOLD_KERNEL to one of those names
+	forces that one (if the cpu can do it), which is how I check they all
+	agree. */
+const char* kernel_name(void);
+
+#endif
@@ -0,0 +1,821 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "manifold.h"
+
+#define BUF_SIZE 2048
+#define NAME_SIZE 256
+
+/* functions to help me read the .lctx file */
+static Lctx* lctx_read_text(char *file);
+static char* read_lctx_line(char *buf, int size, FILE *f, char *desc);
+static char* lowlevel_get_lctx_line(char *buf, int size, FILE *f);
+static void lctx_topology(Lctx *lc, FILE *f);
+static void* lctx_room(void *arr, int *room, int used, int n,
+	unsigned long size);
+static int lctx_name(Lctx *lc, int *room, char *name);
+static void lctx_mojify(char *ctx, char *out);
+
+/* laying out the arrays in one piece */
+static unsigned long lctx_size(LctxHeader *hdr);
+static void lctx_place(Lctx *lc, unsigned char *base);
+static void lctx_pack(Lctx *lc);
+static int lctx_check(Lctx *lc);
+
+static unsigned long long lctx_hash_file(char *file,
+	unsigned long long hash);
+
+Lctx* lctx_read(char *file)
+{
+	Lctx *lc;
+	unsigned int magic = 0;
+	int fd;
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0)
+	{
+		printf ("Could not open cortex file: %s : %d(%s)\n", file, errno,
+			strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	if (readn(fd, &magic, sizeof(unsigned int)) != sizeof(unsigned int)) {
+		magic = 0;
+	}
+	close(fd);
+
+	if (magic != LCTX_MAGIC) {
+		return lctx_read_text(file);
+	}
+
+	lc = lctx_read_binary(file);
+	if (lc == NULL)
+	{
+		printf("lctx_read(): %s is a broken .lctxb!\n", file);
+		exit(EXIT_FAILURE);
+	}
+
+	return lc;
+}
+
+/* There could be some buffer overflows in this code, but feh, I just need
+	it to work in the common cases. Everything goes into arrays of their
+	own first and then gets packed up with the rest once I know how big
+	they all are. */
+static Lctx* lctx_read_text(char *file)
+{
+	Lctx *lc = NULL;
+	FILE *lctx = NULL;
+	char buf[BUF_SIZE] = {'\0'};
+	char name[NAME_SIZE];
+	int i, j, num;
+	int room_slot = 0, room_con = 0, room_obs = 0, room_names = 0;
+	LctxSection *ls;
+	LctxReceptor *lr;
+	LctxEmitter *le;
+	LctxRoot *lt;
+
+	lctx = fopen(file, "r");
+	if (lctx == NULL)
+	{
+		printf ("Could not open cortex file: %s : %d(%s)\n", file, errno,
+			strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	lc = (Lctx*)xmalloc(sizeof(Lctx) * 1);
+	memset(lc, 0, sizeof(Lctx));
+	lc->hdr.magic = LCTX_MAGIC;
+	lc->hdr.version = LCTX_VERSION;
+
+	/* read how many sections I'm going to need */
+	read_lctx_line(buf, BUF_SIZE, lctx, "Number of sections");
+	sscanf(buf, "%d\n", &lc->hdr.num_sec);
+	lc->sections = (LctxSection*)xmalloc(sizeof(LctxSection) *
+		lc->hdr.num_sec);
+
+	/* read the SOM data for each section */
+	for (i = 0; i < lc->hdr.num_sec; i++)
+	{
+		ls = &lc->sections[i];
+
+		read_lctx_line(buf, BUF_SIZE, lctx, "A section");
+		/* older .lctx files don't have the batch size at the end, those
+			sections learn online */
+		if (sscanf(buf, "%d %255s %d %d %d %d %d %d %d %d\n",
+			&ls->serial_id, name, &ls->dim, &ls->x, &ls->y, &ls->rows,
+			&ls->cols, &ls->iter, &ls->prop, &ls->batch) < 10)
+		{
+			ls->batch = 0;
+		}
+		ls->name = lctx_name(lc, &room_names, name);
+	}
+
+	/* read the input channel description */
+	read_lctx_line(buf, BUF_SIZE, lctx, "Number of input channels");
+	sscanf(buf, "%d\n", &lc->hdr.num_input);
+	lc->inputs = (LctxInput*)xmalloc(sizeof(LctxInput) * lc->hdr.num_input);
+
+	for (i = 0; i < lc->hdr.num_input; i++)
+	{
+		read_lctx_line(buf, BUF_SIZE, lctx, "An input channel");
+		sscanf(buf, "%d %255s %d\n", &lc->inputs[i].serial_id, name,
+			&lc->inputs[i].dim);
+		lc->inputs[i].name = lctx_name(lc, &room_names, name);
+	}
+
+	/* read the number of execution serial ids I need to read */
+	read_lctx_line(buf, BUF_SIZE, lctx, "Number of execution serial ids");
+	sscanf(buf, "%d\n", &lc->hdr.num_exec);
+	lc->exec = (int*)xmalloc(sizeof(int) * lc->hdr.num_exec);
+
+	for (i = 0; i < lc->hdr.num_exec; i++)
+	{
+		read_lctx_line(buf, BUF_SIZE, lctx, "Execution serial id");
+		sscanf(buf, "%d\n", &lc->exec[i]);
+	}
+
+	/* now read how many sections there are which need to have their
+		receptors set up, and then each one's slots */
+	read_lctx_line(buf, BUF_SIZE, lctx, "Number of sections needing receptors");
+	sscanf(buf, "%d\n", &lc->hdr.num_receptor);
+	lc->receptors = (LctxReceptor*)xmalloc(sizeof(LctxReceptor) *
+		lc->hdr.num_receptor);
+
+	for (i = 0; i < lc->hdr.num_receptor; i++)
+	{
+		lr = &lc->receptors[i];
+
+		read_lctx_line(buf, BUF_SIZE, lctx, "Recepting serial id");
+		sscanf(buf, "%d\n", &lr->serial_id);
+		read_lctx_line(buf, BUF_SIZE, lctx, "Number of receptor slots");
+		sscanf(buf, "%d\n", &lr->num);
+
+		lr->first = lc->hdr.num_slot;
+		num = lc->hdr.num_slot + lr->num;
+		lc->slots = (LctxSlot*)lctx_room(lc->slots, &room_slot,
+			lc->hdr.num_slot, num, sizeof(LctxSlot));
+
+		for (j = lr->first; j < num; j++)
+		{
+			read_lctx_line(buf, BUF_SIZE, lctx, "Slot info");
+			sscanf(buf, "%d %d %d\n", &lc->slots[j].slot,
+				&lc->slots[j].int_num, &lc->slots[j].slice_num);
+		}
+		lc->hdr.num_slot = num;
+	}
+
+	/* Now read the number of sections/inputs which are emitters and the
+		connection information that goes with each one of them */
+	read_lctx_line(buf, BUF_SIZE, lctx, "Number of emitter/inputs");
+	sscanf(buf, "%d\n", &lc->hdr.num_emitter);
+	lc->emitters = (LctxEmitter*)xmalloc(sizeof(LctxEmitter) *
+		lc->hdr.num_emitter);
+
+	for (i = 0; i < lc->hdr.num_emitter; i++)
+	{
+		le = &lc->emitters[i];
+
+		read_lctx_line(buf, BUF_SIZE, lctx, "Emitter/input serial id");
+		sscanf(buf, "%d\n", &le->serial_id);
+		read_lctx_line(buf, BUF_SIZE, lctx, "Number of connection slots");
+		sscanf(buf, "%d\n", &le->num);
+
+		le->first = lc->hdr.num_con;
+		num = lc->hdr.num_con + le->num;
+		lc->cons = (LctxConnection*)lctx_room(lc->cons, &room_con,
+			lc->hdr.num_con, num, sizeof(LctxConnection));
+
+		for (j = le->first; j < num; j++)
+		{
+			read_lctx_line(buf, BUF_SIZE, lctx, "A connection slot");
+			sscanf(buf, "%d %d\n", &lc->cons[j].acceptor_id,
+				&lc->cons[j].slot);
+		}
+		lc->hdr.num_con = num;
+	}
+
+	/* read the pre-calculated reverse lookup observation tables for each
+		lookupable section */
+	read_lctx_line(buf, BUF_SIZE, lctx, "Number of root nodes in obtable");
+	sscanf(buf, "%d\n", &lc->hdr.num_root);
+	lc->roots = (LctxRoot*)xmalloc(sizeof(LctxRoot) * lc->hdr.num_root);
+
+	for (i = 0; i < lc->hdr.num_root; i++)
+	{
+		lt = &lc->roots[i];
+
+		read_lctx_line(buf, BUF_SIZE, lctx, "A root node in the obtable");
+		sscanf(buf, "%d\n", &lt->serial_id);
+		read_lctx_line(buf, BUF_SIZE, lctx, "Num of observations for a root");
+		sscanf(buf, "%d\n", &lt->num);
+
+		lt->first = lc->hdr.num_obs;
+		num = lc->hdr.num_obs + lt->num;
+		lc->obs = (LctxObservation*)lctx_room(lc->obs, &room_obs,
+			lc->hdr.num_obs, num, sizeof(LctxObservation));
+
+		for (j = lt->first; j < num; j++)
+		{
+			read_lctx_line(buf, BUF_SIZE, lctx, "An observation");
+			sscanf(buf, "%d %d\n", &lc->obs[j].serial_id, &lc->obs[j].obs);
+		}
+		lc->hdr.num_obs = num;
+	}
+
+	/* read the output channel identification/ordering table */
+	read_lctx_line(buf, BUF_SIZE, lctx, "Number of Output Channels");
+	sscanf(buf, "%d\n", &lc->hdr.num_outchan);
+	lc->outchans = (LctxOutchan*)xmalloc(sizeof(LctxOutchan) *
+		lc->hdr.num_outchan);
+
+	for (i = 0; i < lc->hdr.num_outchan; i++)
+	{
+		read_lctx_line(buf, BUF_SIZE, lctx, "An output channel");
+		sscanf(buf, "%d %255s\n", &lc->outchans[i].serial_id, name);
+		lc->outchans[i].name = lctx_name(lc, &room_names, name);
+	}
+
+	/* read the section to output_channel mapping table */
+	read_lctx_line(buf, BUF_SIZE, lctx, "Number of Output Channel Maps");
+	sscanf(buf, "%d\n", &lc->hdr.num_outmap);
+	lc->outmaps = (LctxOutmap*)xmalloc(sizeof(LctxOutmap) *
+		lc->hdr.num_outmap);
+
+	for (i = 0; i < lc->hdr.num_outmap; i++)
+	{
+		read_lctx_line(buf, BUF_SIZE, lctx, "An output channel map");
+		sscanf(buf, "%d %d\n", &lc->outmaps[i].sec_id,
+			&lc->outmaps[i].ochan_id);
+	}
+
+	lctx_topology(lc, lctx);
+	fclose(lctx);
+
+	lctx_pack(lc);
+
+	return lc;
+}
+
+Lctx* lctx_read_binary(char *file)
+{
+	Lctx *lc;
+	struct stat st;
+	unsigned long body;
+	int fd;
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0)
+	{
+		printf("lctx_read_binary(): Couldn't open %s: %d(%s)\n", file,
+			errno, strerror(errno));
+		return NULL;
+	}
+
+	lc = (Lctx*)xmalloc(sizeof(Lctx) * 1);
+	lc->buf = NULL;
+
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(LctxHeader) ||
+		readn(fd, &lc->hdr, sizeof(LctxHeader)) != sizeof(LctxHeader) ||
+		lc->hdr.magic != LCTX_MAGIC || lc->hdr.version != LCTX_VERSION ||
+		lc->hdr.file_size != (unsigned long)st.st_size)
+	{
+		close(fd);
+		lctx_free(lc);
+		return NULL;
+	}
+
+	/* the counts have to be sane before I add them all up */
+	body = lctx_size(&lc->hdr);
+	if (body == 0 || sizeof(LctxHeader) + body != lc->hdr.file_size)
+	{
+		close(fd);
+		lctx_free(lc);
+		return NULL;
+	}
+
+	lc->buf = xmalloc(body);
+	if (readn(fd, lc->buf, body) != (ssize_t)body ||
+		hash_fnv1a(lc->buf, body, HASH_FNV1A_INIT) != lc->hdr.body_hash)
+	{
+		close(fd);
+		lctx_free(lc);
+		return NULL;
+	}
+	close(fd);
+
+	lctx_place(lc, (unsigned char*)lc->buf);
+
+	if (lctx_check(lc) == FALSE)
+	{
+		lctx_free(lc);
+		return NULL;
+	}
+
+	return lc;
+}
+
+void lctx_write(Lctx *lc, char *file)
+{
+	unsigned long body;
+	char *tmp;
+	int fd;
+
+	/* the pid keeps two processes filling the cache at once from writing
+		into the same temporary file */
+	tmp = (char*)xmalloc(strlen(file) + 32);
+	sprintf(tmp, "%s.%d.tmp", file, (int)getpid());
+
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		printf("lctx_write(): Couldn't open %s: %d(%s)\n", tmp, errno,
+			strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	body = lc->hdr.file_size - sizeof(LctxHeader);
+	if (writen(fd, &lc->hdr, sizeof(LctxHeader)) !=
+			(ssize_t)sizeof(LctxHeader) ||
+		writen(fd, lc->buf, body) != (ssize_t)body || close(fd) < 0)
+	{
+		printf("lctx_write(): Couldn't write %s: %d(%s)\n", tmp, errno,
+			strerror(errno));
+		unlink(tmp);
+		exit(EXIT_FAILURE);
+	}
+
+	if (rename(tmp, file) < 0)
+	{
+		printf("lctx_write(): Couldn't rename %s to %s: %d(%s)\n", tmp,
+			file, errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	free(tmp);
+}
+
+Lctx* lctx_compile(char *ctx)
+{
+	char file[PATH_MAX], tmp[PATH_MAX];
+	unsigned long long hash;
+	char *dir;
+	Lctx *lc;
+
+	hash = lctx_hash_file(ctx, HASH_FNV1A_INIT);
+	hash = lctx_hash_file(LCTX_MOJIFY, hash);
+
+	dir = getenv("MANIFOLD_LCTX_CACHE");
+	if (dir == NULL || dir[0] == '\0') {
+		dir = LCTX_CACHE_DIR;
+	}
+	if (snprintf(file, PATH_MAX, "%s/%016llx.lctxb", dir, hash) >=
+		PATH_MAX)
+	{
+		printf("lctx_compile(): %s is too long!\n", dir);
+		exit(EXIT_FAILURE);
+	}
+
+	/* if the last one got mangled somehow, it just gets made again */
+	if (access(file, R_OK) == 0)
+	{
+		lc = lctx_read_binary(file);
+		if (lc != NULL && lc->hdr.source_hash == hash) {
+			return lc;
+		}
+		if (lc != NULL) {
+			lctx_free(lc);
+		}
+		printf("lctx_compile(): %s is no good, making it again.\n", file);
+	}
+
+	if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+	{
+		printf("lctx_compile(): Couldn't make %s: %d(%s)\n", dir, errno,
+			strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	/* the pid keeps two of these at once out of each other's way */
+	snprintf(tmp, PATH_MAX, "%s/%016llx.%d.lctx", dir, hash, (int)getpid());
+	lctx_mojify(ctx, tmp);
+
+	lc = lctx_read_text(tmp);
+	unlink(tmp);
+
+	lc->hdr.source_hash = hash;
+	lctx_write(lc, file);
+
+	return lc;
+}
+
+void lctx_free(Lctx *lc)
+{
+	if (lc == NULL) {
+		return;
+	}
+
+	free(lc->buf);
+	free(lc);
+}
+
+/* ------------------------------------------------------------------------ */
+
+/* Run mojify on ctx to make out. No shell is involved, so whatever is in
+	the names goes to mojify as is. */
+static void lctx_mojify(char *ctx, char *out)
+{
+	char *argv[4];
+	pid_t pid;
+	int status;
+
+	argv[0] = LCTX_MOJIFY;
+	argv[1] = ctx;
+	argv[2] = out;
+	argv[3] = NULL;
+
+	/* or the child would print it again */
+	fflush(stdout);
+	fflush(stderr);
+
+	pid = fork();
+	if (pid < 0)
+	{
+		printf("lctx_mojify(): Couldn't fork: %d(%s)\n", errno,
+			strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	if (pid == 0)
+	{
+		execv(LCTX_MOJIFY, argv);
+		printf("lctx_mojify(): Couldn't run %s: %d(%s)\n", LCTX_MOJIFY,
+			errno, strerror(errno));
+		fflush(stdout);
+		_exit(EXIT_FAILURE);
+	}
+
+	while(waitpid(pid, &status, 0) < 0 && errno == EINTR)
+	{
+		;
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+	{
+		printf("Problem running mojify on %s!\n", ctx);
+		unlink(out);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/* How many bytes everything after the header takes up, or 0 if the counts
+	in it are nonsense. */
+static unsigned long lctx_size(LctxHeader *hdr)
+{
+	unsigned long size = 0;
+
+	if (hdr->num_sec < 0 || hdr->num_input < 0 || hdr->num_exec < 0 ||
+		hdr->num_receptor < 0 || hdr->num_slot < 0 ||
+		hdr->num_emitter < 0 || hdr->num_con < 0 || hdr->num_root < 0 ||
+		hdr->num_obs < 0 || hdr->num_outchan < 0 || hdr->num_outmap < 0 ||
+		hdr->names_len > UINT_MAX || hdr->topology_len > UINT_MAX)
+	{
+		return 0;
+	}
+
+	size += sizeof(LctxSection) * (unsigned long)hdr->num_sec;
+	size += sizeof(LctxInput) * (unsigned long)hdr->num_input;
+	size += sizeof(int) * (unsigned long)hdr->num_exec;
+	size += sizeof(LctxReceptor) * (unsigned long)hdr->num_receptor;
+	size += sizeof(LctxSlot) * (unsigned long)hdr->num_slot;
+	size += sizeof(LctxEmitter) * (unsigned long)hdr->num_emitter;
+	size += sizeof(LctxConnection) * (unsigned long)hdr->num_con;
+	size += sizeof(LctxRoot) * (unsigned long)hdr->num_root;
+	size += sizeof(LctxObservation) * (unsigned long)hdr->num_obs;
+	size += sizeof(LctxOutchan) * (unsigned long)hdr->num_outchan;
+	size += sizeof(LctxOutmap) * (unsigned long)hdr->num_outmap;
+	size += hdr->names_len;
+	size += hdr->topology_len + 1;
+
+	return size;
+}
+
+/* point the arrays at where they are in base, all of them are ints so
+	they line up without any padding */
+static void lctx_place(Lctx *lc, unsigned char *base)
+{
+	LctxHeader *hdr = &lc->hdr;
+
+	lc->sections = (LctxSection*)base;
+	base += sizeof(LctxSection) * (unsigned long)hdr->num_sec;
+	lc->inputs = (LctxInput*)base;
+	base += sizeof(LctxInput) * (unsigned long)hdr->num_input;
+	lc->exec = (int*)base;
+	base += sizeof(int) * (unsigned long)hdr->num_exec;
+	lc->receptors = (LctxReceptor*)base;
+	base += sizeof(LctxReceptor) * (unsigned long)hdr->num_receptor;
+	lc->slots = (LctxSlot*)base;
+	base += sizeof(LctxSlot) * (unsigned long)hdr->num_slot;
+	lc->emitters = (LctxEmitter*)base;
+	base += sizeof(LctxEmitter) * (unsigned long)hdr->num_emitter;
+	lc->cons = (LctxConnection*)base;
+	base += sizeof(LctxConnection) * (unsigned long)hdr->num_con;
+	lc->roots = (LctxRoot*)base;
+	base += sizeof(LctxRoot) * (unsigned long)hdr->num_root;
+	lc->obs = (LctxObservation*)base;
+	base += sizeof(LctxObservation) * (unsigned long)hdr->num_obs;
+	lc->outchans = (LctxOutchan*)base;
+	base += sizeof(LctxOutchan) * (unsigned long)hdr->num_outchan;
+	lc->outmaps = (LctxOutmap*)base;
+	base += sizeof(LctxOutmap) * (unsigned long)hdr->num_outmap;
+	lc->names = (char*)base;
+	base += hdr->names_len;
+	lc->topology = (char*)base;
+}
+
+/* move the separate arrays the text parser made into one buffer laid out
+	just like the .lctxb */
+static void lctx_pack(Lctx *lc)
+{
+	Lctx old = *lc;
+	LctxHeader *hdr = &lc->hdr;
+	unsigned long body;
+
+	body = lctx_size(hdr);
+	hdr->file_size = sizeof(LctxHeader) + body;
+
+	/* the gaps, if any, are zeros so the same .lctx always makes the same
+		.lctxb */
+	lc->buf = xmalloc(body);
+	memset(lc->buf, 0, body);
+	lctx_place(lc, (unsigned char*)lc->buf);
+
+	memcpy(lc->sections, old.sections,
+		sizeof(LctxSection) * hdr->num_sec);
+	memcpy(lc->inputs, old.inputs, sizeof(LctxInput) * hdr->num_input);
+	memcpy(lc->exec, old.exec, sizeof(int) * hdr->num_exec);
+	memcpy(lc->receptors, old.receptors,
+		sizeof(LctxReceptor) * hdr->num_receptor);
+	memcpy(lc->slots, old.slots, sizeof(LctxSlot) * hdr->num_slot);
+	memcpy(lc->emitters, old.emitters,
+		sizeof(LctxEmitter) * hdr->num_emitter);
+	memcpy(lc->cons, old.cons, sizeof(LctxConnection) * hdr->num_con);
+	memcpy(lc->roots, old.roots, sizeof(LctxRoot) * hdr->num_root);
+	memcpy(lc->obs, old.obs, sizeof(LctxObservation) * hdr->num_obs);
+	memcpy(lc->outchans, old.outchans,
+		sizeof(LctxOutchan) * hdr->num_outchan);
+	memcpy(lc->outmaps, old.outmaps, sizeof(LctxOutmap) * hdr->num_outmap);
+	memcpy(lc->names, old.names, hdr->names_len);
+	memcpy(lc->topology, old.topology, hdr->topology_len + 1);
+
+	free(old.sections);
+	free(old.inputs);
+	free(old.exec);
+	free(old.receptors);
+	free(old.slots);
+	free(old.emitters);
+	free(old.cons);
+	free(old.roots);
+	free(old.obs);
+	free(old.outchans);
+	free(old.outmaps);
+	free(old.names);
+	free(old.topology);
+
+	hdr->body_hash = hash_fnv1a(lc->buf, body, HASH_FNV1A_INIT);
+}
+
+/* Make sure nothing in a .lctxb points outside of it. Whether the serial
+	ids make a cortex that makes sense is up to cortex_init(), the same as
+	for a .lctx. */
+static int lctx_check(Lctx *lc)
+{
+	LctxHeader *hdr = &lc->hdr;
+	LctxReceptor *lr;
+	int i, j;
+
+	if ((hdr->names_len > 0 && lc->names[hdr->names_len - 1] != '\0') ||
+		lc->topology[hdr->topology_len] != '\0')
+	{
+		return FALSE;
+	}
+
+	for (i = 0; i < hdr->num_sec; i++) {
+		if (lc->sections[i].name < 0 ||
+			(unsigned long)lc->sections[i].name >= hdr->names_len)
+		{
+			return FALSE;
+		}
+	}
+	for (i = 0; i < hdr->num_input; i++) {
+		if (lc->inputs[i].name < 0 ||
+			(unsigned long)lc->inputs[i].name >= hdr->names_len)
+		{
+			return FALSE;
+		}
+	}
+	for (i = 0; i < hdr->num_outchan; i++) {
+		if (lc->outchans[i].name < 0 ||
+			(unsigned long)lc->outchans[i].name >= hdr->names_len)
+		{
+			return FALSE;
+		}
+	}
+
+	for (i = 0; i < hdr->num_receptor; i++) {
+		if (lc->receptors[i].first < 0 || lc->receptors[i].num < 0 ||
+			lc->receptors[i].first > hdr->num_slot - lc->receptors[i].num)
+		{
+			return FALSE;
+		}
+	}
+	for (i = 0; i < hdr->num_emitter; i++) {
+		if (lc->emitters[i].first < 0 || lc->emitters[i].num < 0 ||
+			lc->emitters[i].first > hdr->num_con - lc->emitters[i].num)
+		{
+			return FALSE;
+		}
+	}
+	for (i = 0; i < hdr->num_root; i++) {
+		if (lc->roots[i].first < 0 || lc->roots[i].num < 0 ||
+			lc->roots[i].first > hdr->num_obs - lc->roots[i].num)
+		{
+			return FALSE;
+		}
+	}
+
+	/* and the slots have to fit in the receptor they are in */
+	for (i = 0; i < hdr->num_receptor; i++) {
+		lr = &lc->receptors[i];
+		for (j = lr->first; j < lr->first + lr->num; j++) {
+			if (lc->slots[j].slot < 0 || lc->slots[j].slot >= lr->num) {
+				return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+/* make room for n things of size in arr, which has room for *room of them
+	and is using the first used of those */
+static void* lctx_room(void *arr, int *room, int used, int n,
+	unsigned long size)
+{
+	void *bigger;
+
+	if (n <= *room) {
+		return arr;
+	}
+
+	while(*room < n) {
+		*room = *room == 0 ? 64 : *room * 2;
+	}
+	bigger = xmalloc(size * *room);
+	if (arr != NULL) {
+		memcpy(bigger, arr, size * used);
+		free(arr);
+	}
+
+	return bigger;
+}
+
+/* tack name onto the end of the names and return where it starts */
+static int lctx_name(Lctx *lc, int *room, char *name)
+{
+	int start = (int)lc->hdr.names_len;
+	int len = strlen(name) + 1;
+
+	lc->names = (char*)lctx_room(lc->names, room, start, start + len, 1);
+	memcpy(lc->names + start, name, len);
+	lc->hdr.names_len += len;
+
+	return start;
+}
+
+/* hash the contents of file onto the end of hash */
+static unsigned long long lctx_hash_file(char *file,
+	unsigned long long hash)
+{
+	char buf[BUF_SIZE * 4];
+	ssize_t n;
+	int fd;
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0)
+	{
+		printf("lctx_compile(): Couldn't open %s: %d(%s)\n", file, errno,
+			strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	while((n = read(fd, buf, sizeof(buf))) > 0) {
+		hash = hash_fnv1a(buf, n, hash);
+	}
+	if (n < 0)
+	{
+		printf("lctx_compile(): Couldn't read %s: %d(%s)\n", file, errno,
+			strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	close(fd);
+
+	return hash;
+}
+
+/* ------------------------------------------------------------------------ */
+/* some file parsing helper functions */
+
+static char* read_lctx_line(char *buf, int size, FILE *f, char *desc)
+{
+	char *ptr = NULL;
+
+	if ((ptr = lowlevel_get_lctx_line(buf, size, f)) == NULL) {
+		printf("cortex_init(): Short read while reading: %s\n", desc);
+		exit(EXIT_FAILURE);
+	}
+
+/*	printf("READ(%s): %s", desc, ptr);*/
+
+	return ptr;
+}
+
+/* Go back through the .lctx file and keep just what was read out of it,
+	each line trimmed, so reformatting or commenting the file doesn't
+	change the hash */
+static void lctx_topology(Lctx *lc, FILE *f)
+{
+	char buf[BUF_SIZE];
+	char *start, *end, *text;
+	unsigned long room = BUF_SIZE;
+	unsigned long len = 0;
+
+	lc->topology = (char*)xmalloc(room);
+
+	rewind(f);
+	while(lowlevel_get_lctx_line(buf, BUF_SIZE, f) != NULL)
+	{
+		start = buf;
+		while(*start == ' ' || *start == '\t') {
+			start++;
+		}
+		end = start + strlen(start);
+		while(end > start && (end[-1] == ' ' || end[-1] == '\t' ||
+			end[-1] == '\n' || end[-1] == '\r'))
+		{
+			end--;
+		}
+
+		if (len + (end - start) + 2 > room)
+		{
+			room *= 2;
+			text = (char*)xmalloc(room);
+			memcpy(text, lc->topology, len);
+			free(lc->topology);
+			lc->topology = text;
+		}
+		memcpy(lc->topology + len, start, end - start);
+		len += end - start;
+		lc->topology[len++] = '\n';
+	}
+	lc->topology[len] = '\0';
+
+	lc->hdr.topology_len = len;
+	lc->hdr.topology_hash = hash_fnv1a(lc->topology, len, HASH_FNV1A_INIT);
+}
+
+/* Return a line which is not a comment/whitespace line */
+static char* lowlevel_get_lctx_line(char *buf, int size, FILE *f)
+{
+	int meat;
+	char *str;
+	char *ptr;
+
+	do {
+		/* assume I'm going to read something valid at first */
+		meat = TRUE;
+
+		str = fgets(buf, size, f);
+
+		/* check for end of input */
+		if (str == NULL) {
+			return NULL;
+		}
+
+		/* check to see if it isn't a comment/whitespace line */
+		ptr = str;
+		while(*ptr == ' ' || *ptr == '\t' || *ptr == '\n') {
+			ptr++;
+		}
+		if (*ptr == '#' || *ptr == '\0') {
+			/* this is a comment, or line of whitespace */
+			meat = FALSE;
+		}
+
+	} while(meat == FALSE);
+
+	return buf;
+}
@@ -0,0 +1,196 @@
+#ifndef LCTX_H
+#define LCTX_H
+
+/* A cortex description, everything cortex_init() reads out of a .lctx, as
+	flat arrays of ints which point into each other by index. The text
+	.lctx is parsed into one of these, and so is the binary .lctxb, which
+	is nothing but this struct written out in one piece:
+
+		an LctxHeader
+		sections[num_sec]		LctxSection
+		inputs[num_input]		LctxInput
+		exec[num_exec]			int
+		receptors[num_receptor]	LctxReceptor, its slots are slots[first...]
+		slots[num_slot]			LctxSlot
+		emitters[num_emitter]	LctxEmitter, its cons are cons[first...]
+		cons[num_con]			LctxConnection
+		roots[num_root]			LctxRoot, its obs are obs[first...]
+		obs[num_obs]			LctxObservation
+		outchans[num_outchan]	LctxOutchan
+		outmaps[num_outmap]		LctxOutmap
+		names[names_len]		the names, each ending in a '\0'
+		topology[topology_len]	see core->topology, and a '\0'
+
+	Reading one back is a read() and fixing up the pointers, no sscanf()
+	and no looking for comments. Like the rest of the binary files, it is
+	in the byte order of the machine that wrote it.
+
+	Handing cortex_init() a .ctx makes mojify write the .lctx and then
+	keeps the .lctxb of it in the cache directory, named after the hash of
+	the .ctx and of mojify itself, so the next time that .ctx comes along
+	neither mojify nor the parsing has to happen. Changing either one at
+	all changes the hash, and the stale .lctxb is just never looked at
+	again. */
+
+#define LCTX_MAGIC 0x4258434c /* "LCXB" */
+#define LCTX_VERSION 1
+
+/* where the .lctxb of each .ctx goes, MANIFOLD_LCTX_CACHE says otherwise */
+#define LCTX_CACHE_DIR ".lctxb-cache"
+
+/* the compiler that turns a .ctx into a .lctx */
+#define LCTX_MOJIFY "./mojify"
+
+typedef struct LctxHeader_s
+{
+	unsigned int magic;
+	unsigned int version;
+
+	/* hash_fnv1a() of the .ctx this came from followed by the mojify that
+		compiled it, 0 if it was just a .lctx */
+	unsigned long long source_hash;
+
+	/* same as core->topology_hash */
+	unsigned long long topology_hash;
+
+	int num_sec;
+	int num_input;
+	int num_exec;
+	int num_receptor;
+	int num_slot;
+	int num_emitter;
+	int num_con;
+	int num_root;
+	int num_obs;
+	int num_outchan;
+	int num_outmap;
+	int pad;
+
+	unsigned long names_len;
+	unsigned long topology_len;
+
+	/* how big the whole .lctxb is, and the hash_fnv1a() of everything
+		after this header, so a mangled one doesn't turn into a strange
+		cortex */
+	unsigned long file_size;
+	unsigned long long body_hash;
+
+} LctxHeader;
+
+typedef struct LctxSection_s
+{
+	int serial_id;
+	/* where the name starts in names */
+	int name;
+	int dim;
+	int x;
+	int y;
+	int rows;
+	int cols;
+	int iter;
+	int prop;
+	int batch;
+} LctxSection;
+
+typedef struct LctxInput_s
+{
+	int serial_id;
+	int name;
+	int dim;
+} LctxInput;
+
+typedef struct LctxReceptor_s
+{
+	int serial_id;
+	int first;
+	int num;
+} LctxReceptor;
+
+typedef struct LctxSlot_s
+{
+	int slot;
+	int int_num;
+	int slice_num;
+} LctxSlot;
+
+typedef struct LctxEmitter_s
+{
+	int serial_id;
+	int first;
+	int num;
+} LctxEmitter;
+
+typedef struct LctxConnection_s
+{
+	int acceptor_id;
+	int slot;
+} LctxConnection;
+
+typedef struct LctxRoot_s
+{
+	int serial_id;
+	int first;
+	int num;
+} LctxRoot;
+
+typedef struct LctxObservation_s
+{
+	int serial_id;
+	int obs;
+} LctxObservation;
+
+typedef struct LctxOutchan_s
+{
+	int serial_id;
+	int name;
+} LctxOutchan;
+
+typedef struct LctxOutmap_s
+{
+	int sec_id;
+	int ochan_id;
+} LctxOutmap;
+
+typedef struct Lctx_s
+{
+	LctxHeader hdr;
+
+	LctxSection *sections;
+	LctxInput *inputs;
+	int *exec;
+	LctxReceptor *receptors;
+	LctxSlot *slots;
+	LctxEmitter *emitters;
+	LctxConnection *cons;
+	LctxRoot *roots;
+	LctxObservation *obs;
+	LctxOutchan *outchans;
+	LctxOutmap *outmaps;
+	char *names;
+	char *topology;
+
+	/* everything above is in here */
+	void *buf;
+
+} Lctx;
+
+/* Read a .lctx or a .lctxb, whichever the file turns out to be. */
+Lctx* lctx_read(char *file);
+
+/* Get the description of a .ctx out of the cache, or mojify it and put it
+	there if it isn't. */
+Lctx* lctx_compile(char *ctx);
+
+/* Write out the .lctxb form. */
+void lctx_write(Lctx *lc, char *file);
+
+void lctx_free(Lctx *lc);
+
+/* BEGIN private stuff */
+
+/* Read a .lctxb, returns NULL if it isn't one or is broken somehow. */
+Lctx* lctx_read_binary(char *file);
+
+/* END private stuff */
+
+#endif
@@ -301,6 +301,8 @@ void test_intqueue(void)
 
 		intqueue_enqueue(iq, sym);
 		intqueue_stdout(iq);
+
+		symbol_free(sym);
 	}
 
 	intqueue_free(iq);
@@ -334,6 +336,9 @@ void test_cortex_ascii(char *filename)
 	core = cortex_init(filename);
 /*	cortex_stdout(core);*/
 
+	/* show the ties the bmu searches run into */
+	cortex_set_trace(core, TRUE);
+
 	now = SDL_GetTicks();
 	sample = now + incr;
 	i = 0;
@@ -344,7 +349,8 @@ void test_cortex_ascii(char *filename)
 /*		channels[0] = symbol_copy(input_random_choice_special(inp,2));*/
 
 		/* make the cortex learn it */
-		cortex_process(core, channels, num_channels, CORTEX_REQUEST_LEARN);
+		cortex_output_table_free(
+			cortex_process(core, channels, num_channels, CORTEX_REQUEST_LEARN));
 
 		
 		/* figure out what to do, if anything */
@@ -477,8 +483,12 @@ void test_cortex_vision(char *filename)
 
 	vinp = vinput_init(16, 16, 16, 16);
 	core = cortex_init(filename);
+	ctxout = cortex_output_table_init_reusable(core);
 /*	cortex_stdout(core);*/
 
+	/* show the ties the bmu searches run into */
+	cortex_set_trace(core, TRUE);
+
 	now = SDL_GetTicks();
 	sample = now - 1; /* draw one frame immediately */
 	i = 0;
@@ -504,9 +514,10 @@ void test_cortex_vision(char *filename)
 /*		vinput_corrupt(vinp, channels, 1, 1, 1, VINPUT_RANGE_RANDOM);*/
 		vinput_draw_glyph(vinp, channels, 400, 300);
 
-		/* make the cortex learn it */
-		ctxout = 
-			cortex_process(core, channels, num_channels, CORTEX_REQUEST_LEARN);
+		/* make the cortex learn it, the answer goes in the same table every
+			time */
+		cortex_process_into(core, channels, num_channels, 
+			CORTEX_REQUEST_LEARN, ctxout);
 
 /*		cortex_output_table_stdout(ctxout);*/
 		
@@ -569,12 +580,6 @@ void test_cortex_vision(char *filename)
 			iter = 0;
 		}
 
-		/* get rid of the cortex output table */
-		if (ctxout != NULL) {
-			cortex_output_table_free(ctxout);
-			ctxout = NULL;
-		}
-
 		now = SDL_GetTicks();
 
 		if (now > sample) {
@@ -588,6 +593,7 @@ void test_cortex_vision(char *filename)
 		iter++;
 	}
 
+	cortex_output_table_free(ctxout);
 	cortex_free(core);
 	vinput_destroy(vinp);
 }
@@ -603,7 +609,6 @@ int main(int argc, char **argv)
 
 /* The #if 0 in this function are for the vision cortex behavior */
 #if defined(VISION_DEMO)
-	char buf[2048];
 	char filename[2048];
 #endif
 
@@ -611,20 +616,13 @@ int main(int argc, char **argv)
 	height = HEIGHT;
 
 #if defined(VISION_DEMO)
-	/* call mojify on the cortex file */
-	if (argc == 2) {
-		sprintf(buf, "./mojify %s", argv[1]);
-		if (system(buf) != 0)
-		{
-			printf("Problem running mojify...%d(%s)\n", errno, strerror(errno));
-			exit(EXIT_FAILURE);
-		}
-	} else {
+	/* cortex_init() mojifies the cortex file, or finds it in the cache */
+	if (argc != 2) {
 		printf("Supply a file please\n");
 		exit(EXIT_FAILURE);
 	}
 
-	sprintf(filename, "a.lctx");
+	sprintf(filename, "%s", argv[1]);
 #endif
 
 	setup_opengl(width, height);
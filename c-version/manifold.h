@@ -0,0 +1,35 @@
+#ifndef MANIFOLD_H
+#define MANIFOLD_H
+
+/* The public header of libmanifold, the SOM and cortex engine without any
+	of the display or demo code. Include this and link with -lmanifold -lm
+	-lpthread. Nothing in here needs SDL, OpenGL, or X. */
+
+enum {
+	FALSE = 0,
+	TRUE = 1
+};
+
+enum
+{
+	/* often used for describing whether or not I found something in an array */
+	NOT_FOUND = -1
+};
+
+#include "utils.h"
+#include "kernel.h"
+#include "pool.h"
+#include "symbol.h"
+#include "wire.h"
+#include "slq.h"
+#include "som.h"
+#include "input.h"
+#include "intqueue.h"
+#include "lctx.h"
+#include "cortex.h"
+#include "agent.h"
+#include "checkpoint.h"
+#include "reverse.h"
+#include "conv.h"
+
+#endif
@@ -0,0 +1,360 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include "manifold.h"
+
+static void* pool_worker(void *vpool);
+static void pool_do_tasks(Pool *pool);
+static void pool_do_graph(Pool *pool, int id);
+static void pool_deque_push(PoolDeque *dq, int task);
+static int pool_deque_pop(PoolDeque *dq);
+static int pool_deque_steal(PoolDeque *dq);
+
+Pool* pool_init(int num_threads)
+{
+	Pool *pool;
+	int i;
+	int ret;
+
+	if (num_threads <= 0 && getenv("MANIFOLD_THREADS") != NULL) {
+		num_threads = atoi(getenv("MANIFOLD_THREADS"));
+	}
+	if (num_threads <= 0) {
+		num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+		if (num_threads <= 0) {
+			num_threads = 1;
+		}
+	}
+
+	pool = (Pool*)xmalloc(sizeof(Pool) * 1);
+
+	pool->num_threads = num_threads;
+	pool->generation = 0;
+	pool->shutdown = FALSE;
+	pool->busy = 0;
+	pool->func = NULL;
+	pool->arg = NULL;
+	pool->num_tasks = 0;
+	pool->next_task = 0;
+
+	pool->graph = NULL;
+	pool->pending = NULL;
+	pool->remaining = 0;
+	pool->graph_room = 0;
+	pool->next_id = 0;
+	pool->deque = (PoolDeque*)xmalloc(sizeof(PoolDeque) * pool->num_threads);
+	for (i = 0; i < pool->num_threads; i++)
+	{
+		pthread_mutex_init(&pool->deque[i].lock, NULL);
+		pool->deque[i].task = NULL;
+		pool->deque[i].top = 0;
+		pool->deque[i].bottom = 0;
+	}
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->go, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	/* the caller of pool_run() is one of the threads, so make one less */
+	pool->workers =
+		(pthread_t*)xmalloc(sizeof(pthread_t) * (pool->num_threads));
+	for (i = 0; i < pool->num_threads - 1; i++)
+	{
+		ret = pthread_create(&pool->workers[i], NULL, pool_worker, pool);
+		if (ret != 0)
+		{
+			printf("pool_init(): Couldn't make worker %d: %s\n", i,
+				strerror(ret));
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	return pool;
+}
+
+/* grab task numbers until there aren't any left */
+static void pool_do_tasks(Pool *pool)
+{
+	int task;
+
+	while((task = __sync_fetch_and_add(&pool->next_task, 1)) <
+			pool->num_tasks)
+	{
+		pool->func(pool->arg, task);
+	}
+}
+
+/* The owner of a deque works from the bottom */
+static void pool_deque_push(PoolDeque *dq, int task)
+{
+	pthread_mutex_lock(&dq->lock);
+	dq->task[dq->bottom++] = task;
+	pthread_mutex_unlock(&dq->lock);
+}
+
+static int pool_deque_pop(PoolDeque *dq)
+{
+	int task = -1;
+
+	pthread_mutex_lock(&dq->lock);
+	if (dq->bottom > dq->top) {
+		task = dq->task[--dq->bottom];
+	}
+	pthread_mutex_unlock(&dq->lock);
+
+	return task;
+}
+
+/* and everyone else takes the oldest thing from the top */
+static int pool_deque_steal(PoolDeque *dq)
+{
+	int task = -1;
+
+	pthread_mutex_lock(&dq->lock);
+	if (dq->bottom > dq->top) {
+		task = dq->task[dq->top++];
+	}
+	pthread_mutex_unlock(&dq->lock);
+
+	return task;
+}
+
+/* run ready graph tasks, mine first, then anybody's, until they are all
+	done */
+static void pool_do_graph(Pool *pool, int id)
+{
+	PoolGraph *g = pool->graph;
+	int task;
+	int i;
+
+	while(pool->remaining > 0)
+	{
+		task = pool_deque_pop(&pool->deque[id]);
+		for (i = 1; task < 0 && i < pool->num_threads; i++)
+		{
+			task = pool_deque_steal(
+				&pool->deque[(id + i) % pool->num_threads]);
+		}
+
+		/* everything left is waiting on something running elsewhere */
+		if (task < 0) {
+			sched_yield();
+			continue;
+		}
+
+		pool->func(pool->arg, task);
+
+		/* if I was the last thing a successor was waiting on, it is mine */
+		for (i = g->succ_start[task]; i < g->succ_start[task + 1]; i++)
+		{
+			if (g->succ[i] >= g->num_tasks) {
+				continue;
+			}
+			if (__sync_sub_and_fetch(&pool->pending[g->succ[i]], 1) == 0) {
+				pool_deque_push(&pool->deque[id], g->succ[i]);
+			}
+		}
+
+		__sync_sub_and_fetch(&pool->remaining, 1);
+	}
+}
+
+static void* pool_worker(void *vpool)
+{
+	Pool *pool = (Pool*)vpool;
+	unsigned long seen = 0;
+	int id;
+
+	/* the caller of pool_run_graph() gets deque 0 */
+	id = __sync_add_and_fetch(&pool->next_id, 1);
+
+	while(1)
+	{
+		pthread_mutex_lock(&pool->lock);
+		while(pool->generation == seen && pool->shutdown == FALSE)
+		{
+			pthread_cond_wait(&pool->go, &pool->lock);
+		}
+		if (pool->shutdown == TRUE) {
+			pthread_mutex_unlock(&pool->lock);
+			break;
+		}
+		seen = pool->generation;
+		pthread_mutex_unlock(&pool->lock);
+
+		if (pool->graph != NULL) {
+			pool_do_graph(pool, id);
+		} else {
+			pool_do_tasks(pool);
+		}
+
+		pthread_mutex_lock(&pool->lock);
+		pool->busy--;
+		if (pool->busy == 0) {
+			pthread_cond_signal(&pool->done);
+		}
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	/* the symbols this thread kept for reuse would be lost with it */
+	symbol_pool_drain();
+
+	return NULL;
+}
+
+void pool_run(Pool *pool, int num_tasks, POOL_FUNC func, void *arg)
+{
+	int i;
+
+	/* if there is nobody to help, don't bother waking anyone up. If a
+		graph is running, I'm being called from one of its tasks and
+		everyone else is already busy. */
+	if (pool->num_threads == 1 || num_tasks == 1 || pool->graph != NULL)
+	{
+		for (i = 0; i < num_tasks; i++)
+		{
+			func(arg, i);
+		}
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->func = func;
+	pool->arg = arg;
+	pool->num_tasks = num_tasks;
+	pool->next_task = 0;
+	pool->busy = pool->num_threads - 1;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->go);
+	pthread_mutex_unlock(&pool->lock);
+
+	/* I'm a worker too */
+	pool_do_tasks(pool);
+
+	/* wait for everyone else to finish up */
+	pthread_mutex_lock(&pool->lock);
+	while(pool->busy > 0)
+	{
+		pthread_cond_wait(&pool->done, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_run_graph(Pool *pool, PoolGraph *graph, POOL_FUNC func, void *arg)
+{
+	int i, task;
+	int roots;
+
+	if (graph->num_tasks == 0) {
+		return;
+	}
+
+	/* make room for this graph, once that is done this stays off the heap */
+	if (graph->num_tasks > pool->graph_room)
+	{
+		free((int*)pool->pending);
+		pool->pending = (volatile int*)xmalloc(sizeof(int) * graph->num_tasks);
+		for (i = 0; i < pool->num_threads; i++)
+		{
+			free(pool->deque[i].task);
+			pool->deque[i].task = 
+				(int*)xmalloc(sizeof(int) * graph->num_tasks);
+		}
+		pool->graph_room = graph->num_tasks;
+	}
+
+	for (i = 0; i < pool->num_threads; i++)
+	{
+		pool->deque[i].top = 0;
+		pool->deque[i].bottom = 0;
+	}
+
+	/* Deal out the tasks which can start right away. They go in backwards
+		so each thread pops its lowest numbered one first. */
+	roots = 0;
+	for (task = graph->num_tasks - 1; task >= 0; task--)
+	{
+		pool->pending[task] = graph->num_deps[task];
+		if (graph->num_deps[task] == 0) {
+			pool->deque[roots % pool->num_threads].task[
+				pool->deque[roots % pool->num_threads].bottom++] = task;
+			roots++;
+		}
+	}
+
+	if (roots == 0)
+	{
+		printf("pool_run_graph(): Every task waits on another one!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	pool->remaining = graph->num_tasks;
+	pool->func = func;
+	pool->arg = arg;
+
+	/* nobody to help, so just do it all myself */
+	if (pool->num_threads == 1)
+	{
+		pool->graph = graph;
+		pool_do_graph(pool, 0);
+		pool->graph = NULL;
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->graph = graph;
+	pool->busy = pool->num_threads - 1;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->go);
+	pthread_mutex_unlock(&pool->lock);
+
+	/* I'm a worker too */
+	pool_do_graph(pool, 0);
+
+	/* wait for everyone else to notice it is all done */
+	pthread_mutex_lock(&pool->lock);
+	while(pool->busy > 0)
+	{
+		pthread_cond_wait(&pool->done, &pool->lock);
+	}
+	pool->graph = NULL;
+	pthread_mutex_unlock(&pool->lock);
+}
+
+int pool_get_num_threads(Pool *pool)
+{
+	return pool->num_threads;
+}
+
+void pool_free(Pool *pool)
+{
+	int i;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->shutdown = TRUE;
+	pthread_cond_broadcast(&pool->go);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 0; i < pool->num_threads - 1; i++)
+	{
+		pthread_join(pool->workers[i], NULL);
+	}
+
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->go);
+	pthread_cond_destroy(&pool->done);
+
+	for (i = 0; i < pool->num_threads; i++)
+	{
+		pthread_mutex_destroy(&pool->deque[i].lock);
+		free(pool->deque[i].task);
+	}
+	free(pool->deque);
+	free((int*)pool->pending);
+
+	free(pool->workers);
+	free(pool);
+}
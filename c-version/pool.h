@@ -0,0 +1,108 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+
+/* A persistent pool of worker threads. The threads are made once and sleep
+	until pool_run() hands them some work, so it is cheap enough to use for
+	every bmu search of a big SOM. */
+
+/* The work function, it is called once for each task number from 0 to
+	num_tasks - 1 in some order on some thread. */
+typedef void (*POOL_FUNC)(void *arg, int task);
+
+/* A job whose tasks depend on each other. Task t can't start until
+	num_deps[t] other tasks, the ones which list t as a successor, are done.
+	The successors of task t are succ[succ_start[t]] up to, but not
+	including, succ[succ_start[t + 1]]. Successors numbered num_tasks or
+	more are ignored, so if all of the edges go from lower to higher
+	numbered tasks, lowering num_tasks runs just the first part. */
+typedef struct PoolGraph_s
+{
+	int num_tasks;
+	int *num_deps;
+	int *succ_start;
+	int *succ;
+
+} PoolGraph;
+
+/* Each thread keeps the tasks which became ready on it in one of these. The
+	owner pushes and pops at the bottom, and idle threads steal from the top,
+	so the work stays on the thread which made it ready unless someone
+	else has nothing to do. */
+typedef struct PoolDeque_s
+{
+	pthread_mutex_t lock;
+	int *task;
+	int top, bottom;
+
+} PoolDeque;
+
+typedef struct Pool_s
+{
+	/* how many threads work on a pool_run(), this includes the thread
+		which called pool_run() */
+	int num_threads;
+
+	/* the workers, there are num_threads - 1 of them */
+	pthread_t *workers;
+
+	pthread_mutex_t lock;
+	/* signaled when there is a new job or when it is time to die */
+	pthread_cond_t go;
+	/* signaled when the last worker finishes a job */
+	pthread_cond_t done;
+
+	/* bumped for each job so the workers know there is something new */
+	unsigned long generation;
+	int shutdown;
+	/* how many workers haven't finished the current job */
+	int busy;
+
+	/* the current job */
+	POOL_FUNC func;
+	void *arg;
+	int num_tasks;
+	/* the next task number to hand out, the threads grab them atomically */
+	volatile int next_task;
+
+	/* the current job, if it came from pool_run_graph() */
+	PoolGraph *graph;
+	/* how many more of each graph task's dependencies have to finish */
+	volatile int *pending;
+	/* how many graph tasks aren't done yet */
+	volatile int remaining;
+	/* one for each thread, the caller of pool_run_graph() is 0 */
+	PoolDeque *deque;
+	/* how many tasks the pending array and the deques have room for */
+	int graph_room;
+	/* handed out to the workers as they start so they know their deque */
+	volatile int next_id;
+} Pool;
+
+/* Make a pool of num_threads threads (including the caller of pool_run()).
+	If num_threads is zero or less, use the number in the environment
+	variable MANIFOLD_THREADS, or if that isn't set, as many as there are
+	processors. */
+Pool* pool_init(int num_threads);
+
+/* Call func(arg, task) for every task from 0 to num_tasks - 1 spread across
+	the threads, the calling thread helps out. This returns once all of the
+	tasks are done. Only one thread at a time may call this on a pool. */
+void pool_run(Pool *pool, int num_tasks, POOL_FUNC func, void *arg);
+
+/* Run every task in the graph, each one only after all of the tasks it
+	depends on are done. Whenever a task finishes, the successors it was the
+	last dependency of become ready on the same thread, and threads with
+	nothing to do steal ready tasks from each other. This returns once all of
+	the tasks are done. A task which calls pool_run() on the same pool just
+	runs that job itself. Only one thread at a time may call this on a
+	pool. */
+void pool_run_graph(Pool *pool, PoolGraph *graph, POOL_FUNC func, void *arg);
+
+int pool_get_num_threads(Pool *pool);
+
+/* stop the workers and get rid of the pool */
+void pool_free(Pool *pool);
+
+#endif
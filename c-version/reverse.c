@@ -1,4 +1,4 @@
-#include "common.h"
+#include "manifold.h"
 
 /* This file embodies the implementation of the wave table and the 
 	reverse lookup algorithm for the cortex */
@@ -196,6 +196,9 @@ InputResTable* cortex_resolve(Cortex *core, int row, int col)
 	ViewPoint *vp;
 	int wavloc;
 
+	/* if agents are running the sections, my copies of the SOMs are old */
+	cortex_sync(core);
+
 	/* determine what section the row,col pair for the "cortex space" falls
 		into and where in that section it explicitly lies. */
 	sec = locate_section_by_coords(core, row, col, &sec_row, &sec_col);
@@ -649,6 +652,8 @@ void wavefront_expand_a_node(int wfloc, Cortex *core)
 		actual input symbols */
 	int *intdims;
 	Symbol **unabs;
+	/* views of each slot's piece of a single SOM symbol */
+	Symbol *pieces;
 
 	/* a holder for each slot's time sliced symbols */
 	SlotExpansion *sexp;
@@ -749,7 +754,7 @@ void wavefront_expand_a_node(int wfloc, Cortex *core)
 		/* allocate storage for the time slices of individual integration
 			slots */
 		sexp[i].num_sym = core->wt.wfs[wfloc].views->num_sym;
-		sexp[i].sym = (Symbol**)xmalloc(sizeof(Symbol*) * sexp[i].num_sym);
+		sexp[i].sym = (Symbol*)xmalloc(sizeof(Symbol) * sexp[i].num_sym);
 
 		/* now that everything above has been set up, set up a ViewPoint
 			which will eventually contain the expanded symbols for a
@@ -775,26 +780,27 @@ void wavefront_expand_a_node(int wfloc, Cortex *core)
 		representing each actual slot and store it into the respective slot
 		expansion structure. */
 
+	pieces = (Symbol*)xmalloc(sizeof(Symbol) * 
+		core->sec[loc].receptor.num_slot);
 	for(i = 0; i < core->wt.wfs[wfloc].views->num_sym; i++)
 	{
-		/* the symbols and the container array are new memory */
-		unabs = symbol_unabstract(core->wt.wfs[wfloc].views->sym[i], 
+		/* these just look into the SOM symbol, nothing is copied */
+		symbol_unabstract_views(core->wt.wfs[wfloc].views->sym[i], pieces,
 						slotdims, core->sec[loc].receptor.num_slot);
 
 		/* Here I'm layering the unabstracted pieces into the slot expansion
 			array. */
 		for (j = 0; j < core->sec[loc].receptor.num_slot; j++)
 		{
-			sexp[j].sym[i] = unabs[j];
+			sexp[j].sym[i] = pieces[j];
 		}
-
-		/* free the container, but leave the symbols in the sexp index */
-		free(unabs);
 	}
 
 	/* since all of the slots have been broken up into individual slot
-		symbols and put into the slot expansion array, I don't need this
+		views and put into the slot expansion array, I don't need these
 		anymore */
+	free(pieces);
+	pieces = NULL;
 	free(slotdims);
 	slotdims = NULL;
 
@@ -820,7 +826,7 @@ void wavefront_expand_a_node(int wfloc, Cortex *core)
 		{
 			/* in the case of a single integration, this basically performs
 				a symbol_copy() */
-			unabs = symbol_unabstract(sexp[i].sym[j], intdims, sexp[i].ints);
+			unabs = symbol_unabstract(&sexp[i].sym[j], intdims, sexp[i].ints);
 			
 			for (index = 0; index < sexp[i].ints; index++)
 			{
@@ -916,24 +922,15 @@ SlotExpansion *sexp_init(int num_slots)
 	return sexp;
 }
 
-/* if freesyms is true, then free the symbols in the symbol array, if false, 
-	then don't. However, do not free the expview field since that memory
-	will be handed off to someone else */
+/* free the view array of each slot. However, do not free the expview field
+	since that memory will be handed off to someone else */
 void sexp_destroy(SlotExpansion *sexp, int num_slots)
 {
-	int i, j;
+	int i;
 
 	for (i = 0; i < num_slots; i++)
 	{
-		for (j = 0; j < sexp[i].num_sym; j++)
-		{
-			if (sexp[i].sym != NULL)
-			{
-				symbol_free(sexp[i].sym[j]);
-				sexp[i].sym[j] = NULL;
-			}
-		}
-		/* free the container array always */
+		/* the symbols are only views, so just free the container array */
 		if (sexp[i].sym != NULL)
 		{
 			free(sexp[i].sym);
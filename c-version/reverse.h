@@ -24,9 +24,10 @@ typedef struct SlotExpansion_s
 	/* The actual symbols representing a particular (integrated)slot's
 		info going backwards in time(from index 0). This is filled in AFTER 
 		the view symbols have been converted into slot symbols. num_sym
-		should be the same as the number of views in the viewpoint. */
+		should be the same as the number of views in the viewpoint. These
+		are views into the looked up SOM symbols, nothing is copied. */
 	int num_sym;
-	Symbol **sym;
+	Symbol *sym;
 	
 	/* the expanded views associated with this slot which can be computed once
 		everything above in this structure is completed. This is what gets
@@ -1,6 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include "common.h"
+#include "manifold.h"
 
 /* BEGIN SLQline implementation */
 SLQline* slqline_init(int slid, int width, int dim)
@@ -1,16 +1,48 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
-#include <GL/gl.h>
-#include <GL/glu.h>
-#include "common.h"
-
-static void som_draw_actual(SOM *s, int x, int y);
-static void som_draw_quality(SOM *s, unsigned int quality, int x, int y);
+#include <string.h>
+#include <float.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "manifold.h"
+
+/* rounds up to the next SOM_FILE_ALIGN boundary */
+#define SOM_FILE_ROUND(bytes) \
+	((((bytes) + SOM_FILE_ALIGN - 1) / SOM_FILE_ALIGN) * SOM_FILE_ALIGN)
 
 /* various bmu selection methods you can choose */
-void som_bmu_fixed(SOM *s, Symbol *p, int *row, int *col, int dx, int dy);
-void som_bmu_centroid(SOM *s, Symbol *p, int *row, int *col, int dx, int dy);
+void som_bmu_fixed(SOM *s, Symbol *p, int *row, int *col);
+void som_bmu_centroid(SOM *s, Symbol *p, int *row, int *col);
+static int som_bmu_distances(SOM *s, Symbol *p, int *band_rows);
+static void som_bmu_centroid_of(SOM *s, float *d, int *row, int *col);
+static int som_neighbor_table(SOM *s, float rad);
+static int som_neighbor_width(SOM *s, int reach, int dr);
+static void som_init_scratch(SOM *s);
+static void som_file_header(SOM *s, SOMFileHeader *hdr);
+
+/* record a point of interest in the bmu search */
+static inline void som_trace(SOM *s, int row, int col, int kind)
+{
+	s->trace[s->trace_num].row = row;
+	s->trace[s->trace_num].col = col;
+	s->trace[s->trace_num].kind = kind;
+	s->trace_num++;
+}
+
+/* The same math as symbol_interpolate(), but on a neuron in the slab */
+static inline void som_slab_interpolate(float *w, float *p, int dim, float t)
+{
+	int i;
+
+	for (i = 0; i < dim; i++)
+	{
+		w[i] = (w[i] * (1.0 - t)) + (p[i] * t);
+	}
+}
 
 /* return a reference to a symbol in the SOM */
 Symbol* som_symbol_ref(SOM *s, int row, int col)
@@ -23,7 +55,7 @@ Symbol* som_symbol_ref(SOM *s, int row, int col)
 /*		printf("Asked for location: row %d, col %d\n", row, col);*/
 /*		exit(EXIT_FAILURE);*/
 /*	}*/
-	return s->neuron[SOM_ADR(row, col, s)];
+	return &s->neuron[SOM_ADR(row, col, s)];
 }
 
 /* a simple wrapper around the real initializer function */
@@ -55,7 +87,10 @@ SOM* som_init(unsigned short dim, unsigned int train_iter, unsigned int rows,
 	}
 
 	s->current_iter = 0;
+	s->rand_seed = (unsigned int)rand();
 	s->mode = SOM_LEARNING;
+	s->bmu_row = 0;
+	s->bmu_col = 0;
 
 	/* if the radius function is null, then use the default one */
 	if (radius_func == NULL) {
@@ -65,20 +100,30 @@ SOM* som_init(unsigned short dim, unsigned int train_iter, unsigned int rows,
 		s->initial_radius = radius_func(s);
 	}
 
-	/* get the neuron map */
-	s->neuron = (Symbol**)xmalloc(sizeof(Symbol*) * (s->sd.rows*s->sd.cols));
+	/* get the neuron slab, the neurons are packed right next to each other.
+		The distance kernels can read a little past the last neuron, so
+		there is some zeroed padding at the end. */
+	s->stride = s->sd.dim;
+	s->slab = (float*)xmalloc_aligned(SOM_SLAB_ALIGN, sizeof(float) * 
+		((s->stride * (s->sd.rows * s->sd.cols)) + KERNEL_SLAB_OVERRUN));
+	memset(s->slab + (s->stride * (s->sd.rows * s->sd.cols)), 0,
+		sizeof(float) * KERNEL_SLAB_OVERRUN);
+
+	s->map = NULL;
+	s->map_size = 0;
+
+	som_init_scratch(s);
 
-	/* initialize the neuron map */
 	for (i = 0; i < (s->sd.rows*s->sd.cols); i++)
 	{
-		s->neuron[i] = symbol_init(s->sd.dim);
-		symbol_randomize(s->neuron[i]);
+		symbol_randomize(&s->neuron[i]);
 	}
 
 	/* set up the scalar_field for the quality map of the SOM */
 	s->max_dist = 0.0;
 	s->final_computation = FALSE;
 	s->qmap = (float*)xmalloc(sizeof(float) * (s->sd.rows * s->sd.cols));
+	memset(s->qmap, 0, sizeof(float) * (s->sd.rows * s->sd.cols));
 
 	/* For the exponential decay model, given max iterations, what is our 
 		half-life if we want to have a neighborhood of 
@@ -90,6 +135,50 @@ SOM* som_init(unsigned short dim, unsigned int train_iter, unsigned int rows,
 	return s;
 }
 
+/* Everything a SOM needs besides its slab and quality map, which is the same
+	whether it is brand new or came out of a file */
+static void som_init_scratch(SOM *s)
+{
+	int i;
+
+	/* where the bmu searches put the distance to every neuron */
+	s->dist = (float*)xmalloc(sizeof(float) * (s->sd.rows * s->sd.cols));
+
+	/* no threads until someone asks for them, a band can be as small as a
+		single row */
+	s->pool = NULL;
+	s->band_min = (float*)xmalloc(sizeof(float) * s->sd.rows);
+
+	/* the neighborhood weights by distance, from 0 to the longest side */
+	s->nbr = (float*)xmalloc(sizeof(float) * 
+		((s->sd.rows > s->sd.cols ? s->sd.rows : s->sd.cols) + 1));
+
+	/* nobody wants to see inside the bmu searches yet */
+	s->trace = NULL;
+	s->trace_num = 0;
+
+	/* nobody has asked for batch learning yet */
+	s->batch_num = NULL;
+	s->batch_den = NULL;
+	s->batch_dist = NULL;
+	s->batch_chunks = 0;
+
+	/* nothing has changed yet */
+	s->tile_rows = (s->sd.rows + SOM_TILE - 1) / SOM_TILE;
+	s->tile_cols = (s->sd.cols + SOM_TILE - 1) / SOM_TILE;
+	s->dirty = (unsigned char*)xmalloc(s->tile_rows * s->tile_cols);
+	som_clean(s);
+
+	/* initialize the neuron map, which are just views into the slab */
+	s->neuron = (Symbol*)xmalloc(sizeof(Symbol) * (s->sd.rows*s->sd.cols));
+	for (i = 0; i < (s->sd.rows*s->sd.cols); i++)
+	{
+		s->neuron[i].dim = s->sd.dim;
+		s->neuron[i].vec = s->slab + (i * s->stride);
+		s->neuron[i].pool_class = SYMBOL_VIEW;
+	}
+}
+
 unsigned int som_get_dimension(SOM *s)
 {
 	return s->sd.dim;
@@ -106,16 +195,111 @@ float som_radius_func_default(SOM *s)
 	return s->sd.rows > s->sd.cols ? s->sd.rows / 2.0 : s->sd.cols / 2.0;
 }
 
+void som_set_pool(SOM *s, Pool *pool)
+{
+	s->pool = pool;
+}
+
+void som_set_trace(SOM *s, int on)
+{
+	if (on == TRUE && s->trace == NULL)
+	{
+		/* every neuron shows up at most once per search */
+		s->trace = (SOMTracePoint*)xmalloc(sizeof(SOMTracePoint) * 
+			(s->sd.rows * s->sd.cols));
+	}
+	else if (on == FALSE && s->trace != NULL)
+	{
+		free(s->trace);
+		s->trace = NULL;
+	}
+	s->trace_num = 0;
+}
+
+/* what a thread in the pool needs to know to do one band of a bmu search */
+typedef struct SOMBandJob_s
+{
+	SOM *s;
+	float *p;
+	int band_rows;
+} SOMBandJob;
+
+/* compute the distances for one band of rows and remember the smallest */
+static void som_bmu_band(void *arg, int band)
+{
+	SOMBandJob *job = (SOMBandJob*)arg;
+	SOM *s = job->s;
+	int start, end;
+	unsigned int i, num;
+	float *d;
+	float least;
+
+	start = band * job->band_rows;
+	end = start + job->band_rows;
+	if (end > s->sd.rows) {
+		end = s->sd.rows;
+	}
+
+	num = (end - start) * s->sd.cols;
+	d = s->dist + SOM_ADR(start, 0, s);
+	kernel_dist_all(s->slab + (SOM_ADR(start, 0, s) * s->stride), s->stride,
+		num, s->sd.dim, job->p, d);
+
+	least = d[0];
+	for (i = 1; i < num; i++)
+	{
+		if (d[i] < least) {
+			least = d[i];
+		}
+	}
+	s->band_min[band] = least;
+}
+
+/* Fill in s->dist with the distance from p to every neuron and return how
+	many bands of band_rows rows the search was split into. If it was done
+	by just this thread, it is all one band which the tie breaking is never
+	allowed to skip. */
+static int som_bmu_distances(SOM *s, Symbol *p, int *band_rows)
+{
+	SOMBandJob job;
+	int num_bands;
+
+	if (s->pool == NULL || pool_get_num_threads(s->pool) == 1 ||
+		(s->sd.rows * s->sd.cols) < SOM_PARALLEL_MIN_NEURONS)
+	{
+		kernel_dist_all(s->slab, s->stride, s->sd.rows * s->sd.cols,
+			s->sd.dim, p->vec, s->dist);
+		s->band_min[0] = -FLT_MAX;
+		*band_rows = s->sd.rows;
+		return 1;
+	}
+
+	/* a few bands per thread so a slow thread doesn't hold everyone up */
+	num_bands = pool_get_num_threads(s->pool) * 4;
+	if (num_bands > s->sd.rows) {
+		num_bands = s->sd.rows;
+	}
+	job.s = s;
+	job.p = p->vec;
+	job.band_rows = (s->sd.rows + num_bands - 1) / num_bands;
+	num_bands = (s->sd.rows + job.band_rows - 1) / job.band_rows;
+
+	pool_run(s->pool, num_bands, som_bmu_band, &job);
+
+	*band_rows = job.band_rows;
+	return num_bands;
+}
+
 /* Pick a particular method of finding the BMU */
-void som_bmu(SOM *s, Symbol *p, int *row, int *col, int method, int dx, int dy)
+void som_bmu(SOM *s, Symbol *p, int *row, int *col, int method)
 {
 	switch(method)
 	{
 		case SOM_BMU_METHOD_FIXED:
-			som_bmu_fixed(s, p, row, col, dx, dy);
+			som_bmu_fixed(s, p, row, col);
 			break;
 		case SOM_BMU_METHOD_CENTROID:
-			som_bmu_centroid(s, p, row, col, dx, dy);
+			som_bmu_centroid(s, p, row, col);
 			break;
 		default:
 			printf("som_bmu(): Unknown learning method!\n");
@@ -126,67 +310,82 @@ void som_bmu(SOM *s, Symbol *p, int *row, int *col, int method, int dx, int dy)
 /* compute the centroid of the winner (or winners) and return that as the 
 	output for the bmu. There could be cases where the centroid isn't
 	in the actual correct data points and what not, I need to look at that */
-void som_bmu_centroid(SOM *s, Symbol *p, int *row, int *col, int dx, int dy)
+void som_bmu_centroid(SOM *s, Symbol *p, int *row, int *col)
 {
 	int r, c;
 	double dist;
 	double best_dist_so_far = 999999;
 	int num_matches = 0;
-	Symbol *sym;
+	float *d;
+	int band, num_bands, band_rows, band_start, band_end;
 	double drow = 0.0, dcol = 0.0;
 
-	for (r = 0; r < s->sd.rows; r++)
+	/* the trace only ever holds the latest search */
+	s->trace_num = 0;
+
+	/* TODO: Get a better distance function here. Euclidean distance
+		starts to fail in higher dimensions. */
+	num_bands = som_bmu_distances(s, p, &band_rows);
+
+	for (band = 0; band < num_bands; band++)
 	{
-		for (c = 0; c < s->sd.cols; c++)
-		{
-			sym = som_symbol_ref(s, r, c);
+		/* Every distance in this band is too far from the best so far to
+			be a tie or a new best, so nothing would happen in here. */
+		if (s->band_min[band] - best_dist_so_far >= 1e-15) {
+			continue;
+		}
 
-			/* TODO: Get a better distance function here. Euclidean distance
-				starts to fail in higher dimensions. */
-			dist = symbol_fdist(sym, p);
-			
-			/* if the neuron in question is so close to the symbol in question,
-				them make sure I evenly pick one out of the entire set of 
-				"too close" neurons */
-			if (fabs(dist - best_dist_so_far) < 1e-15)
+		band_start = band * band_rows;
+		band_end = band_start + band_rows;
+		if (band_end > s->sd.rows) {
+			band_end = s->sd.rows;
+		}
+
+		/* the distances are in row major order, so just walk them */
+		d = s->dist + SOM_ADR(band_start, 0, s);
+		for (r = band_start; r < band_end; r++)
+		{
+			for (c = 0; c < s->sd.cols; c++, d++)
 			{
-				/* sum everything up for the averaging later... */
-				drow += r;
-				dcol += c;
-				/* the divisor for the number of matches found */
-				num_matches++;
+				dist = *d;
+			
+				/* if the neuron in question is so close to the symbol in question,
+					them make sure I evenly pick one out of the entire set of 
+					"too close" neurons */
+				if (fabs(dist - best_dist_so_far) < 1e-15)
+				{
+					/* sum everything up for the averaging later... */
+					drow += r;
+					dcol += c;
+					/* the divisor for the number of matches found */
+					num_matches++;
 				
-#if 1
-				/* mark as red the coincident symbols */
-				glBegin(GL_POINTS);
-					glColor3f(1.0, 0.0, 0.0);
-					glVertex3f(c+dx, r+dy, .2);
-				glEnd();
-#endif
-			}
-			else if (dist < best_dist_so_far)
-			{
-				/* if it is obviously better, then just follow the gradient
-					to the best it could possibly be */
+					/* remember the coincident symbols for the renderer */
+					if (s->trace != NULL) {
+						som_trace(s, r, c, SOM_TRACE_TIE);
+					}
+				}
+				else if (dist < best_dist_so_far)
+				{
+					/* if it is obviously better, then just follow the gradient
+						to the best it could possibly be */
 
-				best_dist_so_far = dist;
+					best_dist_so_far = dist;
 
-				/* ASIDE: on unknown input, this give the only best match 
-					for it */
-				drow = r;
-				dcol = c;
+					/* ASIDE: on unknown input, this give the only best match 
+						for it */
+					drow = r;
+					dcol = c;
 				
-				/* force the calculation of the centroid of neurons close to
-					THIS particular best_dist_so_far group of neurons. */
-				num_matches = 1;
+					/* force the calculation of the centroid of neurons close to
+						THIS particular best_dist_so_far group of neurons. */
+					num_matches = 1;
 			
-#if 1
-				/* mark as green the symbols better than the last symbols */
-				glBegin(GL_POINTS);
-					glColor3f(0.0, 1.0, 0.0);
-					glVertex3f(c+dx, r+dy, .2);
-				glEnd();
-#endif
+					/* and the symbols better than the last symbols */
+					if (s->trace != NULL) {
+						som_trace(s, r, c, SOM_TRACE_BETTER);
+					}
+				}
 			}
 		}
 	}
@@ -203,7 +402,7 @@ void som_bmu_centroid(SOM *s, Symbol *p, int *row, int *col, int dx, int dy)
 
 /* find the 2d location of the symbol in the SOM which minimizes the distance
 	between the input symbol and the neuron symbol */
-void som_bmu_fixed(SOM *s, Symbol *p, int *row, int *col, int dx, int dy)
+void som_bmu_fixed(SOM *s, Symbol *p, int *row, int *col)
 {
 	int r, c;
 	double dist;
@@ -211,100 +410,164 @@ void som_bmu_fixed(SOM *s, Symbol *p, int *row, int *col, int dx, int dy)
 	int num_matches = 0;
 	int rnd;
 	int prob;
-	Symbol *sym;
+	float *d;
+	int band, num_bands, band_rows, band_start, band_end;
 
-	for (r = 0; r < s->sd.rows; r++)
+	num_bands = som_bmu_distances(s, p, &band_rows);
+
+	for (band = 0; band < num_bands; band++)
 	{
-		for (c = 0; c < s->sd.cols; c++)
+		/* Every distance in this band is too far from the best so far to
+			be a tie or a new best, so nothing would happen in here. */
+		if (s->band_min[band] - best_dist_so_far >= 1e-15) {
+			continue;
+		}
+
+		band_start = band * band_rows;
+		band_end = band_start + band_rows;
+		if (band_end > s->sd.rows) {
+			band_end = s->sd.rows;
+		}
+
+		/* the distances are in row major order, so just walk them */
+		d = s->dist + SOM_ADR(band_start, 0, s);
+		for (r = band_start; r < band_end; r++)
 		{
-			sym = som_symbol_ref(s, r, c);
-			dist = symbol_fdist(sym, p);
-			
-			/* if the neuron in question is so close to the symbol in question,
-				them make sure I evenly pick one out of the entire set of 
-				"too close" neurons */
-			if (fabs(dist - best_dist_so_far) < 1e-15)
+			for (c = 0; c < s->sd.cols; c++, d++)
 			{
-				/* XXX BEGIN Experimental */
-				/* Since I've changed the algorithm to integrate locations on
-					the hyperplane as unique identifiers representing the 
-					underlying symbols at that particular neuron, I need to
-					stabalize the lookup to ONE best match out of any number
-					of probable best match candidates. */
-				if (s->mode == SOM_CLASSIFYING)
+				dist = *d;
+			
+				/* if the neuron in question is so close to the symbol in question,
+					them make sure I evenly pick one out of the entire set of 
+					"too close" neurons */
+				if (fabs(dist - best_dist_so_far) < 1e-15)
 				{
-					*row = r;
-					*col = c;
-					/* just pick the first best one found, don't do a random
-						choice of similar winners */
-					goto skip;
-				}
-				/* XXX END Experimental */
+					/* XXX BEGIN Experimental */
+					/* Since I've changed the algorithm to integrate locations on
+						the hyperplane as unique identifiers representing the 
+						underlying symbols at that particular neuron, I need to
+						stabalize the lookup to ONE best match out of any number
+						of probable best match candidates. */
+					if (s->mode == SOM_CLASSIFYING)
+					{
+						*row = r;
+						*col = c;
+						/* don't do a random choice of similar winners, just
+							take the one found. NOTE: since every tie overwrites
+							the last one this ends up being the LAST of the
+							equally good neurons in scan order, not the first,
+							but it is stable which is all I need. */
+						goto skip;
+					}
+					/* XXX END Experimental */
 
-				/* if it is very close to the last point, randomly choose it */
-				rnd = rand();
-				prob = 1 + (int)(((float)num_matches*rnd)/(RAND_MAX+1.0));
-				if (prob == 1)
+					/* if it is very close to the last point, randomly choose it */
+					rnd = rand_r(&s->rand_seed);
+					prob = 1 + (int)(((float)num_matches*rnd)/(RAND_MAX+1.0));
+					if (prob == 1)
+					{
+						*row = r;
+						*col = c;
+					}
+
+					skip: /* XXX this tag is part of the experimental stuff */
+
+					/* make sure to give 1/n probability for choosing any neuron 
+						which is the same as any other neuron */
+					num_matches++;
+				}
+				else if (dist < best_dist_so_far)
 				{
+					/* if it is obviously better, then just follow the gradient
+						to the best it could possibly be */
+					best_dist_so_far = dist;
+
+					/* force a new probability group for the next set of neurons
+						in this potential group of neurons near the possible
+						best_dist_so_far. This will ensure that neurons out
+						of the last group of neurons close to the LAST 
+						best_dist_so_far are removed from consideration. The reason
+						that num_matches is set to 2 and not 1 is that if the next
+						neuron checked in within the tolerance of best_dist_so_far,
+						then have a 50% probability for choosing the last
+						point (this one in this case one iteration ago), or the 
+						current point in the new best_dist_so_far group. */
+					num_matches = 2;
+
+					/* ASIDE: on unknown input, this give the only best match 
+						for it */
 					*row = r;
 					*col = c;
+				
 				}
+			}
+		}
+	}
+}
 
-				skip: /* XXX this tag is part of the experimental stuff */
+/* Fill in s->nbr[k] with the gaussian weight of a neuron k rows (or cols)
+	away from the bmu and return the farthest k whose weight is still worth
+	bothering with. That is 0 once the radius is so small that even the
+	neighbors right next to the bmu would hardly move. */
+static int som_neighbor_table(SOM *s, float rad)
+{
+	int k, max;
+	float dist;
 
-				/* make sure to give 1/n probability for choosing any neuron 
-					which is the same as any other neuron */
-				num_matches++;
-			}
-			else if (dist < best_dist_so_far)
-			{
-				/* if it is obviously better, then just follow the gradient
-					to the best it could possibly be */
-				best_dist_so_far = dist;
+	max = s->sd.rows > s->sd.cols ? s->sd.rows : s->sd.cols;
+	if (rad + 1.0 < max) {
+		max = (int)rad + 1;
+	}
 
-				/* force a new probability group for the next set of neurons
-					in this potential group of neurons near the possible
-					best_dist_so_far. This will ensure that neurons out
-					of the last group of neurons close to the LAST 
-					best_dist_so_far are removed from consideration. The reason
-					that num_matches is set to 2 and not 1 is that if the next
-					neuron checked in within the tolerance of best_dist_so_far,
-					then have a 50% probability for choosing the last
-					point (this one in this case one iteration ago), or the 
-					current point in the new best_dist_so_far group. */
-				num_matches = 2;
-
-				/* ASIDE: on unknown input, this give the only best match 
-					for it */
-				*row = r;
-				*col = c;
-				
-			}
+	for (k = 0; k <= max; k++)
+	{
+		/* rad is bound to a non-zero value by the caller */
+		dist = k / rad;
+		s->nbr[k] = exp((-1.0 * (dist*dist)) / .15);
+		if (s->nbr[k] < SOM_NEIGHBOR_EPSILON) {
+			break;
 		}
 	}
+
+	return k - 1;
+}
+
+/* For the row dr rows away from the bmu, how many cols to either side of the
+	bmu have a weight (row weight times col weight) worth bothering with?
+	This turns the box into more of a disc. */
+static int som_neighbor_width(SOM *s, int reach, int dr)
+{
+	int hw = reach;
+
+	while(hw > 0 && s->nbr[dr] * s->nbr[hw] < SOM_NEIGHBOR_EPSILON)
+	{
+		hw--;
+	}
+
+	return hw;
 }
 
 /* figure out how far along the SOM learning path we are, and construct
 	all needed interpolants from scratch. return whether or not I trained
 	or moved into classification mode, prow, and pcol contain the best matching
 	unit regardless if in training or classification mode */
-unsigned int som_learn(SOM *s, Symbol *p, int *prow, int *pcol, int dx, int dy,
-	int request, int bmu_supplied)
+unsigned int som_learn(SOM *s, Symbol *p, int *prow, int *pcol, int request,
+	int bmu_supplied)
 {
 	float rad;
 	int srow, scol;
 	int erow, ecol;
-	int i, j, t0, t1;
-	float dist;
-	float g, l;
+	int i, j;
+	int reach, hw, c0, c1;
+	float wr, l, rate;
 	float delta, t;
-	Symbol *sym;
+	float *w;
 
 	/* figure out the best matching unit in context of the input p */
 	if (bmu_supplied == FALSE) {
 		// If we _don't_ supply the bmu, then calculate it given the SOM and
 		// the input symbol and return it in the prow and pcol parameters.
-		som_bmu(s, p, prow, pcol, SOM_BMU_METHOD_CENTROID, dx, dy);
+		som_bmu(s, p, prow, pcol, SOM_BMU_METHOD_CENTROID);
 	}
 
 	/* Now that we determined where our BMU is, store it. This is so we can
@@ -399,12 +662,35 @@ unsigned int som_learn(SOM *s, Symbol *p, int *prow, int *pcol, int dx, int dy,
 		rad = 1e-15;
 	}
 
+	/* Look up the gaussian weights by distance once instead of calling
+		sqrt() and exp() for every neuron in the box. */
+	reach = som_neighbor_table(s, rad);
+
+	/* how much to learn depends on how far along the process we are, add
+		the 1 to avoid divide by zero error */
+	rate = 1.0 / (t*4.0 + 1.0); /* XXX magical mult constant? */
+
+	/* If nothing next to the bmu would notice, then just teach the bmu
+		itself. This is most of the end of the training. */
+	if (reach == 0)
+	{
+		w = s->slab + (SOM_ADR(s->bmu_row, s->bmu_col, s) * s->stride);
+		som_slab_interpolate(w, p->vec, s->sd.dim, rate);
+		som_dirty(s, s->bmu_row, s->bmu_col, s->bmu_row, s->bmu_col);
+		s->current_iter++;
+		return s->mode;
+	}
+
 	/* produce the clipped box set up with the radius from the
 		x,y location to a midpoint on the box. I need to consider the
 		neighbors.  this gets smaller and smaller each iteration
 	*/
 
 	srow = s->bmu_row - rad;
+	if (srow < s->bmu_row - reach)
+	{
+		srow = s->bmu_row - reach;
+	}
 	if (srow < 0)
 	{
 		srow = 0;
@@ -417,6 +703,10 @@ unsigned int som_learn(SOM *s, Symbol *p, int *prow, int *pcol, int dx, int dy,
 	}
 
 	erow = s->bmu_row + rad;
+	if (erow > s->bmu_row + reach)
+	{
+		erow = s->bmu_row + reach;
+	}
 	if (erow >= s->sd.rows)
 	{
 		erow = s->sd.rows - 1;
@@ -428,37 +718,29 @@ unsigned int som_learn(SOM *s, Symbol *p, int *prow, int *pcol, int dx, int dy,
 		ecol = s->sd.cols - 1;
 	}
 
+	som_dirty(s, srow, scol, erow, ecol);
+
 	/* using a gaussian function, teach the neurons closer to the x,y
 		point much more than the ones farther away. Also, depending on t,
 		how much you learn is also scaled by how far along you are in the
 		learning process */
 	for (i = srow; i <= erow; i++)
 	{
-		for (j = scol; j <= ecol; j++)
+		/* only go as far along the row as the weights matter */
+		wr = s->nbr[abs(i - s->bmu_row)];
+		hw = som_neighbor_width(s, reach, abs(i - s->bmu_row));
+		c0 = s->bmu_col - hw < scol ? scol : s->bmu_col - hw;
+		c1 = s->bmu_col + hw > ecol ? ecol : s->bmu_col + hw;
+
+		/* each row of the box is a contiguous run in the slab */
+		w = s->slab + (SOM_ADR(i, c0, s) * s->stride);
+		for (j = c0; j <= c1; j++, w += s->stride)
 		{
-			/* ok, find the distance from the row, col, location to the 
-				i, j location */
-			t0 = i - s->bmu_row;
-			t1 = j - s->bmu_col;
-			dist = sqrt(t0*t0 + t1*t1);
-			/* rad is bound to a non-zero value outside of the function.
-				This is so I do not have to do a division by zero check here
-				and can get better instruction data dependancy flow 
-				through this inner loop.
-			*/
-			dist /= rad;
-
-			/* ok, this is what the gaussian is going to give me for the
-				neighbor points, l should be 1.0 if i and j equal x and y */
-			g = exp((-1.0 * (dist*dist)) / .15);
-
-			/* ok, now scale the gaussian by how far along the process we are */
-			/* add the 1 to avoid divide by zero error */
-			l = g / (t*4.0 + 1.0); /* XXX magical mult constant? */
+			/* l should be 1.0 * rate if i and j equal x and y */
+			l = wr * s->nbr[abs(j - s->bmu_col)] * rate;
 
 			/* now move the i/j point closer to p */
-			sym = som_symbol_ref(s, i, j);
-			symbol_interpolate(sym, p, l);
+			som_slab_interpolate(w, p->vec, s->sd.dim, l);
 		}
 	}
 
@@ -468,6 +750,388 @@ unsigned int som_learn(SOM *s, Symbol *p, int *prow, int *pcol, int dx, int dy,
 	return s->mode;
 }
 
+/* The same answer as som_bmu_centroid(), but from a distance array I hand it
+	and without drawing anything, so the batch learning threads can use it */
+static void som_bmu_centroid_of(SOM *s, float *d, int *row, int *col)
+{
+	int r, c;
+	double dist;
+	double best_dist_so_far = 999999;
+	int num_matches = 0;
+	double drow = 0.0, dcol = 0.0;
+
+	for (r = 0; r < s->sd.rows; r++)
+	{
+		for (c = 0; c < s->sd.cols; c++, d++)
+		{
+			dist = *d;
+
+			if (fabs(dist - best_dist_so_far) < 1e-15)
+			{
+				drow += r;
+				dcol += c;
+				num_matches++;
+			}
+			else if (dist < best_dist_so_far)
+			{
+				best_dist_so_far = dist;
+				drow = r;
+				dcol = c;
+				num_matches = 1;
+			}
+		}
+	}
+
+	*row = (int) ((double)drow / (double)num_matches);
+	*col = (int) ((double)dcol / (double)num_matches);
+}
+
+/* what the threads need to know to do their piece of a som_learn_batch() */
+typedef struct SOMBatchJob_s
+{
+	SOM *s;
+	Symbol **p;
+	int num;
+	int *prow, *pcol;
+
+	/* how many symbols each bmu search task does */
+	int chunk_size;
+
+	/* how many rows each accumulation task does and the neighborhood */
+	int band_rows;
+	float rad;
+	int reach;
+	float rate;
+} SOMBatchJob;
+
+/* find the bmus for one chunk of the batch, each chunk has its own distance
+	scratch space so they don't step on each other */
+static void som_batch_bmus(void *arg, int chunk)
+{
+	SOMBatchJob *job = (SOMBatchJob*)arg;
+	SOM *s = job->s;
+	int k, start, end;
+	float *d;
+
+	start = chunk * job->chunk_size;
+	end = start + job->chunk_size;
+	if (end > job->num) {
+		end = job->num;
+	}
+
+	d = s->batch_dist + (chunk * (s->sd.rows * s->sd.cols));
+	for (k = start; k < end; k++)
+	{
+		kernel_dist_all(s->slab, s->stride, s->sd.rows * s->sd.cols,
+			s->sd.dim, job->p[k]->vec, d);
+		som_bmu_centroid_of(s, d, &job->prow[k], &job->pcol[k]);
+	}
+}
+
+/* Add up the gaussian weighted inputs for the neurons in one band of rows
+	and then move those neurons. Only this task touches these rows, so no
+	locking is needed. */
+static void som_batch_band(void *arg, int band)
+{
+	SOMBatchJob *job = (SOMBatchJob*)arg;
+	SOM *s = job->s;
+	int start, end;
+	int srow, scol, erow, ecol;
+	int i, j, k, n, hw, c0, c1;
+	float wr, g, scale;
+	float *x, *num, *w, *den;
+
+	start = band * job->band_rows;
+	end = start + job->band_rows;
+	if (end > s->sd.rows) {
+		end = s->sd.rows;
+	}
+
+	num = s->batch_num + (SOM_ADR(start, 0, s) * s->stride);
+	den = s->batch_den + SOM_ADR(start, 0, s);
+	memset(num, 0, sizeof(float) * (end - start) * s->sd.cols * s->stride);
+	memset(den, 0, sizeof(float) * (end - start) * s->sd.cols);
+
+	for (k = 0; k < job->num; k++)
+	{
+		/* the same clipped box som_learn() would use for this bmu... */
+		srow = job->prow[k] - job->rad;
+		if (srow < 0) {
+			srow = 0;
+		}
+		scol = job->pcol[k] - job->rad;
+		if (scol < 0) {
+			scol = 0;
+		}
+		erow = job->prow[k] + job->rad;
+		if (erow >= s->sd.rows) {
+			erow = s->sd.rows - 1;
+		}
+		ecol = job->pcol[k] + job->rad;
+		if (ecol >= s->sd.cols) {
+			ecol = s->sd.cols - 1;
+		}
+
+		/* ...clipped again to where the weights matter and to my band */
+		if (srow < job->prow[k] - job->reach) {
+			srow = job->prow[k] - job->reach;
+		}
+		if (erow > job->prow[k] + job->reach) {
+			erow = job->prow[k] + job->reach;
+		}
+		if (srow < start) {
+			srow = start;
+		}
+		if (erow >= end) {
+			erow = end - 1;
+		}
+
+		x = job->p[k]->vec;
+		for (i = srow; i <= erow; i++)
+		{
+			wr = s->nbr[abs(i - job->prow[k])];
+			hw = som_neighbor_width(s, job->reach, abs(i - job->prow[k]));
+			c0 = job->pcol[k] - hw < scol ? scol : job->pcol[k] - hw;
+			c1 = job->pcol[k] + hw > ecol ? ecol : job->pcol[k] + hw;
+			for (j = c0; j <= c1; j++)
+			{
+				g = wr * s->nbr[abs(j - job->pcol[k])];
+
+				s->batch_den[SOM_ADR(i, j, s)] += g;
+				w = s->batch_num + (SOM_ADR(i, j, s) * s->stride);
+				for (n = 0; n < s->sd.dim; n++)
+				{
+					w[n] += g * x[n];
+				}
+			}
+		}
+	}
+
+	/* Move each neuron toward what it saw by rate * sum(g * (x - w)). If
+		it saw only one symbol this is exactly what som_learn() would have
+		done. When the weights add up to more than one, divide them out so a
+		neuron lands on the weighted mean instead of shooting past it. */
+	w = s->slab + (SOM_ADR(start, 0, s) * s->stride);
+	for (i = 0; i < (end - start) * s->sd.cols; i++, w += s->stride)
+	{
+		if (den[i] == 0.0) {
+			continue;
+		}
+		scale = job->rate / (den[i] > 1.0 ? den[i] : 1.0);
+		x = num + (i * s->stride);
+		for (n = 0; n < s->sd.dim; n++)
+		{
+			w[n] += scale * (x[n] - (den[i] * w[n]));
+		}
+	}
+}
+
+unsigned int som_learn_batch(SOM *s, Symbol **p, int num, int *prow,
+	int *pcol, int request)
+{
+	SOMBatchJob job;
+	int threads = 1;
+	int num_chunks, num_bands;
+	int k;
+	int neurons = s->sd.rows * s->sd.cols;
+	float t;
+
+	if (num <= 0) {
+		return s->mode;
+	}
+
+	/* it is only worth waking up the pool if there is enough work */
+	if (s->pool != NULL &&
+		((double)num * neurons) >= SOM_PARALLEL_MIN_NEURONS)
+	{
+		threads = pool_get_num_threads(s->pool);
+	}
+
+	job.s = s;
+	job.p = p;
+	job.num = num;
+	job.prow = prow;
+	job.pcol = pcol;
+
+	/* find all of the bmus against the SOM as it is right now */
+	num_chunks = threads < num ? threads : num;
+	job.chunk_size = (num + num_chunks - 1) / num_chunks;
+	num_chunks = (num + job.chunk_size - 1) / job.chunk_size;
+	if (s->batch_chunks < num_chunks)
+	{
+		free(s->batch_dist);
+		s->batch_dist = (float*)xmalloc(sizeof(float) * neurons * num_chunks);
+		s->batch_chunks = num_chunks;
+	}
+	if (num_chunks == 1) {
+		som_batch_bmus(&job, 0);
+	} else {
+		pool_run(s->pool, num_chunks, som_batch_bmus, &job);
+	}
+
+	s->bmu_row = prow[num - 1];
+	s->bmu_col = pcol[num - 1];
+
+	/* the same rules as som_learn() about when learning is over */
+	if (s->current_iter >= s->sd.train_iter)
+	{
+		s->mode = SOM_CLASSIFYING;
+		return s->mode;
+	}
+
+	if (request == SOM_REQUEST_CLASSIFY) {
+		return s->mode;
+	}
+
+	/* The neighborhood and learning rate are what som_learn() would use for
+		the first symbol of the batch and they stay put for the whole batch */
+	t = (float)s->current_iter * (1.0 / ((float)s->sd.train_iter - 1));
+	job.rad = s->initial_radius * powf(2.0, (-s->current_iter / s->half_life));
+	if (fabs(job.rad) < 1e-15)
+	{
+		job.rad = 1e-15;
+	}
+	job.rate = 1.0 / (t*4.0 + 1.0);
+	job.reach = som_neighbor_table(s, job.rad);
+
+	if (s->batch_num == NULL)
+	{
+		s->batch_num = (float*)xmalloc(sizeof(float) * neurons * s->stride);
+		s->batch_den = (float*)xmalloc(sizeof(float) * neurons);
+	}
+
+	num_bands = threads == 1 ? 1 : threads * 4;
+	if (num_bands > s->sd.rows) {
+		num_bands = s->sd.rows;
+	}
+	job.band_rows = (s->sd.rows + num_bands - 1) / num_bands;
+	num_bands = (s->sd.rows + job.band_rows - 1) / job.band_rows;
+	if (num_bands == 1) {
+		som_batch_band(&job, 0);
+	} else {
+		pool_run(s->pool, num_bands, som_batch_band, &job);
+	}
+
+	/* The bands share tiles, so the boxes the bands used are marked here
+		instead. No neuron farther than reach from every bmu moved. */
+	for (k = 0; k < num; k++)
+	{
+		som_dirty(s, prow[k] - job.reach, pcol[k] - job.reach,
+			prow[k] + job.reach, pcol[k] + job.reach);
+	}
+
+	s->current_iter += num;
+
+	return s->mode;
+}
+
+/* what the threads need to know to do their piece of a
+	som_classify_batch() */
+typedef struct SOMTileJob_s
+{
+	SOM *s;
+	Symbol **p;
+	int num;
+	int band_rows;
+	unsigned int tile;
+} SOMTileJob;
+
+/* Compare every symbol in the batch against one band of rows, a tile of
+	neurons at a time, so each tile is pulled out of memory once and then
+	reused out of the cache for the rest of the batch. */
+static void som_tile_band(void *arg, int band)
+{
+	SOMTileJob *job = (SOMTileJob*)arg;
+	SOM *s = job->s;
+	unsigned int start, end, n, num;
+	int k;
+	unsigned int neurons = s->sd.rows * s->sd.cols;
+
+	start = SOM_ADR(band * job->band_rows, 0, s);
+	end = SOM_ADR((band + 1) * job->band_rows, 0, s);
+	if (end > neurons) {
+		end = neurons;
+	}
+
+	for (n = start; n < end; n += job->tile)
+	{
+		num = end - n < job->tile ? end - n : job->tile;
+		for (k = 0; k < job->num; k++)
+		{
+			kernel_dist_all(s->slab + (n * s->stride), s->stride, num,
+				s->sd.dim, job->p[k]->vec, s->batch_dist + (k * neurons) + n);
+		}
+	}
+}
+
+unsigned int som_classify_batch(SOM *s, Symbol **p, int num, int *prow,
+	int *pcol)
+{
+	SOMTileJob job;
+	int k, num_bands;
+	int neurons = s->sd.rows * s->sd.cols;
+
+	if (num <= 0) {
+		return s->mode;
+	}
+
+	/* one distance array for each symbol */
+	if (s->batch_chunks < num)
+	{
+		free(s->batch_dist);
+		s->batch_dist = (float*)xmalloc(sizeof(float) * neurons * num);
+		s->batch_chunks = num;
+	}
+
+	job.s = s;
+	job.p = p;
+	job.num = num;
+	job.tile = SOM_TILE_BYTES / (sizeof(float) * s->stride);
+	if (job.tile == 0) {
+		job.tile = 1;
+	}
+
+	/* a few bands per thread, if it is worth waking them up */
+	num_bands = 1;
+	if (s->pool != NULL && pool_get_num_threads(s->pool) > 1 &&
+		((double)num * neurons) >= SOM_PARALLEL_MIN_NEURONS)
+	{
+		num_bands = pool_get_num_threads(s->pool) * 4;
+		if (num_bands > s->sd.rows) {
+			num_bands = s->sd.rows;
+		}
+	}
+	job.band_rows = (s->sd.rows + num_bands - 1) / num_bands;
+	num_bands = (s->sd.rows + job.band_rows - 1) / job.band_rows;
+	if (num_bands == 1) {
+		som_tile_band(&job, 0);
+	} else {
+		pool_run(s->pool, num_bands, som_tile_band, &job);
+	}
+
+	for (k = 0; k < num; k++)
+	{
+		som_bmu_centroid_of(s, s->batch_dist + (k * neurons), 
+			&prow[k], &pcol[k]);
+	}
+
+	/* the renderer wants to see the last search, so just do that one over
+		the normal way, it comes out the same */
+	if (s->trace != NULL) {
+		som_bmu_centroid(s, p[num - 1], &prow[num - 1], &pcol[num - 1]);
+	}
+
+	s->bmu_row = prow[num - 1];
+	s->bmu_col = pcol[num - 1];
+
+	/* the same rules as som_learn() about when learning is over */
+	if (s->current_iter >= s->sd.train_iter) {
+		s->mode = SOM_CLASSIFYING;
+	}
+
+	return s->mode;
+}
+
 int som_get_rows(SOM *s)
 {
 	return s->sd.rows;
@@ -488,50 +1152,256 @@ int som_get_bmu_col(SOM *s)
 	return s->bmu_col;
 }
 
-void som_free(SOM *s)
+/* what the file of this SOM starts with */
+static void som_file_header(SOM *s, SOMFileHeader *hdr)
 {
-	int i;
+	unsigned long slab_bytes;
+
+	memset(hdr, 0, sizeof(SOMFileHeader));
+
+	hdr->magic = SOM_FILE_MAGIC;
+	hdr->version = SOM_FILE_VERSION;
+	hdr->float_size = sizeof(float);
+	hdr->slab_align = SOM_SLAB_ALIGN;
+	hdr->overrun = KERNEL_SLAB_OVERRUN;
+
+	hdr->dim = s->sd.dim;
+	hdr->stride = s->stride;
+	hdr->rows = s->sd.rows;
+	hdr->cols = s->sd.cols;
+	hdr->train_iter = s->sd.train_iter;
+
+	hdr->current_iter = s->current_iter;
+	hdr->mode = s->mode;
+	hdr->bmu_row = s->bmu_row;
+	hdr->bmu_col = s->bmu_col;
+	hdr->initial_radius = s->initial_radius;
+	hdr->half_life = s->half_life;
+	hdr->final_computation = s->final_computation;
+	hdr->max_dist = s->max_dist;
+	hdr->rand_seed = s->rand_seed;
+
+	slab_bytes = sizeof(float) *
+		((unsigned long)s->stride * s->sd.rows * s->sd.cols +
+		KERNEL_SLAB_OVERRUN);
+	hdr->slab_offset = SOM_FILE_ROUND(sizeof(SOMFileHeader));
+	hdr->qmap_offset = SOM_FILE_ROUND(hdr->slab_offset + slab_bytes);
+	hdr->file_size = hdr->qmap_offset +
+		sizeof(float) * (unsigned long)s->sd.rows * s->sd.cols;
+}
+
+void som_save(SOM *s, char *filename)
+{
+	SOMFileHeader hdr;
+	char *tmp;
+	int fd;
 
-	for(i = 0; i < (s->sd.rows * s->sd.cols); i++)
+	som_file_header(s, &hdr);
+
+	tmp = (char*)xmalloc(strlen(filename) + 5);
+	sprintf(tmp, "%s.tmp", filename);
+
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
 	{
-		symbol_free(s->neuron[i]);
+		printf("som_save(): Couldn't open %s: %d(%s)\n", tmp, errno,
+			strerror(errno));
+		exit(EXIT_FAILURE);
 	}
 
-	free(s->neuron);
-	free(s->qmap);
-	free(s);
+	/* The gaps between the pieces are holes, so they read back as zeros.
+		The slab already has its zeroed overrun after it. */
+	if (ftruncate(fd, hdr.file_size) < 0 ||
+		pwrite(fd, &hdr, sizeof(SOMFileHeader), 0) != sizeof(SOMFileHeader) ||
+		lseek(fd, hdr.slab_offset, SEEK_SET) < 0 ||
+		writen(fd, s->slab, sizeof(float) *
+			((unsigned long)s->stride * s->sd.rows * s->sd.cols +
+			KERNEL_SLAB_OVERRUN)) < 0 ||
+		lseek(fd, hdr.qmap_offset, SEEK_SET) < 0 ||
+		writen(fd, s->qmap, sizeof(float) * s->sd.rows * s->sd.cols) < 0 ||
+		fsync(fd) < 0)
+	{
+		printf("som_save(): Couldn't write %s: %d(%s)\n", tmp, errno,
+			strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	close(fd);
+
+	if (rename(tmp, filename) < 0)
+	{
+		printf("som_save(): Couldn't rename %s to %s: %d(%s)\n", tmp,
+			filename, errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	free(tmp);
 }
 
+SOM* som_load(char *filename)
+{
+	SOMFileHeader *hdr, want;
+	struct stat st;
+	void *map;
+	SOM *s;
+	int fd;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+	{
+		printf("som_load(): Couldn't open %s: %d(%s)\n", filename, errno,
+			strerror(errno));
+		return NULL;
+	}
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(SOMFileHeader))
+	{
+		printf("som_load(): %s is too small to be a SOM\n", filename);
+		close(fd);
+		return NULL;
+	}
+
+	/* private, so learning doesn't write back into the file */
+	map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+	{
+		printf("som_load(): Couldn't map %s: %d(%s)\n", filename, errno,
+			strerror(errno));
+		return NULL;
+	}
+
+	/* It has to be exactly the file som_save() would have written for a SOM
+		of this shape on this machine. */
+	hdr = (SOMFileHeader*)map;
+	if (hdr->magic != SOM_FILE_MAGIC || hdr->version != SOM_FILE_VERSION ||
+		hdr->float_size != sizeof(float) ||
+		hdr->slab_align != SOM_SLAB_ALIGN ||
+		hdr->overrun != KERNEL_SLAB_OVERRUN ||
+		hdr->dim == 0 || hdr->dim > 65535 || hdr->stride != hdr->dim ||
+		hdr->rows == 0 || hdr->cols == 0 || hdr->train_iter < 2)
+	{
+		printf("som_load(): %s isn't a version %d SOM file from a machine "
+			"like this one\n", filename, SOM_FILE_VERSION);
+		munmap(map, st.st_size);
+		return NULL;
+	}
 
-/* draw the som at some offset */
-void som_draw(SOM *s, unsigned int style, int x, int y)
+	s = (SOM*)xmalloc(sizeof(SOM) * 1);
+	s->sd.dim = hdr->dim;
+	s->sd.rows = hdr->rows;
+	s->sd.cols = hdr->cols;
+	s->sd.train_iter = hdr->train_iter;
+	s->stride = hdr->stride;
+	s->current_iter = hdr->current_iter;
+	s->max_dist = hdr->max_dist;
+	s->rand_seed = hdr->rand_seed;
+	s->final_computation = hdr->final_computation;
+	s->sd.radius_func = NULL;
+	s->mode = hdr->mode;
+	s->bmu_row = hdr->bmu_row;
+	s->bmu_col = hdr->bmu_col;
+	s->initial_radius = hdr->initial_radius;
+	s->half_life = hdr->half_life;
+
+	/* the pieces have to be where I would have put them */
+	som_file_header(s, &want);
+	if (want.slab_offset != hdr->slab_offset ||
+		want.qmap_offset != hdr->qmap_offset ||
+		want.file_size != hdr->file_size ||
+		hdr->file_size > (unsigned long)st.st_size)
+	{
+		printf("som_load(): %s is cut off or laid out wrong\n", filename);
+		munmap(map, st.st_size);
+		free(s);
+		return NULL;
+	}
+
+	s->map = map;
+	s->map_size = st.st_size;
+	s->slab = (float*)((char*)map + hdr->slab_offset);
+	s->qmap = (float*)((char*)map + hdr->qmap_offset);
+
+	som_init_scratch(s);
+
+	return s;
+}
+
+void som_dirty(SOM *s, int srow, int scol, int erow, int ecol)
 {
-	int default_quality = 4;
+	int tr, tc;
+
+	if (srow < 0) {
+		srow = 0;
+	}
+	if (scol < 0) {
+		scol = 0;
+	}
+	if (erow >= s->sd.rows) {
+		erow = s->sd.rows - 1;
+	}
+	if (ecol >= s->sd.cols) {
+		ecol = s->sd.cols - 1;
+	}
 
-	glPushMatrix();
-	switch(style)
+	for (tr = srow / SOM_TILE; tr <= erow / SOM_TILE; tr++)
 	{
-		case SOM_STYLE_ACTUAL:
-			som_draw_actual(s, x, y);
-			break;
-		case SOM_STYLE_QUALITY:
-			som_draw_quality(s, default_quality, x, y);
-			break;
-		default:
-			printf("som_draw(): Unknown style: %d\n", style);
-			exit(EXIT_FAILURE);
+		for (tc = scol / SOM_TILE; tc <= ecol / SOM_TILE; tc++)
+		{
+			s->dirty[tr * s->tile_cols + tc] = TRUE;
+		}
+	}
+}
+
+void som_clean(SOM *s)
+{
+	memset(s->dirty, FALSE, s->tile_rows * s->tile_cols);
+}
+
+void som_tile_box(SOM *s, int tile, int *srow, int *scol, int *erow,
+	int *ecol)
+{
+	*srow = (tile / s->tile_cols) * SOM_TILE;
+	*scol = (tile % s->tile_cols) * SOM_TILE;
+	*erow = *srow + SOM_TILE - 1;
+	*ecol = *scol + SOM_TILE - 1;
+	if (*erow >= s->sd.rows) {
+		*erow = s->sd.rows - 1;
+	}
+	if (*ecol >= s->sd.cols) {
+		*ecol = s->sd.cols - 1;
+	}
+}
+
+void som_free(SOM *s)
+{
+	/* the neurons are views into the slab, so they aren't freed one by one */
+	free(s->neuron);
+	if (s->map != NULL) {
+		munmap(s->map, s->map_size);
+	} else {
+		free(s->slab);
+		free(s->qmap);
 	}
-	glPopMatrix();
+	free(s->dist);
+	free(s->band_min);
+	free(s->nbr);
+	free(s->trace);
+	free(s->batch_num);
+	free(s->batch_den);
+	free(s->batch_dist);
+	free(s->dirty);
+	free(s);
 }
 
-static void som_draw_quality(SOM *s, unsigned int quality, int x, int y)
+
+/* compute the quality map, the average distance from each neuron to the
+	neurons around it */
+void som_compute_quality(SOM *s, unsigned int quality)
 {
 	int row, col, arow, acol;
 	int srow, scol, erow, ecol;
 	Symbol *candidate, *center;
 	float dist, sum;
 	int count;
-	float v0, v1, v2, v3;
 
 	/* for now, to increase speed, don't recompute it if I don't have to. */
 	if (s->mode == SOM_LEARNING || 
@@ -593,183 +1463,20 @@ static void som_draw_quality(SOM *s, unsigned int quality, int x, int y)
 					s->max_dist = sum;
 				}
 
-				s->qmap[SOM_ADR(row, col, s)] = sum;
+				/* Only the neurons that moved, and the ones next to them,
+					get a different answer. The rest of the map stays clean
+					so the redraws don't make every checkpoint a full one. */
+				if (s->qmap[SOM_ADR(row, col, s)] != sum)
+				{
+					s->qmap[SOM_ADR(row, col, s)] = sum;
+					s->dirty[(row / SOM_TILE) * s->tile_cols +
+						(col / SOM_TILE)] = TRUE;
+				}
 			}
 		}
 
 		if (s->mode == SOM_CLASSIFYING) {
 			s->final_computation = TRUE;
 		}
-
-	}
-
-	/* now draw the quality field */
-
-	/* a little inefficient, I really need to use textures... */
-	glBegin(GL_QUADS);
-	for(row = 0; row < s->sd.rows - 1; row++)
-	{
-		for (col = 0; col < s->sd.cols - 1; col++)
-		{
-			/* don't forget to normalize it */
-			/* in this convolution, the neurons which are closest together will
-				be white, and those farthest apart will be black */
-			v0 = 1.0 - (s->qmap[SOM_ADR(row, col, s)] / s->max_dist);
-			v1 = 1.0 - (s->qmap[SOM_ADR(row, col+1, s)] / s->max_dist);
-			v2 = 1.0 - (s->qmap[SOM_ADR(row+1, col+1, s)] / s->max_dist);
-			v3 = 1.0 - (s->qmap[SOM_ADR(row+1, col, s)] / s->max_dist);
-
-			glColor3f(v0, v0, v0);
-			glVertex3f(x + col, y + row, 0.0);
-
-			glColor3f(v1, v1, v1);
-			glVertex3f(x + col+1, y + row, 0.0);
-
-			glColor3f(v2, v2, v2);
-			glVertex3f(x + col + 1, y + row + 1, 0.0);
-
-			glColor3f(v3, v3, v3);
-			glVertex3f(x + col, y + row+1, 0.0);
-		}
-	}
-	glEnd();
-}
-
-void som_draw_reticule(SOM *s, int x, int y, int row, int col)
-{
-	/* draw a little box around the specified location in x, y. It is
-		colored yellow if the SOM is still learning and green otherwise. */
-
-	glBegin(GL_LINE_LOOP);
-	switch(s->mode)
-	{
-		case SOM_LEARNING:
-			glColor3f(1, 1, 0);
-			break;
-		case SOM_CLASSIFYING:
-			glColor3f(0, 1, 0);
-			break;
-		default:
-			glColor3f(1, 0, 0);
-		break;
-	}
-	glVertex3f(col-10+x, row-10+y, 0.5);
-	glVertex3f(col-10+x, row+10+y, 0.5);
-	glVertex3f(col+10+x, row+10+y, 0.5);
-	glVertex3f(col+10+x, row-10+y, 0.5);
-	glEnd();
-}
-
-static void som_draw_actual(SOM *s, int x, int y)
-{
-	int row, col;
-	Symbol *sym;
-/*	glBegin(GL_LINES);*/
-/*		glColor3f(1, 1, 1);*/
-/*		glVertex3f(x, y, 0.1);*/
-/*		glVertex3f(x + s->sd.cols, y + s->sd.rows, 1.0);*/
-/*	glEnd();*/
-
-	glNormal3f(0, 0, 1);
-	switch(s->sd.dim)
-	{
-		case 0:
-			printf("oops, can't draw a zero dimensional som\n");
-			exit(EXIT_FAILURE);
-			break;
-
-		case 1:
-			glBegin(GL_QUADS);
-			for(row = 0; row < s->sd.rows - 1; row++)
-			{
-				for (col = 0; col < s->sd.cols - 1; col++)
-				{
-					/* According to page 45 of the opengl book */
-					/* V0 */
-					sym = som_symbol_ref(s, row, col);
-					glColor3f(sym->vec[0], sym->vec[0], sym->vec[0]);
-					glVertex3f(x + col, y + row, 0.0);
-					
-					/* V1 */
-					sym = som_symbol_ref(s, row, col+1);
-					glColor3f(sym->vec[0], sym->vec[0], sym->vec[0]);
-					glVertex3f(x + col + 1, y + row, 0.0);
-		
-					/* V2 */
-					sym = som_symbol_ref(s, row + 1, col + 1);
-					glColor3f(sym->vec[0], sym->vec[0], sym->vec[0]);
-					glVertex3f(x + col + 1, y + row + 1, 0.0);
-		
-					/* V3 */
-					sym = som_symbol_ref(s, row+1, col);
-					glColor3f(sym->vec[0], sym->vec[0], sym->vec[0]);
-					glVertex3f(x + col, y + row + 1, 0.0);
-				}
-			}
-			glEnd();
-			break;
-
-		case 2:
-			glBegin(GL_QUADS);
-			for(row = 0; row < s->sd.rows - 1; row++)
-			{
-				for (col = 0; col < s->sd.cols - 1; col++)
-				{
-					/* According to page 45 of the opengl book */
-					/* V0 */
-					sym = som_symbol_ref(s, row, col);
-					glColor3f(sym->vec[0], sym->vec[1], 0);
-					glVertex3f(x + col, y + row, 0.0);
-					
-					/* V1 */
-					sym = som_symbol_ref(s, row, col+1);
-					glColor3f(sym->vec[0], sym->vec[1], 0);
-					glVertex3f(x + col+1, y + row, 0.0);
-		
-					/* V2 */
-					sym = som_symbol_ref(s, row + 1, col + 1);
-					glColor3f(sym->vec[0], sym->vec[1], 0);
-					glVertex3f(x + col + 1, y + row + 1, 0.0);
-		
-					/* V3 */
-					sym = som_symbol_ref(s, row+1, col);
-					glColor3f(sym->vec[0], sym->vec[1], 0);
-					glVertex3f(x + col + 1, y + row+1, 0.0);
-				}
-			}
-			glEnd();
-			break;
-
-		default:
-			glBegin(GL_QUADS);
-			for(row = 0; row < s->sd.rows - 1; row++)
-			{
-				for (col = 0; col < s->sd.cols - 1; col++)
-				{
-					/* According to page 45 of the opengl book */
-					/* V0 */
-					sym = som_symbol_ref(s, row, col);
-					glColor3f(sym->vec[0], sym->vec[1], sym->vec[2]);
-					glVertex3f(x + col, y + row, 0.0);
-					
-					/* V1 */
-					sym = som_symbol_ref(s, row, col+1);
-					glColor3f(sym->vec[0], sym->vec[1], sym->vec[2]);
-					glVertex3f(x + col+1, y + row, 0.0);
-		
-					/* V2 */
-					sym = som_symbol_ref(s, row + 1, col + 1);
-					glColor3f(sym->vec[0], sym->vec[1], sym->vec[2]);
-					glVertex3f(x + col + 1, y + row + 1, 0.0);
-		
-					/* V3 */
-					sym = som_symbol_ref(s, row+1, col);
-					glColor3f(sym->vec[0], sym->vec[1], sym->vec[2]);
-					glVertex3f(x + col, y + row+1, 0.0);
-				}
-			}
-			glEnd();
-			break;
-
 	}
 }
@@ -6,6 +6,7 @@
 #include <math.h>
 
 #include "symbol.h"
+#include "pool.h"
 #include "input.h"
 
 enum 
@@ -36,15 +37,61 @@ enum {
 	SOM_REQUEST_CLASSIFY
 };
 
+/* what a point in a bmu search trace means */
+enum {
+	/* this neuron tied with the best so far */
+	SOM_TRACE_TIE,
+	/* this neuron was better than the best so far */
+	SOM_TRACE_BETTER
+};
+
 
 /* How I get a 2D address out of the linear array. */
 #define SOM_ADR(row, col, som) (((row) * ((som)->sd.cols)) + (col))
 
+/* the byte alignment of the neuron slab, a cache line */
+#define SOM_SLAB_ALIGN 64
+
+/* The neurons are split up into SOM_TILE by SOM_TILE squares of them, the
+	ones on the right and top edges can be smaller, and the SOM keeps track
+	of which tiles have changed since the last som_clean(). Late in the
+	training only a few tiles around each bmu ever change, so a checkpoint
+	only has to write those. */
+#define SOM_TILE 8
+
+/* The som_save() file format. A SOMFileHeader, then the slab (with the
+	zeroed overrun the distance kernels want) and then the quality map, both
+	starting on a SOM_FILE_ALIGN boundary so som_load() can just mmap() the
+	file and use them right where they are. */
+#define SOM_FILE_MAGIC 0x4d4f534d /* "MSOM" */
+#define SOM_FILE_VERSION 2
+#define SOM_FILE_ALIGN 4096
+
+/* SOMs with a pool and at least this many neurons split their bmu searches
+	across the pool, anything smaller isn't worth waking the threads up for */
+#define SOM_PARALLEL_MIN_NEURONS (64 * 64)
+
+/* som_classify_batch() walks the slab this many bytes of neurons at a time,
+	small enough that a tile stays in the cache while every symbol of the
+	batch is compared against it */
+#define SOM_TILE_BYTES (32 * 1024)
+
+/* When learning, a neuron whose gaussian neighborhood weight is under this
+	isn't touched at all, it would only move a hair toward the input anyway */
+#define SOM_NEIGHBOR_EPSILON 1e-4
+
 /* forward declaration because SOM_s is used a bit recursively */
 struct SOM_s;
 
 typedef float (*SOM_RADIUS_FUNC)(struct SOM_s *s);
 
+/* One interesting neuron the centroid bmu search ran across */
+typedef struct SOMTracePoint_s
+{
+	int row, col;
+	int kind;
+} SOMTracePoint;
+
 /* This structure describes the initial characteristics of a SOM, this is
 	used in other places as a convienent way to specify construction of a
 	SOM */
@@ -57,6 +104,39 @@ typedef struct SOMDesc_s
 	SOM_RADIUS_FUNC radius_func;
 } SOMDesc;
 
+typedef struct SOMFileHeader_s
+{
+	unsigned int magic;
+	unsigned int version;
+
+	/* a file from a machine that disagrees about these can't be mapped */
+	unsigned int float_size;
+	unsigned int slab_align;
+	unsigned int overrun;
+
+	unsigned int dim;
+	unsigned int stride;
+	unsigned int rows;
+	unsigned int cols;
+	unsigned int train_iter;
+
+	int current_iter;
+	int mode;
+	int bmu_row;
+	int bmu_col;
+	float initial_radius;
+	float half_life;
+	int final_computation;
+	float max_dist;
+	unsigned int rand_seed;
+
+	/* where things are in the file, in bytes */
+	unsigned long slab_offset;
+	unsigned long qmap_offset;
+	unsigned long file_size;
+
+} SOMFileHeader;
+
 typedef struct SOM_s
 {
 	/* am I in a training mode, or a classification mode? */
@@ -75,6 +155,12 @@ typedef struct SOM_s
 	/* what iteration of my training am I currently on? */
 	int current_iter;
 
+	/* The rand_r() state for picking between equally good neurons while
+		learning. Every SOM has its own so it doesn't matter which thread
+		gets to rand() first, and it is seeded from rand() by som_init() so
+		srand() still decides everything. */
+	unsigned int rand_seed;
+
 	/* how large is the initial neighborhood */
 	float initial_radius;
 
@@ -82,14 +168,72 @@ typedef struct SOM_s
 		the neighborhood will be 1. */
 	float half_life;
 
-	/* the array of the neurons, they are symbols of all the same dimension. */
-	Symbol **neuron;
+	/* All of the neuron weights live in this one chunk of memory in row
+		major order, which means the bmu search and the learning loops just
+		walk straight through memory instead of chasing pointers all over the
+		heap. The slab starts on a SOM_SLAB_ALIGN boundary and neuron i
+		starts at slab + (i * stride). */
+	float *slab;
+	unsigned int stride;
+
+	/* the array of the neurons, they are symbols of all the same dimension
+		whose vectors point into the slab. som_symbol_ref() hands these out
+		so everyone else can keep treating the neurons as normal symbols, but
+		don't symbol_free() them! */
+	Symbol *neuron;
+
+	/* scratch space where the bmu searches put the distance from the input
+		to every neuron */
+	float *dist;
+
+	/* If this isn't NULL, the distances of a big bmu search are computed by
+		the threads in this pool. Each thread does a band of rows and
+		records the smallest distance it found in band_min[], which lets the
+		(still serial) tie breaking skip any band that can't matter. That
+		keeps the answer exactly what the serial search would give, random
+		choices and all. */
+	Pool *pool;
+	float *band_min;
+
+	/* The gaussian neighborhood falls off the same way along the rows as it
+		does along the cols, and exp(-(x*x + y*y)) = exp(-x*x) * exp(-y*y), so
+		the learning loops only need one 1D table of weights by how many
+		neurons away from the bmu something is. It is rebuilt whenever the
+		radius changes and has room for every distance in the SOM. */
+	float *nbr;
+
+	/* som_learn_batch() scratch space, it is only made the first time a
+		batch is learned. batch_num and batch_den are the gaussian weighted
+		sums of the inputs (one vector per neuron, laid out like the slab)
+		and of the weights themselves. batch_dist has room for the distances
+		of batch_chunks bmu searches going on at the same time. */
+	float *batch_num;
+	float *batch_den;
+	float *batch_dist;
+	int batch_chunks;
+
+	/* If this isn't NULL, the centroid bmu search writes down every neuron
+		that tied or beat the best so far in here so the renderer can show
+		them afterwards. It only holds the latest search. */
+	SOMTracePoint *trace;
+	int trace_num;
 
 	/* an array containing a quality map of the som */
 	float final_computation;
 	float max_dist;
 	float *qmap;
 
+	/* one byte per tile, tile_rows of tile_cols of them, which is TRUE if
+		anything in the tile has changed since the last som_clean() */
+	unsigned char *dirty;
+	int tile_rows, tile_cols;
+
+	/* If the SOM came out of som_load(), the slab and qmap are in this
+		private mapping of the file instead of on the heap. Learning only
+		changes my copy of the pages, never the file. */
+	void *map;
+	unsigned long map_size;
+
 } SOM;
 
 
@@ -112,14 +256,29 @@ SOM* som_init_with_sd(SOMDesc *sd);
 	clasification mode I always get back the idenitical neuron for the same
 	lookup instead of a 1/n probability choice out of all suitable bmu
 	candidates */
-void som_bmu(SOM *s, Symbol *p, int *row, int *col, int method, int dx, int dy);
+void som_bmu(SOM *s, Symbol *p, int *row, int *col, int method);
 
 /* Make the SOM learn about the symbol, if it is still learning at all.
 	prow and pcol are filled in regardless if the som is in learning or
 	classification mode. Also, I can ask this function to merely classify the
 	input, or actually perform learning on it for each symbol if I choose. */
-unsigned int som_learn(SOM *s, Symbol *p, int *prow, int *pcol, int dx, int dy,
-	int request, int bmu_supplied);
+unsigned int som_learn(SOM *s, Symbol *p, int *prow, int *pcol, int request,
+	int bmu_supplied);
+
+/* Learn num symbols at once instead of one at a time. All of the bmus are
+	found against the SOM as it is now (in parallel if the SOM has a pool),
+	then each neuron is moved once toward the gaussian weighted mean of the
+	symbols near it. The radius and learning rate come from the same schedule
+	as som_learn() and current_iter moves ahead by num. prow[i] and pcol[i]
+	get the bmu of p[i] regardless of the mode, like som_learn(). */
+unsigned int som_learn_batch(SOM *s, Symbol **p, int num, int *prow,
+	int *pcol, int request);
+
+/* Classify num symbols against the SOM as it is now, exactly like num calls
+	to som_learn() with SOM_REQUEST_CLASSIFY would, but going through the
+	neurons only once for all of them instead of once per symbol. */
+unsigned int som_classify_batch(SOM *s, Symbol **p, int num, int *prow,
+	int *pcol);
 
 int som_get_rows(SOM *s);
 int som_get_cols(SOM *s);
@@ -132,6 +291,13 @@ unsigned int som_get_mode(SOM *s);
 /* what dimension of information does this SOM accept? */
 unsigned int som_get_dimension(SOM *s);
 
+/* Let the SOM use a pool of threads for its bmu searches, or NULL to stop.
+	The SOM doesn't own the pool, many SOMs can share one. */
+void som_set_pool(SOM *s, Pool *pool);
+
+/* Start (TRUE) or stop (FALSE) recording the bmu search trace */
+void som_set_trace(SOM *s, int on);
+
 /* give me the symbol pointer of the neuron in question */
 Symbol* som_symbol_ref(SOM *s, int row, int col);
 
@@ -142,16 +308,40 @@ float som_radius_func_default(SOM *s);
 /* when computin gthe quality map of the SOM, how well should it be done? */
 void som_set_quality_factor(SOM *s, float quality);
 
+/* Fill in qmap and max_dist by looking at the neurons up to quality rows
+	and cols away from each neuron. Once the SOM is done learning, this is
+	only done once. */
+void som_compute_quality(SOM *s, unsigned int quality);
+
+/* Write the SOM to filename so som_load() can bring it back just as it is,
+	neurons, training iteration, mode, and quality map. The radius function
+	isn't saved, but the radius and half life it came up with are. It is
+	written to a temporary file and renamed over filename, so filename is
+	always either the old SOM or the new one. */
+void som_save(SOM *s, char *filename);
+
+/* Map a file from som_save() in and make a SOM out of it. Only the header
+	is looked at, the neurons are paged in as they are used. Returns NULL,
+	after saying why, if the file isn't there or isn't one this program can
+	map. */
+SOM* som_load(char *filename);
+
+/* Mark the neurons from srow,scol to erow,ecol (inclusive) as changed.
+	The SOM does this itself when it learns, anyone else writing into the
+	neurons has to say so. */
+void som_dirty(SOM *s, int srow, int scol, int erow, int ecol);
+
+/* forget which tiles have changed, they all start out clean */
+void som_clean(SOM *s);
+
+/* which neurons are in tile number tile, which goes across the tile_cols
+	first */
+void som_tile_box(SOM *s, int tile, int *srow, int *scol, int *erow,
+	int *ecol);
+
 /* get rid of a SOM */
 void som_free(SOM *s);
 
-/* draw the SOM, either drawing the neurons themselves, or the quality map */
-void som_draw(SOM *s, unsigned int style, int x, int y);
-
-/* Draw a reticule (whose color changes if the SOM is learning or not) around
-	the row,col point in the SOM which is located at x,y. */
-void som_draw_reticule(SOM *s, int x, int y, int row, int col);
-
 #endif
 
 
@@ -1,18 +1,54 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include "common.h"
+#include "manifold.h"
 
-Symbol* symbol_init(unsigned short dimension)
+/* Symbols get made and thrown away constantly by cortex_process(), so free
+	ones are kept on a list per size class instead of going back to the heap.
+	Class c holds symbols with room for 1 << c floats, enough for a dimension
+	of 65535. A free symbol's vec is the link to the next free one. The
+	lists are per thread so nobody has to lock anything. */
+enum
 {
-	Symbol *sym;
+	SYMBOL_POOL_CLASSES = 17,
+	/* past this many in a class, give them back for real */
+	SYMBOL_POOL_MAX = 1024
+};
+
+static __thread Symbol *symbol_pool[SYMBOL_POOL_CLASSES];
+static __thread int symbol_pool_num[SYMBOL_POOL_CLASSES];
+
+static int symbol_pool_class(unsigned short dimension)
+{
+	int cls = 0;
+
+	while((1 << cls) < dimension)
+	{
+		cls++;
+	}
 
+	return cls;
+}
 
-	/* get the header and then the additional floats... I use minus one
-		on the dimension since one float is already included in the Symbol
-		size */
-	sym = (Symbol*)xmalloc(sizeof(Symbol) + (sizeof(float) * (dimension - 1)));
+Symbol* symbol_init(unsigned short dimension)
+{
+	Symbol *sym;
+	int cls;
+
+	cls = symbol_pool_class(dimension);
+
+	sym = symbol_pool[cls];
+	if (sym != NULL) {
+		symbol_pool[cls] = (Symbol*)sym->vec;
+		symbol_pool_num[cls]--;
+	} else {
+		/* get the header and then the floats all in one piece, the vector
+			lives right after the header */
+		sym = (Symbol*)xmalloc(sizeof(Symbol) + (sizeof(float) * (1 << cls)));
+	}
 
 	sym->dim = dimension;
+	sym->pool_class = cls;
+	sym->vec = (float*)(sym + 1);
 
 	symbol_zero(sym);
 
@@ -326,8 +362,7 @@ unsigned short symbol_get_dim(Symbol *sym)
 	a higher dimensional symbol. */
 Symbol* symbol_abstract(Symbol **list, int num)
 {
-	int i, j;
-	int tindex;
+	int i;
 	Symbol *abstraction;
 	int abstraction_dimension = 0;
 
@@ -341,6 +376,30 @@ Symbol* symbol_abstract(Symbol **list, int num)
 	/* make it */
 	abstraction = symbol_init(abstraction_dimension);
 
+	symbol_abstract_into(abstraction, list, num);
+
+	return abstraction;
+}
+
+void symbol_abstract_into(Symbol *out, Symbol **list, int num)
+{
+	int i, j;
+	int tindex;
+	int abstraction_dimension = 0;
+
+	for (i = 0; i < num; i++)
+	{
+		abstraction_dimension += list[i]->dim;
+	}
+
+	if (abstraction_dimension != out->dim)
+	{
+		printf("symbol_abstract_into(): %d dimensions of symbols won't "
+			"fit into a %d dimensional symbol!\n", abstraction_dimension,
+			out->dim);
+		exit(EXIT_FAILURE);
+	}
+
 	/* perform the merge */
 	tindex = 0;
 	/* copy each piece out of the list into the abstraction symbol preserving
@@ -349,24 +408,18 @@ Symbol* symbol_abstract(Symbol **list, int num)
 	{
 		for (j = 0; j < list[i]->dim; j++)
 		{
-			abstraction->vec[tindex] = list[i]->vec[j];
+			out->vec[tindex] = list[i]->vec[j];
 			tindex++;
 		}
 	}
-
-	return abstraction;
 }
 
-/* given the unabstraction dimension array, take the larger symbol and produce
-	an array of smaller symbols stripping the dimensions off in order from the
-	larger symbol. If I specify one smaller symbol of the same dimension
-	as the passed in symbol, then effectively this degenerates into a 
-	symbol_copy() call because I'm unabstracting a symbol into itself. */
-Symbol** symbol_unabstract(Symbol *sym, int *dim, int num_dims)
+/* make sure the dim array really does carve up the symbol */
+static void symbol_unabstract_check(char *who, Symbol *sym, int *dim, 
+	int num_dims)
 {
-	int i, j, count;
+	int i;
 	unsigned int aggregate;
-	Symbol **list;
 
 	/* see if the unabstraction dimensions add up to the higher dimensional
 		symbol */
@@ -376,8 +429,8 @@ Symbol** symbol_unabstract(Symbol *sym, int *dim, int num_dims)
 		aggregate += dim[i];
 		if (dim[i] <= 0)
 		{
-			printf("symbol_unabstract(): Cannot create lower dimensional "
-				"symbol %d with %d dimensions!\n", i, dim[i]);
+			printf("%s(): Cannot create lower dimensional "
+				"symbol %d with %d dimensions!\n", who, i, dim[i]);
 			exit(EXIT_FAILURE);
 		}
 	}
@@ -385,8 +438,8 @@ Symbol** symbol_unabstract(Symbol *sym, int *dim, int num_dims)
 	/* sanity check and decent output */
 	if (aggregate != sym->dim)
 	{
-		printf("symbol_unabstract(): Tried to unabstract a %d dimensional\n",
-			sym->dim);
+		printf("%s(): Tried to unabstract a %d dimensional\n",
+			who, sym->dim);
 		printf("\tsymbol into %d lower dimensional symbols like this:\n",
 			num_dims);
 		for (i = 0; i < num_dims; i++)
@@ -397,29 +450,106 @@ Symbol** symbol_unabstract(Symbol *sym, int *dim, int num_dims)
 			"%d dimensions!\n", aggregate, sym->dim);
 		exit(EXIT_FAILURE);
 	}
+}
+
+/* given the unabstraction dimension array, take the larger symbol and produce
+	an array of smaller symbols stripping the dimensions off in order from the
+	larger symbol. If I specify one smaller symbol of the same dimension
+	as the passed in symbol, then effectively this degenerates into a 
+	symbol_copy() call because I'm unabstracting a symbol into itself. */
+Symbol** symbol_unabstract(Symbol *sym, int *dim, int num_dims)
+{
+	int i, count;
+	Symbol **list;
+	Symbol piece;
+
+	symbol_unabstract_check("symbol_unabstract", sym, dim, num_dims);
 
 	/* ok, if I got here, then unabstract the symbol */
 	list = (Symbol**)xmalloc(sizeof(Symbol*) * num_dims);
 
+	/* copy out of the big one, into the little ones, preserving order */
 	count = 0;
 	for (i = 0; i < num_dims; i++)
 	{
-		list[i] = symbol_init(dim[i]);
-
-		/* copy out of the big one, into the little one, preserving order */
-		for (j = 0; j < dim[i]; j++)
-		{
-			list[i]->vec[j] = sym->vec[count];
-			count++;
-		}
+		symbol_view(&piece, sym, count, dim[i]);
+		list[i] = symbol_copy(&piece);
+		count += dim[i];
 	}
 
 	return list;
 }
 
+void symbol_unabstract_views(Symbol *sym, Symbol *views, int *dim, 
+	int num_dims)
+{
+	int i, count;
+
+	symbol_unabstract_check("symbol_unabstract_views", sym, dim, num_dims);
+
+	count = 0;
+	for (i = 0; i < num_dims; i++)
+	{
+		symbol_view(&views[i], sym, count, dim[i]);
+		count += dim[i];
+	}
+}
+
+void symbol_view(Symbol *view, Symbol *parent, int offset, 
+	unsigned short dimension)
+{
+	if (offset < 0 || offset + dimension > parent->dim)
+	{
+		printf("symbol_view(): A %d dimensional view at %d doesn't fit in "
+			"a %d dimensional symbol!\n", dimension, offset, parent->dim);
+		exit(EXIT_FAILURE);
+	}
+
+	view->dim = dimension;
+	view->pool_class = SYMBOL_VIEW;
+	view->vec = parent->vec + offset;
+}
+
 void symbol_free(Symbol *sym)
 {
-	free(sym);
+	int cls;
+
+	if (sym == NULL) {
+		return;
+	}
+
+	cls = sym->pool_class;
+	if (cls == SYMBOL_VIEW)
+	{
+		printf("symbol_free(): Tried to free a view, free what it looks "
+			"into instead!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (symbol_pool_num[cls] >= SYMBOL_POOL_MAX) {
+		xfree(sym);
+		return;
+	}
+
+	sym->vec = (float*)symbol_pool[cls];
+	symbol_pool[cls] = sym;
+	symbol_pool_num[cls]++;
+}
+
+void symbol_pool_drain(void)
+{
+	int i;
+	Symbol *sym;
+
+	for (i = 0; i < SYMBOL_POOL_CLASSES; i++)
+	{
+		while((sym = symbol_pool[i]) != NULL)
+		{
+			symbol_pool[i] = (Symbol*)sym->vec;
+			xfree(sym);
+		}
+		symbol_pool_num[i] = 0;
+	}
 }
 
 void symbol_add(Symbol *out, Symbol *lhs, Symbol *rhs)
@@ -10,11 +10,34 @@ typedef struct Symbol_s
 {
 	/* maximum representable dimension of 65535 */
 	unsigned short dim;
-	/* this is a stretchy array style structure */
-	float vec[1];
+	/* which symbol_init() size class this came out of, see symbol.c, or
+		SYMBOL_VIEW if this doesn't own its vector */
+	unsigned char pool_class;
+	/* The vector of the symbol. When made with symbol_init() it points just
+		past the header in the same allocation, but it can point anywhere,
+		like into the neuron slab of a SOM, which is why it isn't a stretchy
+		array anymore. */
+	float *vec;
 } Symbol;
 
-/* malloc a symbol for me with associated vector */
+/* A view is a Symbol header whose vec points into some other symbol's
+	vector (or a SOM's slab). It owns nothing, so it lives wherever the caller
+	puts it, usually on the stack or in an array, and must never be handed
+	to symbol_free(). Everything that reads or writes a symbol works on a
+	view just the same. */
+enum
+{
+	SYMBOL_VIEW = 255
+};
+
+/* make view look at dimension floats of parent starting at offset */
+void symbol_view(Symbol *view, Symbol *parent, int offset, 
+	unsigned short dimension);
+
+/* malloc a symbol for me with associated vector, it is freed with
+	symbol_free(). Freed symbols are kept around per thread in power of two
+	size classes and handed back out again by this, so once a program gets
+	going, making and freeing symbols doesn't touch the heap. */
 Symbol* symbol_init(unsigned short dimension);
 
 /* XXX these functions assume that the dimension of the symbols being operated 
@@ -106,6 +129,11 @@ void symbol_get_index(Symbol *sym, float *val, int index);
 	symbols in the list */
 Symbol* symbol_abstract(Symbol **list, int num);
 
+/* the same as symbol_abstract(), but write the result into out, which must
+	already have the summed dimension. out can be a view, so this is how
+	pieces get written straight into their place in a bigger symbol. */
+void symbol_abstract_into(Symbol *out, Symbol **list, int num);
+
 /* return an array of symbols pointers pointing to symbols matching the 
 	unabstraction specification. for example, if I have a 5
 	dimensional symbol, then the dim array could be [2,2,1] in
@@ -120,8 +148,17 @@ Symbol* symbol_abstract(Symbol **list, int num);
 	memory and must be freed by the caller. */
 Symbol** symbol_unabstract(Symbol *sym, int *dim, int num_dims);
 
+/* the same as symbol_unabstract(), but nothing is copied, views[0] to
+	views[num_dims - 1] are set up to look at the pieces of sym in place */
+void symbol_unabstract_views(Symbol *sym, Symbol *views, int *dim, 
+	int num_dims);
+
 void symbol_free(Symbol *sym);
 
+/* really free() all of the symbols the calling thread is holding onto for
+	reuse */
+void symbol_pool_drain(void);
+
 #endif
 
 
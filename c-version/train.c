@@ -0,0 +1,486 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "common.h"
+
+/* A headless trainer. It loads a cortex (a .ctx, .lctx, or .lctxb, see
+	lctx.h), feeds it samples until every section is classifying or the
+	sample budget runs out, then runs the samples through once more just
+	classifying them. At the end it writes a JSON summary of
+	how long everything took and when each section converged.
+
+	The samples come from a file of floats, separated by any whitespace,
+	where '#' starts a comment that runs to the end of the line. The floats
+	are read in groups, one group per sample, and each group has the values
+	for the first input channel of the .lctx file, then the second, and so
+	on. So if the channels have dimension 2 and 3, every 5 floats is one
+	sample. I don't care how they are split into lines. When I run out of
+	samples, I start back at the first one.
+
+	Or, with -g, the samples are the glyph images test_cortex_vision() uses.
+
+	usage: train [-g | -d dataset] [-n budget] [-s seed] [-o summary.json]
+		file.ctx|file.lctx|file.lctxb */
+
+#define TRAIN_DEFAULT_BUDGET 1000000
+#define TRAIN_DEFAULT_SEED 42
+
+/* With agents, bringing the sections back to see if they converged costs a
+	lot more than a sample, so it is only done this often and converged_at
+	is only that close. */
+#define TRAIN_SYNC_EVERY 100
+#define TRAIN_NUM_GLYPHS (9 * 16)
+
+typedef struct Dataset_s
+{
+	/* where the samples came from */
+	char *name;
+
+	/* num_samples of num_channels symbols each, they are copied before
+		they are given to the cortex */
+	int num_samples;
+	int num_channels;
+	Symbol ***sample;
+} Dataset;
+
+/* what I found out about one phase of the run */
+typedef struct Phase_s
+{
+	char *name;
+	double seconds;
+	int samples;
+} Phase;
+
+static double train_now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static void usage(char *prog)
+{
+	printf("Usage: %s [-g | -d dataset] [-n budget] [-s seed] "
+		"[-o summary.json] file.ctx|file.lctx|file.lctxb\n", prog);
+	exit(EXIT_FAILURE);
+}
+
+/* read the dataset file, the cortex tells me how big each sample is */
+static Dataset* dataset_read(char *file, Cortex *core)
+{
+	Dataset *ds;
+	FILE *f;
+	char word[256];
+	int c, len;
+	int size = 64;
+	int channel, index;
+	float val;
+
+	f = fopen(file, "r");
+	if (f == NULL)
+	{
+		printf("Could not open dataset file: %s : %d(%s)\n", file, errno,
+			strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	ds = (Dataset*)xmalloc(sizeof(Dataset) * 1);
+	ds->name = file;
+	ds->num_samples = 0;
+	ds->num_channels = core->num_input;
+	ds->sample = (Symbol***)xmalloc(sizeof(Symbol**) * size);
+
+	channel = 0;
+	index = 0;
+	len = 0;
+	while(1)
+	{
+		c = fgetc(f);
+
+		/* throw away comments */
+		if (c == '#')
+		{
+			while(c != EOF && c != '\n')
+			{
+				c = fgetc(f);
+			}
+		}
+
+		/* keep collecting a word until I hit whitespace */
+		if (c != EOF && c != ' ' && c != '\t' && c != '\n' && c != '\r')
+		{
+			if (len == sizeof(word) - 1)
+			{
+				printf("Dataset %s: number is way too long\n", file);
+				exit(EXIT_FAILURE);
+			}
+			word[len++] = c;
+			continue;
+		}
+
+		if (len > 0)
+		{
+			word[len] = '\0';
+			len = 0;
+			if (sscanf(word, "%f", &val) != 1)
+			{
+				printf("Dataset %s: '%s' isn't a number\n", file, word);
+				exit(EXIT_FAILURE);
+			}
+
+			/* starting a new sample? */
+			if (channel == 0 && index == 0)
+			{
+				if (ds->num_samples == size)
+				{
+					size *= 2;
+					ds->sample = (Symbol***)realloc(ds->sample,
+						sizeof(Symbol**) * size);
+					if (ds->sample == NULL)
+					{
+						printf("Out of memory reading the dataset!\n");
+						exit(EXIT_FAILURE);
+					}
+				}
+				ds->sample[ds->num_samples] =
+					(Symbol**)xmalloc(sizeof(Symbol*) * ds->num_channels);
+				for (channel = 0; channel < ds->num_channels; channel++)
+				{
+					ds->sample[ds->num_samples][channel] =
+						symbol_init(core->input[channel].dim);
+				}
+				channel = 0;
+				ds->num_samples++;
+			}
+
+			symbol_set_index(ds->sample[ds->num_samples - 1][channel],
+				val, index);
+
+			/* move to the next value */
+			index++;
+			if (index == core->input[channel].dim)
+			{
+				index = 0;
+				channel++;
+				if (channel == ds->num_channels) {
+					channel = 0;
+				}
+			}
+		}
+
+		if (c == EOF) {
+			break;
+		}
+	}
+	fclose(f);
+
+	if (channel != 0 || index != 0)
+	{
+		printf("Dataset %s: the last sample is incomplete\n", file);
+		exit(EXIT_FAILURE);
+	}
+	if (ds->num_samples == 0)
+	{
+		printf("Dataset %s: there aren't any samples in it\n", file);
+		exit(EXIT_FAILURE);
+	}
+
+	return ds;
+}
+
+/* the glyphs test_cortex_vision() learns, as a dataset */
+static Dataset* dataset_glyphs(Cortex *core)
+{
+	Dataset *ds;
+	VInput *vinp;
+	int i;
+
+	if (core->num_input != 16)
+	{
+		printf("The glyphs have 16 channels but the cortex has %d\n",
+			core->num_input);
+		exit(EXIT_FAILURE);
+	}
+
+	vinp = vinput_init(16, 16, 16, 16);
+
+	ds = (Dataset*)xmalloc(sizeof(Dataset) * 1);
+	ds->name = "glyphs";
+	ds->num_samples = TRAIN_NUM_GLYPHS;
+	ds->num_channels = 16;
+	ds->sample = (Symbol***)xmalloc(sizeof(Symbol**) * ds->num_samples);
+	for (i = 0; i < ds->num_samples; i++)
+	{
+		ds->sample[i] = vinput_glyph(vinp, i);
+	}
+
+	vinput_destroy(vinp);
+
+	return ds;
+}
+
+static void dataset_free(Dataset *ds)
+{
+	int i, j;
+
+	for (i = 0; i < ds->num_samples; i++)
+	{
+		for (j = 0; j < ds->num_channels; j++)
+		{
+			symbol_free(ds->sample[i][j]);
+		}
+		free(ds->sample[i]);
+	}
+	free(ds->sample);
+	free(ds);
+}
+
+/* give the cortex copies of a sample since it takes the memory */
+static void train_process(Cortex *core, Dataset *ds, int which, int request)
+{
+	Symbol **channels;
+	int i;
+
+	channels = (Symbol**)xmalloc(sizeof(Symbol*) * ds->num_channels);
+	for (i = 0; i < ds->num_channels; i++)
+	{
+		channels[i] = symbol_copy(ds->sample[which][i]);
+	}
+
+	cortex_output_table_free(
+		cortex_process(core, channels, ds->num_channels, request));
+
+	free(channels);
+}
+
+/* write str as a JSON string, quotes and all, since file and section
+	names can have anything in them */
+static void json_string(FILE *out, char *str)
+{
+	unsigned char *p;
+
+	fputc('"', out);
+	for (p = (unsigned char*)str; *p != '\0'; p++)
+	{
+		switch(*p)
+		{
+			case '"':
+				fputs("\\\"", out);
+				break;
+			case '\\':
+				fputs("\\\\", out);
+				break;
+			case '\n':
+				fputs("\\n", out);
+				break;
+			case '\r':
+				fputs("\\r", out);
+				break;
+			case '\t':
+				fputs("\\t", out);
+				break;
+			default:
+				if (*p < 0x20) {
+					fprintf(out, "\\u%04x", *p);
+				} else {
+					fputc(*p, out);
+				}
+				break;
+		}
+	}
+	fputc('"', out);
+}
+
+static void phase_json(FILE *out, Phase *ph, int last)
+{
+	fprintf(out, "    {\"name\": \"%s\", \"seconds\": %f, \"samples\": %d, "
+		"\"samples_per_second\": %f}%s\n", ph->name, ph->seconds,
+		ph->samples, ph->seconds > 0 ? ph->samples / ph->seconds : 0.0,
+		last ? "" : ",");
+}
+
+int main(int argc, char **argv)
+{
+	Cortex *core;
+	Dataset *ds;
+	FILE *out = stdout;
+	char *lctx;
+	char *dataset = NULL, *summary = NULL;
+	int glyphs = FALSE;
+	int budget = TRAIN_DEFAULT_BUDGET;
+	int seed = TRAIN_DEFAULT_SEED;
+	int *converged_at;
+	int num_converged = 0;
+	int opt, i;
+	double start, t;
+	Phase load = {"load", 0, 0};
+	Phase learn = {"train", 0, 0};
+	Phase classify = {"classify", 0, 0};
+
+	while((opt = getopt(argc, argv, "gd:n:s:o:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'g':
+				glyphs = TRUE;
+				break;
+			case 'd':
+				dataset = optarg;
+				break;
+			case 'n':
+				budget = atoi(optarg);
+				break;
+			case 's':
+				seed = atoi(optarg);
+				break;
+			case 'o':
+				summary = optarg;
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || budget <= 0 ||
+		(glyphs == TRUE) == (dataset != NULL))
+	{
+		usage(argv[0]);
+	}
+	lctx = argv[optind];
+
+	start = train_now();
+
+	srand(seed);
+	srand48(seed);
+
+	/* a .ctx gets mojified the first time, and comes out of the cache of
+		.lctxb files after that */
+	core = cortex_init(lctx);
+
+	if (glyphs == TRUE) {
+		ds = dataset_glyphs(core);
+	} else {
+		ds = dataset_read(dataset, core);
+	}
+	if (ds->num_channels != core->num_input)
+	{
+		printf("The dataset has %d channels, the cortex wants %d\n",
+			ds->num_channels, core->num_input);
+		exit(EXIT_FAILURE);
+	}
+
+	converged_at = (int*)xmalloc(sizeof(int) * core->num_sec);
+	for (i = 0; i < core->num_sec; i++)
+	{
+		converged_at[i] = -1;
+	}
+
+	load.seconds = train_now() - start;
+
+	/* learn until everyone is classifying or I'm out of samples */
+	t = train_now();
+	while(learn.samples < budget && num_converged < core->num_sec)
+	{
+		train_process(core, ds, learn.samples % ds->num_samples,
+			CORTEX_REQUEST_LEARN);
+		learn.samples++;
+
+		if (core->agents != NULL && learn.samples % TRAIN_SYNC_EVERY != 0 &&
+			learn.samples < budget)
+		{
+			continue;
+		}
+		cortex_sync(core);
+
+		for (i = 0; i < core->num_sec; i++)
+		{
+			if (converged_at[i] == -1 &&
+				core->sec[i].state == SOM_CLASSIFYING)
+			{
+				converged_at[i] = learn.samples;
+				num_converged++;
+			}
+		}
+	}
+	learn.seconds = train_now() - t;
+
+	/* and how fast can it just classify things? */
+	t = train_now();
+	for (i = 0; i < ds->num_samples; i++)
+	{
+		train_process(core, ds, i, CORTEX_REQUEST_CLASSIFY);
+		classify.samples++;
+	}
+	classify.seconds = train_now() - t;
+
+	/* the iterations below have to be the agents' */
+	cortex_sync(core);
+
+	if (summary != NULL)
+	{
+		out = fopen(summary, "w");
+		if (out == NULL)
+		{
+			printf("Could not open summary file: %s : %d(%s)\n", summary,
+				errno, strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	fprintf(out, "{\n");
+	fprintf(out, "  \"cortex\": ");
+	json_string(out, lctx);
+	fprintf(out, ",\n");
+	fprintf(out, "  \"dataset\": ");
+	json_string(out, ds->name);
+	fprintf(out, ",\n");
+	fprintf(out, "  \"dataset_samples\": %d,\n", ds->num_samples);
+	fprintf(out, "  \"budget\": %d,\n", budget);
+	fprintf(out, "  \"seed\": %d,\n", seed);
+	fprintf(out, "  \"kernel\": \"%s\",\n", kernel_name());
+	fprintf(out, "  \"threads\": %d,\n", pool_get_num_threads(core->pool));
+	fprintf(out, "  \"converged\": %s,\n",
+		num_converged == core->num_sec ? "true" : "false");
+	fprintf(out, "  \"wall_seconds\": %f,\n", train_now() - start);
+	fprintf(out, "  \"phases\": [\n");
+	phase_json(out, &load, FALSE);
+	phase_json(out, &learn, FALSE);
+	phase_json(out, &classify, TRUE);
+	fprintf(out, "  ],\n");
+	fprintf(out, "  \"sections\": [\n");
+	for (i = 0; i < core->num_sec; i++)
+	{
+		fprintf(out, "    {\"name\": ");
+		json_string(out, core->sec[i].name);
+		fprintf(out, ", \"serial_id\": %d, "
+			"\"rows\": %d, \"cols\": %d, \"train_iter\": %d, "
+			"\"batch\": %d, \"iterations\": %d, ",
+			core->sec[i].serial_id, som_get_rows(core->sec[i].som),
+			som_get_cols(core->sec[i].som),
+			core->sec[i].som->sd.train_iter, core->sec[i].batch_size,
+			core->sec[i].som->current_iter);
+		if (converged_at[i] == -1) {
+			fprintf(out, "\"converged_at\": null}");
+		} else {
+			fprintf(out, "\"converged_at\": %d}", converged_at[i]);
+		}
+		fprintf(out, "%s\n", i == core->num_sec - 1 ? "" : ",");
+	}
+	fprintf(out, "  ]\n");
+	fprintf(out, "}\n");
+
+	if (out != stdout) {
+		fclose(out);
+	}
+
+	free(converged_at);
+	dataset_free(ds);
+	cortex_free(core);
+
+	return 0;
+}
@@ -83,6 +83,11 @@ TuringMachine* turing_machine_init(int iterations)
 	tmach->perception = som_init(2, iterations, 128, 128, NULL);
 	tmach->action = som_init(3, iterations, 128, 128, NULL);
 
+	// One thread per processor for the bmu searches
+	tmach->pool = pool_init(0);
+	som_set_pool(tmach->perception, tmach->pool);
+	som_set_pool(tmach->action, tmach->pool);
+
 	// We start learning at the first perception/action rule.
 	tmach->symdex = 0;
 
@@ -139,12 +144,12 @@ int turing_machine_train(TuringMachine *tmach)
 	// NOTE: we don't save the state since both SOMs are lock stepped in
 	// when they'll change to classifying.
 	som_learn(tmach->perception, corrupted_precept,
-		&bmu_row, &bmu_col, 0, 128, SOM_REQUEST_LEARN, FALSE);
+		&bmu_row, &bmu_col, SOM_REQUEST_LEARN, FALSE);
 
 	// Then, take the BMU from the perception SOM, and use it as the
 	// direct place we are to learn the action in the actions SOM.
 	state = som_learn(tmach->action, corrupted_action,
-		&bmu_row, &bmu_col, 128, 128, SOM_REQUEST_LEARN, TRUE);
+		&bmu_row, &bmu_col, SOM_REQUEST_LEARN, TRUE);
 	
 	tmach->symdex++;
 	tmach->symdex %= 6;
@@ -176,7 +181,7 @@ void turing_machine_step(TuringMachine *tmach)
 
 	// find the BMU in the perception SOM for the precept
 	som_learn(tmach->perception, precept,
-		&bmu_row, &bmu_col, 0, 128, SOM_REQUEST_CLASSIFY, FALSE);
+		&bmu_row, &bmu_col, SOM_REQUEST_CLASSIFY, FALSE);
 
 	// look it up in the action SOM to find the relation
 	act = som_symbol_ref(tmach->action, bmu_row, bmu_col);
@@ -221,6 +226,7 @@ void turing_machine_free(TuringMachine *tmach)
 
 	som_free(tmach->perception);
 	som_free(tmach->action);
+	pool_free(tmach->pool);
 	
 	free(tmach);
 }
@@ -271,6 +277,9 @@ void test_turing_machine(void)
 	Symbol *lookup = NULL;
 	float val0, val1, val2;
 
+	/* show the ties the bmu searches run into */
+	som_set_trace(tmach->perception, TRUE);
+
 	now = SDL_GetTicks();
 	sample = now - 1; /* draw one frame immediately */
 	iter = 0;
@@ -336,6 +345,7 @@ void test_turing_machine(void)
 		if (now > sample || tmach_state == SOM_CLASSIFYING)
 		{
 			som_draw(tmach->perception, drawing_mode, 0, 0);
+			som_draw_trace(tmach->perception, 0, 0);
 			som_draw(tmach->action, drawing_mode, 128, 0);
 			glerr = glGetError();
 			if (glerr != GL_NO_ERROR) {
@@ -21,6 +21,9 @@ typedef struct TuringMachine_s {
 	SOM *perception;
 	SOM *action;
 
+	// The maps are big, so their bmu searches are spread across these threads
+	Pool *pool;
+
 	// Keep track of the execution step for display
 	int step;
 	// If the turing goes off tape, mark it invalid and never execute it
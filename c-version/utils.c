@@ -3,12 +3,18 @@
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
-#include "common.h"
+#include <limits.h>
+#include <dirent.h>
+#include "manifold.h"
+
+/* bumped by every trip to the heap through here */
+static volatile unsigned long heap_calls = 0;
 
 void* xmalloc(unsigned long size)
 {
 	void *space;
 	
+	__sync_fetch_and_add(&heap_calls, 1);
 	space = malloc(size);
 	if (space == NULL)
 	{
@@ -19,6 +25,38 @@ void* xmalloc(unsigned long size)
 	return space;
 }
 
+void* xmalloc_aligned(unsigned long align, unsigned long size)
+{
+	void *space;
+	int ret;
+
+	__sync_fetch_and_add(&heap_calls, 1);
+	ret = posix_memalign(&space, align, size);
+	if (ret != 0)
+	{
+		printf("Out of memory! (aligned %lu bytes on %lu: %s)\n",
+			size, align, strerror(ret));
+		exit(EXIT_FAILURE);
+	}
+
+	return space;
+}
+
+void xfree(void *ptr)
+{
+	if (ptr == NULL) {
+		return;
+	}
+
+	__sync_fetch_and_add(&heap_calls, 1);
+	free(ptr);
+}
+
+unsigned long xheap_calls(void)
+{
+	return heap_calls;
+}
+
 /* ensure to read n bytes from fd into ptr array */
 ssize_t readn(int fd, void *vptr, size_t n)
 {
@@ -46,3 +84,77 @@ ssize_t readn(int fd, void *vptr, size_t n)
 
 	return n - nleft;
 }
+
+/* ensure to write n bytes from ptr array into fd */
+ssize_t writen(int fd, const void *vptr, size_t n)
+{
+	size_t nleft;
+	ssize_t nwritten;
+	const char *ptr = NULL;
+
+	ptr = vptr;
+	nleft = n;
+
+	while (nleft > 0) {
+		if ((nwritten = write(fd, ptr, nleft)) <= 0) {
+			if (nwritten < 0 && errno == EINTR) {
+				nwritten = 0;
+			} else {
+				return -1;
+			}
+		}
+
+		nleft -= nwritten;
+		ptr += nwritten;
+	}
+
+	return n;
+}
+
+void remove_dir(char *dir)
+{
+	char file[PATH_MAX];
+	struct dirent *de;
+	DIR *d;
+
+	d = opendir(dir);
+	if (d == NULL) {
+		return;
+	}
+
+	while((de = readdir(d)) != NULL)
+	{
+		if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) {
+			continue;
+		}
+		if (snprintf(file, PATH_MAX, "%s/%s", dir, de->d_name) >= PATH_MAX)
+		{
+			printf("remove_dir(): %s/%s is too long!\n", dir, de->d_name);
+			exit(EXIT_FAILURE);
+		}
+		unlink(file);
+	}
+	closedir(d);
+
+	if (rmdir(dir) < 0)
+	{
+		printf("remove_dir(): Couldn't remove %s: %d(%s)\n", dir,
+			errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+}
+
+unsigned long long hash_fnv1a(const void *vptr, size_t n,
+	unsigned long long hash)
+{
+	const unsigned char *ptr = vptr;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+	{
+		hash ^= ptr[i];
+		hash *= HASH_FNV1A_PRIME;
+	}
+
+	return hash;
+}
@@ -6,7 +6,33 @@
 /* bail if I can't get the memory */
 void* xmalloc(unsigned long size);
 
+/* bail if I can't get the memory, and make sure the memory starts on an
+	align byte boundary. align must be a power of two multiple of
+	sizeof(void*). Free it with free(). */
+void* xmalloc_aligned(unsigned long align, unsigned long size);
+
+/* free() something from xmalloc() or xmalloc_aligned(), NULL is ok */
+void xfree(void *ptr);
+
+/* How many times xmalloc(), xmalloc_aligned(), and xfree() have been called
+	by any thread since the program started. Take the difference across
+	some piece of work to see how much it hits the heap. */
+unsigned long xheap_calls(void);
+
 /* read all n bytes unless there is a short read due to EOF. return 0 on EOF */
 ssize_t readn(int fd, void *vptr, size_t n);
 
+/* write all n bytes, return -1 if something went wrong */
+ssize_t writen(int fd, const void *vptr, size_t n);
+
+/* get rid of a directory of plain files, like a checkpoint, if there is one */
+void remove_dir(char *dir);
+
+/* 64 bit FNV-1a hash of n bytes. Start with HASH_FNV1A_INIT and pass the
+	last answer back in to hash more bytes onto the end. */
+#define HASH_FNV1A_INIT 14695981039346656037ULL
+#define HASH_FNV1A_PRIME 1099511628211ULL
+unsigned long long hash_fnv1a(const void *vptr, size_t n,
+	unsigned long long hash);
+
 #endif
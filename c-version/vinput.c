@@ -1,7 +1,5 @@
 #include "glyphs.h"
 #include "common.h"
-#include <GL/gl.h>
-#include <GL/glu.h>
 
 /* The images are accessed from the upper left corner of the large image! */
 VInput* vinput_init(int sibr, int sibc, int rows, int cols)
@@ -116,68 +114,6 @@ int vinput_glyph_bit(VInput *vinp, int row, int col, int r, int c)
 	return bitval?1:0;
 }
 
-/* draw a single glyph */
-void vinput_draw_glyph(VInput *vinp, Symbol **glyph, int x, int y)
-{
-	int i, j;
-	float val;
-
-	glPointSize(5.0);
-	glBegin(GL_POINTS);
-
-	for(i = 0; i < vinp->subimage_bit_rows; i++)
-	{
-		for(j = 0; j < vinp->subimage_bit_cols; j++)
-		{
-			symbol_get_index(glyph[i], &val, j);
-			glColor3f(val, val, val);
-			glVertex3f(x + j*5, y - i*5, 0.0);
-		}
-	}
-
-	glEnd();
-	glPointSize(1.0);
-}
-
-/* draw the timeslices of an input resolution */
-void vinput_draw_irt(VInput *vinp, InputResTable *irt, int x, int y)
-{
-	int input;
-	int pixel;
-	float color;
-
-	/* for now, just draw time slice zero. The null inputs get a blue
-		shade, error will be a red 'x' over the "pixel" whose intensity
-		is modulated by the actual error value */
-
-	glPointSize(5.0);
-	glBegin(GL_POINTS);
-	for (input = 0; input < irt->num_inres; input++) {
-		if (irt->inres[input].active == TRUE) {
-			for (pixel = 0; pixel < vinp->subimage_bit_cols; pixel++)
-			{
-				symbol_get_index(irt->inres[input].resolution[0], 
-						&color, pixel);
-				glColor3f(color, color, color);
-				/* flip the y axis */
-				glVertex3f(x + pixel*5, y - input*5, 0.0);
-			}
-		}
-		else
-		{
-			for (pixel = 0; pixel < vinp->subimage_bit_cols; pixel++)
-			{
-				glColor3f(1.0, 0, 0);
-
-				/* flip the y axis */
-				glVertex3f(x + pixel*5, y - input*5, 0.0);
-			}
-		}
-	}
-	glEnd();
-	glPointSize(1.0);
-}
-
 void vinput_corrupt(VInput *vinp, Symbol **glyph, float per_pixels, 
     float per_range, float per_chance, int range_style)
 {
@@ -35,12 +35,6 @@ Symbol** vinput_glyph(VInput *vinp, int index);
 /* for a specified glyph location, get the specific bit */
 int vinput_glyph_bit(VInput *vinp, int row, int col, int r, int c);
 
-/* draw the input resolution of a reverse lookup */
-void vinput_draw_irt(VInput *vinp, InputResTable *irt, int x, int y);
-
-/* draw a glyph */
-void vinput_draw_glyph(VInput *vinp, Symbol **glyph, int x, int y);
-
 /* corrupt the glyph per_chance amount of time, and then if it is corrupted,
 	then change a percentage of the pixels in per_pixels by a percentage
 	range according to the range_style(either all up, all down, or random). */
@@ -0,0 +1,501 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include "manifold.h"
+
+/* payloads are padded out so every record (and fp32 payload) is aligned */
+#define WIRE_PAD(bytes) ((((bytes) + 3) / 4) * 4)
+
+static void wire_frame_room(WireFrame *wf, unsigned int bytes);
+static void wire_frame_index(WireFrame *wf);
+static void wire_header_check(WireHeader *hdr);
+static unsigned int wire_payload_bytes(int encoding, int dim);
+
+WireFrame* wire_frame_init(void)
+{
+	WireFrame *wf;
+
+	wf = (WireFrame*)xmalloc(sizeof(WireFrame) * 1);
+
+	wf->room = 0;
+	wf->len = 0;
+	wf->buf = NULL;
+	wf->num_syms = 0;
+	wf->sym_room = 0;
+	wf->off = NULL;
+	wf->dec = NULL;
+	wf->dec_room = 0;
+
+	wire_frame_clear(wf);
+
+	return wf;
+}
+
+void wire_frame_free(WireFrame *wf)
+{
+	free(wf->buf);
+	free(wf->off);
+	free(wf->dec);
+	free(wf);
+}
+
+void wire_frame_clear(WireFrame *wf)
+{
+	WireHeader *hdr;
+
+	wf->len = 0;
+	wire_frame_room(wf, sizeof(WireHeader));
+
+	hdr = (WireHeader*)wf->buf;
+	hdr->magic = WIRE_MAGIC;
+	hdr->version = WIRE_VERSION;
+	hdr->reserved = 0;
+	hdr->num_syms = 0;
+	hdr->bytes = 0;
+
+	wf->len = sizeof(WireHeader);
+	wf->num_syms = 0;
+}
+
+/* make sure there are bytes more bytes of room in the buffer */
+static void wire_frame_room(WireFrame *wf, unsigned int bytes)
+{
+	unsigned int want = wf->len + bytes;
+	unsigned char *buf;
+
+	if (want <= wf->room) {
+		return;
+	}
+
+	if (want < wf->room * 2) {
+		want = wf->room * 2;
+	}
+	buf = (unsigned char*)xmalloc(want);
+	if (wf->buf != NULL) {
+		memcpy(buf, wf->buf, wf->len);
+	}
+	free(wf->buf);
+	wf->buf = buf;
+	wf->room = want;
+}
+
+static unsigned int wire_payload_bytes(int encoding, int dim)
+{
+	switch(encoding)
+	{
+		case WIRE_FP32:
+			return sizeof(float) * dim;
+		case WIRE_FP16:
+			return WIRE_PAD(sizeof(unsigned short) * dim);
+		case WIRE_U8:
+			return WIRE_PAD(dim);
+		default:
+			break;
+	}
+
+	printf("wire_payload_bytes(): Unknown encoding %d!\n", encoding);
+	exit(EXIT_FAILURE);
+}
+
+void wire_frame_add(WireFrame *wf, Symbol *sym, unsigned int step, int sec,
+	int slot, int encoding)
+{
+	WireHeader *hdr;
+	WireRecord *rec;
+	unsigned int bytes;
+	unsigned short *half;
+	unsigned char *byte;
+	unsigned int *off;
+	float lo, hi, scale;
+	int i, whole;
+
+	bytes = sizeof(WireRecord) + wire_payload_bytes(encoding, sym->dim);
+	wire_frame_room(wf, bytes);
+
+	if (wf->num_syms == wf->sym_room)
+	{
+		wf->sym_room = wf->sym_room == 0 ? 16 : wf->sym_room * 2;
+		off = (unsigned int*)xmalloc(sizeof(unsigned int) * wf->sym_room);
+		if (wf->off != NULL) {
+			memcpy(off, wf->off, sizeof(unsigned int) * wf->num_syms);
+		}
+		free(wf->off);
+		wf->off = off;
+	}
+	wf->off[wf->num_syms++] = wf->len;
+
+	rec = (WireRecord*)(wf->buf + wf->len);
+	rec->step = step;
+	rec->sec = sec;
+	rec->slot = slot;
+	rec->dim = sym->dim;
+	rec->encoding = encoding;
+	rec->reserved = 0;
+	rec->lo = 0;
+	rec->hi = 0;
+
+	switch(encoding)
+	{
+		case WIRE_FP32:
+			memcpy(rec + 1, sym->vec, sizeof(float) * sym->dim);
+			break;
+
+		case WIRE_FP16:
+			half = (unsigned short*)(rec + 1);
+			for (i = 0; i < sym->dim; i++)
+			{
+				half[i] = wire_float_to_half(sym->vec[i]);
+			}
+			if (sym->dim % 2 == 1) {
+				half[sym->dim] = 0;
+			}
+			break;
+
+		case WIRE_U8:
+			lo = hi = sym->dim > 0 ? sym->vec[0] : 0;
+			whole = TRUE;
+			for (i = 0; i < sym->dim; i++)
+			{
+				if (sym->vec[i] < lo) {
+					lo = sym->vec[i];
+				}
+				if (sym->vec[i] > hi) {
+					hi = sym->vec[i];
+				}
+				/* floorf(), since casting a NaN or anything too big to
+					an int is undefined */
+				if (sym->vec[i] != floorf(sym->vec[i])) {
+					whole = FALSE;
+				}
+			}
+			/* whole numbers which fit in a byte go across exactly */
+			if (whole == TRUE && hi - lo <= 255) {
+				hi = lo + 255;
+			}
+			rec->lo = lo;
+			rec->hi = hi;
+
+			byte = (unsigned char*)(rec + 1);
+			scale = hi > lo ? 255.0f / (hi - lo) : 0;
+			for (i = 0; i < sym->dim; i++)
+			{
+				byte[i] = (unsigned char)((sym->vec[i] - lo) * scale + 0.5f);
+			}
+			for (i = sym->dim; i < (int)WIRE_PAD(sym->dim); i++)
+			{
+				byte[i] = 0;
+			}
+			break;
+	}
+
+	wf->len += bytes;
+
+	hdr = (WireHeader*)wf->buf;
+	hdr->num_syms = wf->num_syms;
+	hdr->bytes = wf->len - sizeof(WireHeader);
+}
+
+int wire_frame_num(WireFrame *wf)
+{
+	return wf->num_syms;
+}
+
+Symbol* wire_frame_symbol(WireFrame *wf, int i, unsigned int *step, int *sec,
+	int *slot)
+{
+	WireRecord *rec;
+	unsigned short *half;
+	unsigned char *byte;
+	float scale;
+	int d;
+
+	if (i < 0 || i >= wf->num_syms)
+	{
+		printf("wire_frame_symbol(): There is no symbol %d in a frame of "
+			"%d!\n", i, wf->num_syms);
+		exit(EXIT_FAILURE);
+	}
+
+	rec = (WireRecord*)(wf->buf + wf->off[i]);
+	if (step != NULL) {
+		*step = rec->step;
+	}
+	if (sec != NULL) {
+		*sec = rec->sec;
+	}
+	if (slot != NULL) {
+		*slot = rec->slot;
+	}
+
+	wf->view.dim = rec->dim;
+	wf->view.pool_class = SYMBOL_VIEW;
+
+	/* the floats are already sitting right there */
+	if (rec->encoding == WIRE_FP32) {
+		wf->view.vec = (float*)(rec + 1);
+		return &wf->view;
+	}
+
+	if (rec->dim > wf->dec_room)
+	{
+		free(wf->dec);
+		wf->dec = (float*)xmalloc(sizeof(float) * rec->dim);
+		wf->dec_room = rec->dim;
+	}
+	wf->view.vec = wf->dec;
+
+	if (rec->encoding == WIRE_FP16)
+	{
+		half = (unsigned short*)(rec + 1);
+		for (d = 0; d < rec->dim; d++)
+		{
+			wf->dec[d] = wire_half_to_float(half[d]);
+		}
+	}
+	else
+	{
+		/* done this way around so that when hi - lo is 255 the whole
+			numbers come back exactly */
+		byte = (unsigned char*)(rec + 1);
+		scale = rec->hi - rec->lo;
+		for (d = 0; d < rec->dim; d++)
+		{
+			wf->dec[d] = rec->lo + (scale * byte[d]) / 255.0f;
+		}
+	}
+
+	return &wf->view;
+}
+
+/* make sure a header read from somewhere is one of mine before believing
+	how big it says the frame is */
+static void wire_header_check(WireHeader *hdr)
+{
+	if (hdr->magic != WIRE_MAGIC || hdr->version != WIRE_VERSION)
+	{
+		printf("wire_header_check(): Not a version %d frame from a machine "
+			"like this one (magic %x version %d)!\n", WIRE_VERSION,
+			hdr->magic, hdr->version);
+		exit(EXIT_FAILURE);
+	}
+
+	if (hdr->bytes > WIRE_MAX_BYTES ||
+		hdr->num_syms > hdr->bytes / sizeof(WireRecord))
+	{
+		printf("wire_header_check(): A frame of %u symbols in %u bytes "
+			"can't be right!\n", hdr->num_syms, hdr->bytes);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/* check the frame in buf and find where all of its records are */
+static void wire_frame_index(WireFrame *wf)
+{
+	WireHeader *hdr = (WireHeader*)wf->buf;
+	WireRecord *rec;
+	unsigned int pos, bytes;
+	int i;
+
+	wire_header_check(hdr);
+
+	if ((int)hdr->num_syms > wf->sym_room)
+	{
+		free(wf->off);
+		wf->off = (unsigned int*)xmalloc(sizeof(unsigned int) *
+			(hdr->num_syms + 1));
+		wf->sym_room = hdr->num_syms + 1;
+	}
+
+	pos = sizeof(WireHeader);
+	for (i = 0; i < (int)hdr->num_syms; i++)
+	{
+		if (pos + sizeof(WireRecord) > wf->len) {
+			break;
+		}
+		rec = (WireRecord*)(wf->buf + pos);
+		if (rec->encoding > WIRE_U8) {
+			break;
+		}
+		bytes = sizeof(WireRecord) +
+			wire_payload_bytes(rec->encoding, rec->dim);
+		if (pos + bytes > wf->len) {
+			break;
+		}
+		wf->off[i] = pos;
+		pos += bytes;
+	}
+
+	if (i != (int)hdr->num_syms || pos != wf->len)
+	{
+		printf("wire_frame_index(): A frame of %u symbols in %u bytes is "
+			"cut off or has garbage in it!\n", hdr->num_syms, hdr->bytes);
+		exit(EXIT_FAILURE);
+	}
+
+	wf->num_syms = hdr->num_syms;
+}
+
+void wire_frame_write(int fd, WireFrame *wf)
+{
+	if (writen(fd, wf->buf, wf->len) != (ssize_t)wf->len)
+	{
+		printf("wire_frame_write(): Couldn't write a %u byte frame: "
+			"%d(%s)\n", wf->len, errno, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+}
+
+int wire_frame_read(int fd, WireFrame *wf)
+{
+	WireHeader hdr;
+	size_t len;
+	ssize_t got;
+
+	got = readn(fd, &hdr, sizeof(WireHeader));
+	if (got == 0) {
+		return FALSE;
+	}
+	if (got != sizeof(WireHeader))
+	{
+		printf("wire_frame_read(): The frame header got cut off!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	wire_header_check(&hdr);
+	len = sizeof(WireHeader) + (size_t)hdr.bytes;
+
+	wf->len = 0;
+	wire_frame_room(wf, len);
+	memcpy(wf->buf, &hdr, sizeof(WireHeader));
+	if (readn(fd, wf->buf + sizeof(WireHeader), hdr.bytes) !=
+		(ssize_t)hdr.bytes)
+	{
+		printf("wire_frame_read(): A %u byte frame got cut off!\n",
+			hdr.bytes);
+		exit(EXIT_FAILURE);
+	}
+	wf->len = len;
+
+	wire_frame_index(wf);
+
+	return TRUE;
+}
+
+unsigned int wire_frame_parse(WireFrame *wf, unsigned char *buf,
+	unsigned int len)
+{
+	WireHeader hdr;
+	size_t whole;
+
+	if (len < sizeof(WireHeader)) {
+		return 0;
+	}
+	memcpy(&hdr, buf, sizeof(WireHeader));
+	wire_header_check(&hdr);
+	whole = sizeof(WireHeader) + (size_t)hdr.bytes;
+	if (len < whole) {
+		return 0;
+	}
+
+	wf->len = 0;
+	wire_frame_room(wf, whole);
+	memcpy(wf->buf, buf, whole);
+	wf->len = whole;
+
+	wire_frame_index(wf);
+
+	return wf->len;
+}
+
+/* IEEE 754 binary16 by hand, since I can't count on the processor having
+	an instruction for it */
+unsigned short wire_float_to_half(float f)
+{
+	unsigned int x, sign, mant, round;
+	int exp;
+
+	memcpy(&x, &f, sizeof(unsigned int));
+	sign = (x >> 16) & 0x8000;
+	exp = ((x >> 23) & 0xff) - 127 + 15;
+	mant = x & 0x7fffff;
+
+	/* infinity and NaN, which stays a NaN */
+	if (((x >> 23) & 0xff) == 0xff) {
+		return sign | 0x7c00 | (mant != 0 ? 0x200 : 0);
+	}
+
+	/* too big, so it is infinity */
+	if (exp >= 31) {
+		return sign | 0x7c00;
+	}
+
+	/* too small even for a denormal, so it is zero */
+	if (exp < -10) {
+		return sign;
+	}
+
+	/* a denormal, put the implied one back and shift it down */
+	if (exp <= 0)
+	{
+		mant |= 0x800000;
+		round = 14 - exp;
+		x = mant >> round;
+		/* round to nearest, ties to even */
+		if ((mant & ((1u << round) - 1)) > (1u << (round - 1)) ||
+			((mant & ((1u << round) - 1)) == (1u << (round - 1)) &&
+			(x & 1)))
+		{
+			x++;
+		}
+		return sign | x;
+	}
+
+	x = (exp << 10) | (mant >> 13);
+	/* round to nearest, ties to even, a carry into the exponent is right */
+	if ((mant & 0x1fff) > 0x1000 || ((mant & 0x1fff) == 0x1000 && (x & 1))) {
+		x++;
+	}
+
+	return sign | x;
+}
+
+float wire_half_to_float(unsigned short h)
+{
+	unsigned int sign = ((unsigned int)h & 0x8000) << 16;
+	unsigned int exp = (h >> 10) & 0x1f;
+	unsigned int mant = h & 0x3ff;
+	unsigned int x;
+	float f;
+
+	if (exp == 0)
+	{
+		if (mant == 0)
+		{
+			x = sign;
+		}
+		else
+		{
+			/* a denormal, make it normal */
+			exp = 127 - 15 + 1;
+			while((mant & 0x400) == 0)
+			{
+				mant <<= 1;
+				exp--;
+			}
+			x = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+		}
+	}
+	else if (exp == 31)
+	{
+		x = sign | 0x7f800000 | (mant << 13);
+	}
+	else
+	{
+		x = sign | ((exp - 15 + 127) << 23) | (mant << 13);
+	}
+
+	memcpy(&f, &x, sizeof(float));
+	return f;
+}
@@ -0,0 +1,119 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+/* The binary form of symbols for when they have to leave the process, down
+	a socket to another section, into a log, or into a file of inputs to
+	replay later. A frame is a batch of symbols, each tagged with the step
+	it belongs to and the section and slot it goes into, so whoever reads
+	the frame can put them into the IntQueues in the same order they came
+	out.
+
+	A frame is a WireHeader, then for each symbol a WireRecord followed by
+	its payload padded out to 4 bytes. Everything is in the byte order of
+	the machine that wrote it, the magic number is how a reader finds out
+	that isn't its own. The payload can be the floats as is, or half
+	floats, or bytes which go from lo to hi. When the floats are all whole
+	numbers no more than 255 apart, like glyph bits and file bytes, the
+	bytes are just the floats minus lo and come back exactly. */
+
+#define WIRE_MAGIC 0x3157464d /* "MFW1" */
+#define WIRE_VERSION 1
+
+/* no frame is bigger than this, so a mangled header can't ask for the moon */
+#define WIRE_MAX_BYTES (1U << 30)
+
+/* how a symbol's floats are written */
+enum
+{
+	WIRE_FP32,
+	WIRE_FP16,
+	WIRE_U8
+};
+
+/* the sec of a symbol which is one of the cortex's inputs, slot is then
+	which input */
+#define WIRE_INPUT -1
+
+typedef struct WireHeader_s
+{
+	unsigned int magic;
+	unsigned short version;
+	unsigned short reserved;
+	unsigned int num_syms;
+	/* how many bytes of records and payloads follow this header */
+	unsigned int bytes;
+} WireHeader;
+
+typedef struct WireRecord_s
+{
+	unsigned int step;
+	short sec;
+	unsigned short slot;
+	unsigned short dim;
+	unsigned char encoding;
+	unsigned char reserved;
+	/* only for WIRE_U8, a byte of b is lo + b * (hi - lo) / 255 */
+	float lo;
+	float hi;
+} WireRecord;
+
+/* a frame being built up, or one which was read in */
+typedef struct WireFrame_s
+{
+	/* the header and everything after it, len bytes of room bytes */
+	unsigned char *buf;
+	unsigned int len;
+	unsigned int room;
+
+	/* where each symbol's record is in buf */
+	int num_syms;
+	int sym_room;
+	unsigned int *off;
+
+	/* where decoded fp16 and u8 payloads go */
+	float *dec;
+	int dec_room;
+
+	/* what wire_frame_symbol() hands back */
+	Symbol view;
+
+} WireFrame;
+
+/* an empty frame */
+WireFrame* wire_frame_init(void);
+void wire_frame_free(WireFrame *wf);
+
+/* empty it out again, keeping the memory */
+void wire_frame_clear(WireFrame *wf);
+
+/* Add the symbol to the frame using the encoding. Either way it is copied,
+	so the symbol is still the caller's. */
+void wire_frame_add(WireFrame *wf, Symbol *sym, unsigned int step, int sec,
+	int slot, int encoding);
+
+/* how many symbols are in the frame */
+int wire_frame_num(WireFrame *wf);
+
+/* The i'th symbol in the frame and where it goes. The symbol is a view
+	which is only good until the next call to anything with this frame. An
+	fp32 one looks right into the frame, the others are decoded. step, sec
+	and slot may be NULL. */
+Symbol* wire_frame_symbol(WireFrame *wf, int i, unsigned int *step, int *sec,
+	int *slot);
+
+/* Write the frame to fd, or read one into wf. Reading returns FALSE if fd
+	was already at its end, a bad or cut off frame is fatal. */
+void wire_frame_write(int fd, WireFrame *wf);
+int wire_frame_read(int fd, WireFrame *wf);
+
+/* The same, but to and from memory. wire_frame_parse() copies len bytes of
+	buf into wf and returns how many bytes the frame was, or 0 if there
+	wasn't a whole frame there yet. A bad frame is fatal here too. */
+unsigned int wire_frame_parse(WireFrame *wf, unsigned char *buf,
+	unsigned int len);
+
+/* convert between floats and half floats, rounding to the nearest one */
+unsigned short wire_float_to_half(float f);
+float wire_half_to_float(unsigned short h);
+
+#endif